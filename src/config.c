@@ -33,12 +33,22 @@
 /* Acorn C Header files. */
 
 
+#ifdef SFLIB_HOST
+
+/* Host implementations of the OS_File and system variable calls. */
+
+#include "confighost.h"
+
+#else
+
 /* OS-Lib header files. */
 
 #include "oslib/os.h"
 #include "oslib/osfile.h"
 #include "oslib/fileswitch.h"
 
+#endif
+
 /* ANSII C header files. */
 
 #include <string.h>
@@ -49,6 +59,9 @@
 /* SF-Lib header files. */
 
 #include "config.h"
+#ifndef SFLIB_HOST
+#include "event.h"
+#endif
 #include "string.h"
 
 #ifdef __CC_NORCROFT
@@ -56,13 +69,49 @@
 #endif
 
 #define CONFIG_BOOL_LEN 64
+#define CONFIG_ARENA_CHUNK 1024							/**< The size of a standard chunk in the string arena.	*/
+#define CONFIG_ARENA_ALIGN (sizeof(void *))					/**< The alignment of allocations from the string arena.	*/
+#define CONFIG_TABLE_INITIAL_SIZE 64						/**< The initial number of slots in the option table.		*/
+#define CONFIG_STR_MIN_BUFFER 16						/**< The smallest private buffer given to a text value.	*/
+#define CONFIG_SAVE_TEMP_LEAF "ChoicesTmp"					/**< The leafname used to write new Choices files.		*/
+#define CONFIG_SNAPSHOT_LEAF "ChoicesBin"					/**< The leafname used for binary snapshots.			*/
+#define CONFIG_SNAPSHOT_MAGIC 0x42474643u					/**< The magic word identifying a binary snapshot ("CFGB").	*/
+#define CONFIG_SNAPSHOT_VERSION 1						/**< The binary snapshot format version.			*/
+#define CONFIG_HASH_SEED 5381							/**< The initial value for name and schema hashes.		*/
+#define CONFIG_CHANGES_INITIAL_SIZE 16						/**< The initial size of the pending change list.		*/
+#define CONFIG_SECTION_TABLE_INITIAL_SIZE 32					/**< The initial number of slots in the section table.	*/
+#define CONFIG_SECTION_VALUES_INITIAL_SIZE 8					/**< The initial number of slots in a section's value table.	*/
+#define CONFIG_NUMBER_LEN 16							/**< The size of a buffer to hold a formatted integer.	*/
+
+/**
+ * A chunk of memory in the string arena, from which name and text value
+ * storage is allocated.  The data follows on directly from the header.
+ */
+
+struct config_arena_chunk {
+	size_t				size;					/**< The number of bytes of data in the chunk.			*/
+	size_t				used;					/**< The number of bytes of data allocated so far.		*/
+
+	struct config_arena_chunk	*next;					/**< Pointer to the next chunk in the arena, or NULL.		*/
+};
+
+/**
+ * A length-prefixed string held in the string arena.  The text follows on
+ * directly from the header, and the pointers held by the config blocks point
+ * to the text and not to the header.
+ */
+
+struct config_string {
+	unsigned short			size;					/**< The number of bytes available for text, excluding the terminator.	*/
+	unsigned short			length;					/**< The length of the text currently stored, excluding the terminator.	*/
+};
 
 /**
  * Structure for storing boolean config settings.
  */
 
 typedef struct config_opt {
-	char			name[sf_MAX_CONFIG_NAME];			/**< The name of the config value.				*/
+	char			*name;						/**< The interned name of the config value.			*/
 	osbool			value;						/**< The current value.						*/
 	osbool			initial;					/**< The initial, or default, value.				*/
 
@@ -74,7 +123,7 @@ typedef struct config_opt {
  */
 
 typedef struct config_int {
-	char			name[sf_MAX_CONFIG_NAME];			/**< The name of the config value.				*/
+	char			*name;						/**< The interned name of the config value.			*/
 	int			value;						/**< The current value.						*/
 	int			initial;					/**< The initial, or default, value.				*/
 
@@ -83,18 +132,118 @@ typedef struct config_int {
 
 
 /**
- * Structure for storing text config settings.
+ * Structure for storing text config settings.  The value shares the initial
+ * string until it is changed, at which point it is given a private buffer
+ * in the string arena; the buffer is kept for re-use if the value is later
+ * returned to its initial state.
  */
 
 typedef struct config_str {
-	char			name[sf_MAX_CONFIG_NAME];			/**< The name of the config value.				*/
-	char			value[sf_MAX_CONFIG_STR];			/**< The current value.						*/
-	char			initial[sf_MAX_CONFIG_STR];			/**< The initial, or default, value.				*/
+	char			*name;						/**< The interned name of the config value.			*/
+	char			*value;						/**< The current value, in the string arena.			*/
+	char			*initial;					/**< The initial, or default, value, in the string arena.	*/
+	char			*buffer;					/**< The private value buffer, in the string arena, or NULL.	*/
 
 	struct config_str	*next;						/**< Pointer to the next text config value, or NULL.		*/
 } config_str;
 
 
+/**
+ * The header of a binary snapshot file.  It is followed by the values of
+ * the integer configs (one int each), then the boolean configs (one byte
+ * each), then the text configs (zero-terminated), each in the order in
+ * which they are held in their respective chains.
+ */
+
+struct config_snapshot_header {
+	unsigned		magic;						/**< The snapshot magic word.					*/
+	unsigned		version;					/**< The snapshot format version.				*/
+	unsigned		schema;						/**< The hash of the registered config values' schema.	*/
+	unsigned		size;						/**< The total size of the snapshot, including the header.	*/
+
+	unsigned		opt_count;					/**< The number of boolean config values.			*/
+	unsigned		int_count;					/**< The number of integer config values.			*/
+	unsigned		str_count;					/**< The number of text config values.				*/
+};
+
+
+/**
+ * An entry in the option table, which indexes the config values of all
+ * types by their names.  A slot is empty if its name is NULL.
+ */
+
+struct config_entry {
+	unsigned		hash;						/**< The hash of the name.					*/
+	char			*name;						/**< The interned name, in the string arena.			*/
+
+	config_opt		*opt;						/**< The boolean config value with the name, or NULL.		*/
+	config_int		*integer;					/**< The integer config value with the name, or NULL.		*/
+	config_str		*str;						/**< The text config value with the name, or NULL.		*/
+
+	osbool			changed;					/**< TRUE if the name is in the pending change list.		*/
+};
+
+
+/**
+ * A value held in a section.  Values in sections are untyped, and held as
+ * text; a slot in a section's value table is empty if its name is NULL.
+ */
+
+struct config_section_value {
+	unsigned		hash;						/**< The hash of the name.					*/
+	char			*name;						/**< The interned name, in the string arena.			*/
+	char			*value;						/**< The value, claimed with malloc().				*/
+
+	osbool			changed;					/**< TRUE if the value is in the pending change list.		*/
+};
+
+
+/**
+ * A section of config values.  Sections are loaded lazily: until the
+ * section is first accessed, its values remain as unparsed text in the
+ * file loaded by config_load().  Section blocks are never freed, so that
+ * their names remain valid while changes are pending; deleted sections
+ * are marked as such, and revived if the same name is used again.
+ */
+
+struct config_section {
+	unsigned		hash;						/**< The hash of the name.					*/
+	char			*name;						/**< The name of the section, in the string arena.		*/
+
+	osbool			deleted;					/**< TRUE if the section has been deleted.			*/
+	osbool			changed;					/**< TRUE if the deletion is in the pending change list.	*/
+
+	char			*text;						/**< The unparsed text of the section, or NULL if loaded.	*/
+	char			*text_end;					/**< The end of the unparsed text of the section.		*/
+
+	struct config_section_value *values;					/**< The section's value table, or NULL.			*/
+	size_t			values_size;					/**< The number of slots in the value table.			*/
+	size_t			values_used;					/**< The number of slots in use in the value table.		*/
+
+	struct config_section_value *previous;					/**< The value table from before a reload, or NULL.		*/
+	size_t			previous_size;					/**< The number of slots in the previous value table.		*/
+	osbool			previous_exists;				/**< TRUE if the section existed before a reload.		*/
+
+	struct config_section	*next;						/**< Pointer to the next section in file order, or NULL.	*/
+};
+
+
+/**
+ * An observer, to be notified of changes to config values.
+ */
+
+struct config_observer {
+	char			*section;					/**< The section to observe, or NULL for the global values.	*/
+	char			*name;						/**< The name of the value to observe, or NULL for all.	*/
+
+	void			(*callback)(struct config_change *changes, size_t count, void *data);	/**< The function to call with changes.	*/
+	void			*data;						/**< Client data to pass to the callback.			*/
+	osbool			deleted;					/**< TRUE if the observer was deleted during notification.	*/
+
+	struct config_observer	*next;						/**< Pointer to the next observer, or NULL.			*/
+};
+
+
 /* Global variables. */
 
 static config_opt		*opt_list = NULL;				/**< The chain of boolean config values.			*/
@@ -106,6 +255,77 @@ static char			*local_dir = NULL;				/**< The full path to the application's own
 static char			*local_sub_dir = NULL;				/**< A folder to use inside the application folder, or NULL.	*/
 static char			*application_name = NULL;			/**< The application name as registered with the Wimp.		*/
 
+static struct config_arena_chunk	*arena = NULL;				/**< The chain of chunks in the string arena.			*/
+static char				*free_strings = NULL;			/**< The chain of abandoned text value buffers, for re-use.	*/
+
+static struct config_entry	*option_table = NULL;				/**< The option table, indexing config values by name.	*/
+static size_t			option_table_size = 0;				/**< The number of slots in the option table.			*/
+static size_t			option_table_used = 0;				/**< The number of slots in use in the option table.		*/
+
+static unsigned			current_generation = 0;				/**< The generation of the config values in memory.		*/
+static unsigned			saved_generation = 0;				/**< The generation of the config values last saved or loaded.	*/
+
+static os_t			write_behind_delay = 0;				/**< The write-behind delay, or zero if disabled.		*/
+static os_t			write_behind_due = 0;				/**< The time at which the pending write-behind is due.	*/
+static osbool			write_behind_pending = FALSE;			/**< TRUE if a write-behind callback is scheduled.		*/
+
+static osbool			snapshot_enabled = FALSE;			/**< TRUE if binary snapshots are in use.			*/
+
+static struct config_observer	*observer_list = NULL;				/**< The chain of change observers.				*/
+static struct config_change	*pending_changes = NULL;			/**< The list of changes awaiting notification.		*/
+static size_t			pending_changes_size = 0;			/**< The number of slots in the pending change list.		*/
+static size_t			pending_changes_count = 0;			/**< The number of changes in the pending change list.		*/
+static osbool			notify_pending = FALSE;				/**< TRUE if a notification callback is scheduled.		*/
+static unsigned			notify_depth = 0;				/**< The depth of nested notifications in progress.		*/
+
+static struct config_section	**section_table = NULL;				/**< The section table, indexing sections by name.		*/
+static size_t			section_table_size = 0;				/**< The number of slots in the section table.			*/
+static size_t			section_table_used = 0;				/**< The number of slots in use in the section table.		*/
+static struct config_section	*section_list = NULL;				/**< The chain of sections, in file order.			*/
+static struct config_section	*section_list_tail = NULL;			/**< The last section in the chain, or NULL.			*/
+static char			*section_text = NULL;				/**< The loaded file holding unparsed section text, or NULL.	*/
+
+
+static void *config_arena_alloc(size_t size);
+static unsigned config_hash_name(char *name);
+static struct config_entry *config_find_entry(char *name, unsigned hash);
+static struct config_entry *config_claim_entry(char *name);
+static osbool config_extend_table(void);
+static char *config_store_string(char *text, size_t size);
+static void config_update_string(char *buffer, char *text);
+static char *config_reuse_string(char *text, size_t length);
+static void config_release_string(char *buffer);
+static void config_opt_update(config_opt *option, osbool value);
+static void config_int_update(config_int *option, int value);
+static osbool config_str_update(config_str *option, char *value);
+static enum config_read_status config_parse_line(char *line, char **token, char **value, char **section);
+static void config_mark_changed(char *section, char *name);
+static void config_cancel_write_behind(void);
+static osbool config_write_behind_callback(os_t time, void *data);
+static unsigned config_hash_add(unsigned hash, char *text);
+static unsigned config_find_schema(void);
+static void config_find_snapshot_file(char *file, size_t len, char *choices);
+static osbool config_load_text(char *file, int size);
+static osbool config_load_snapshot(char *file, bits load_addr, bits exec_addr);
+static void config_save_snapshot(char *file);
+static void config_record_change(char *section, char *name, osbool *flag);
+static osbool config_notify_callback(os_t time, void *data);
+static osbool config_observer_matches(struct config_observer *observer, struct config_change *change);
+static void config_purge_observers(void);
+static osbool config_names_match(char *a, char *b);
+static osbool *config_find_change_flag(char *section, char *name);
+static struct config_entry *config_insert_entry(char *name, unsigned hash);
+static struct config_section *config_find_section(char *name, osbool create);
+static struct config_section *config_probe_section(char *name, unsigned hash, osbool interned);
+static osbool config_load_section(struct config_section *section);
+static struct config_section_value *config_find_section_value(struct config_section *section, char *name, unsigned hash);
+static osbool config_store_section_value(struct config_section *section, char *name, char *value, osbool record);
+static void config_clear_sections(osbool keep);
+static void config_compare_sections(void);
+static char *config_test_section_line(char *line, char *end);
+static osbool config_sections_in_use(void);
+static void config_write_section(FILE *out, struct config_section *section);
+
 
 
 /**
@@ -141,6 +361,365 @@ osbool config_initialise(char *app_name, char *c_dir, char *l_dir, char *s_dir)
 }
 
 
+/**
+ * Allocate memory from the string arena.  The memory remains allocated until
+ * the application exits.
+ *
+ * \param size		The number of bytes to allocate.
+ * \return		Pointer to the memory, or NULL on failure.
+ */
+
+static void *config_arena_alloc(size_t size)
+{
+	struct config_arena_chunk	*chunk;
+	size_t				chunk_size;
+	byte				*memory;
+
+	size = (size + CONFIG_ARENA_ALIGN - 1) & ~(CONFIG_ARENA_ALIGN - 1);
+
+	/* Look for space in the current chunk; if there isn't any, claim a
+	 * new one which is big enough to hold the request.
+	 */
+
+	chunk = arena;
+
+	if (chunk == NULL || (chunk->size - chunk->used) < size) {
+		chunk_size = (size > CONFIG_ARENA_CHUNK) ? size : CONFIG_ARENA_CHUNK;
+
+		chunk = malloc(sizeof(struct config_arena_chunk) + chunk_size);
+		if (chunk == NULL)
+			return NULL;
+
+		chunk->size = chunk_size;
+		chunk->used = 0;
+
+		/* Keep the chunk with the most free space at the head of the arena. */
+
+		if (arena != NULL && (arena->size - arena->used) > (chunk_size - size)) {
+			chunk->next = arena->next;
+			arena->next = chunk;
+		} else {
+			chunk->next = arena;
+			arena = chunk;
+		}
+	}
+
+	memory = (byte *) (chunk + 1) + chunk->used;
+	chunk->used += size;
+
+	return memory;
+}
+
+
+/**
+ * Calculate the hash of a config value name.
+ *
+ * \param *name		The name to hash.
+ * \return		The hash value.
+ */
+
+static unsigned config_hash_name(char *name)
+{
+	if (name == NULL)
+		return 0;
+
+	return config_hash_add(CONFIG_HASH_SEED, name);
+}
+
+
+/**
+ * Add a string to a running hash value.
+ *
+ * \param hash		The hash value to be updated.
+ * \param *text		The text to add to the hash.
+ * \return		The updated hash value.
+ */
+
+static unsigned config_hash_add(unsigned hash, char *text)
+{
+	while (*text != '\0')
+		hash = ((hash << 5) + hash) ^ (unsigned char) *text++;
+
+	return hash;
+}
+
+
+/**
+ * Find the entry for a config value name in the option table.
+ *
+ * \param *name		The name to look up.
+ * \param hash		The hash of the name.
+ * \return		Pointer to the table entry, or NULL if not found.
+ */
+
+static struct config_entry *config_find_entry(char *name, unsigned hash)
+{
+	struct config_entry	*entry;
+	size_t			slot;
+
+	if (option_table == NULL || name == NULL)
+		return NULL;
+
+	slot = hash & (option_table_size - 1);
+
+	for (entry = option_table + slot; entry->name != NULL; entry = option_table + slot) {
+		if (entry->hash == hash && strcmp(entry->name, name) == 0)
+			return entry;
+
+		slot = (slot + 1) & (option_table_size - 1);
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Find or create the entry for a config value name in the option table,
+ * interning a copy of the name in the string arena if it is new.  Names
+ * are truncated to sf_MAX_CONFIG_NAME characters including the terminator.
+ *
+ * The returned pointer is only valid until the next entry is created.
+ *
+ * \param *name		The name to claim an entry for.
+ * \return		Pointer to the table entry, or NULL on failure.
+ */
+
+static struct config_entry *config_claim_entry(char *name)
+{
+	struct config_entry	*entry;
+	char			text[sf_MAX_CONFIG_NAME];
+	unsigned		hash;
+
+	if (name == NULL)
+		return NULL;
+
+	string_copy(text, name, sf_MAX_CONFIG_NAME);
+	hash = config_hash_name(text);
+
+	/* Return any existing entry for the name. */
+
+	entry = config_find_entry(text, hash);
+	if (entry != NULL)
+		return entry;
+
+	return config_insert_entry(text, hash);
+}
+
+
+/**
+ * Add a new entry for a config value name to the option table, interning
+ * a copy of the name in the string arena.  The name must not already be
+ * in the table.
+ *
+ * The returned pointer is only valid until the next entry is created.
+ *
+ * \param *name		The name to create an entry for.
+ * \param hash		The hash of the name.
+ * \return		Pointer to the table entry, or NULL on failure.
+ */
+
+static struct config_entry *config_insert_entry(char *name, unsigned hash)
+{
+	struct config_entry	*entry;
+	size_t			length, slot;
+
+	/* Keep the table no more than three quarters full. */
+
+	if ((4 * (option_table_used + 1)) > (3 * option_table_size) && !config_extend_table())
+		return NULL;
+
+	/* Add a new entry with a copy of the name in the arena. */
+
+	slot = hash & (option_table_size - 1);
+
+	while (option_table[slot].name != NULL)
+		slot = (slot + 1) & (option_table_size - 1);
+
+	entry = option_table + slot;
+
+	length = strlen(name);
+
+	entry->name = config_arena_alloc(length + 1);
+	if (entry->name == NULL)
+		return NULL;
+
+	memcpy(entry->name, name, length + 1);
+	entry->hash = hash;
+	entry->opt = NULL;
+	entry->integer = NULL;
+	entry->str = NULL;
+	entry->changed = FALSE;
+
+	option_table_used++;
+
+	return entry;
+}
+
+
+/**
+ * Double the size of the option table, re-hashing the existing entries
+ * into their new locations.
+ *
+ * \return		TRUE if successful; else FALSE.
+ */
+
+static osbool config_extend_table(void)
+{
+	struct config_entry	*old_table = option_table, *new_table;
+	size_t			old_size = option_table_size, new_size, entry, slot;
+
+	new_size = (old_size == 0) ? CONFIG_TABLE_INITIAL_SIZE : 2 * old_size;
+
+	new_table = calloc(new_size, sizeof(struct config_entry));
+	if (new_table == NULL)
+		return FALSE;
+
+	for (entry = 0; entry < old_size; entry++) {
+		if (old_table[entry].name == NULL)
+			continue;
+
+		slot = old_table[entry].hash & (new_size - 1);
+
+		while (new_table[slot].name != NULL)
+			slot = (slot + 1) & (new_size - 1);
+
+		new_table[slot] = old_table[entry];
+	}
+
+	option_table = new_table;
+	option_table_size = new_size;
+
+	if (old_table != NULL)
+		free(old_table);
+
+	return TRUE;
+}
+
+
+/**
+ * Store a copy of a string in the string arena, in a length-prefixed buffer.
+ * Strings are truncated to sf_MAX_CONFIG_STR characters including the
+ * terminator.
+ *
+ * \param *text		The text to store.
+ * \param size		The number of characters to allow space for, or
+ *			zero to allow just enough for the supplied text.
+ * \return		Pointer to the stored text, or NULL on failure.
+ */
+
+static char *config_store_string(char *text, size_t size)
+{
+	struct config_string	*string;
+
+	if (text == NULL)
+		return NULL;
+
+	if (size == 0)
+		size = strlen(text);
+	else if (size < CONFIG_STR_MIN_BUFFER)
+		size = CONFIG_STR_MIN_BUFFER;
+
+	if (size >= sf_MAX_CONFIG_STR)
+		size = sf_MAX_CONFIG_STR - 1;
+
+	string = config_arena_alloc(sizeof(struct config_string) + size + 1);
+	if (string == NULL)
+		return NULL;
+
+	string->size = size;
+	config_update_string((char *) (string + 1), text);
+
+	return (char *) (string + 1);
+}
+
+
+/**
+ * Update the contents of a length-prefixed string in the string arena,
+ * truncating the new text to fit the available space.
+ *
+ * \param *buffer	Pointer to the text of the string to update.
+ * \param *text		The new text to store.
+ */
+
+static void config_update_string(char *buffer, char *text)
+{
+	struct config_string	*string = (struct config_string *) buffer - 1;
+	size_t			length;
+
+	length = strlen(text);
+	if (length > string->size)
+		length = string->size;
+
+	memcpy(buffer, text, length);
+	buffer[length] = '\0';
+	string->length = length;
+}
+
+
+/**
+ * Find the smallest abandoned text value buffer which can hold a string,
+ * and remove it from the chain of free buffers.
+ *
+ * \param *text		The text to store in the buffer.
+ * \param length	The length of the text, already clamped to the
+ *			maximum length of a text value.
+ * \return		Pointer to the buffer holding the text, or NULL if
+ *			there was no suitable buffer.
+ */
+
+static char *config_reuse_string(char *text, size_t length)
+{
+	char	*buffer, *next, *previous = NULL, *best = NULL, *best_previous = NULL;
+	size_t	size, best_size = 0;
+
+	/* The chain is linked through the first bytes of each buffer's text,
+	 * which aren't aligned to hold a pointer, so the links are copied.
+	 */
+
+	for (buffer = free_strings; buffer != NULL; buffer = next) {
+		memcpy(&next, buffer, sizeof(char *));
+		size = ((struct config_string *) buffer - 1)->size;
+
+		if (size >= length && (best == NULL || size < best_size)) {
+			best = buffer;
+			best_previous = previous;
+			best_size = size;
+		}
+
+		previous = buffer;
+	}
+
+	if (best == NULL)
+		return NULL;
+
+	memcpy(&next, best, sizeof(char *));
+
+	if (best_previous == NULL)
+		free_strings = next;
+	else
+		memcpy(best_previous, &next, sizeof(char *));
+
+	config_update_string(best, text);
+
+	return best;
+}
+
+
+/**
+ * Add a text value buffer which is no longer needed to the chain of free
+ * buffers, so that it can be re-used by another value.  Private buffers
+ * are always at least CONFIG_STR_MIN_BUFFER bytes, so can hold the link.
+ *
+ * \param *buffer	Pointer to the text of the buffer to release.
+ */
+
+static void config_release_string(char *buffer)
+{
+	memcpy(buffer, &free_strings, sizeof(char *));
+	free_strings = buffer;
+}
+
+
 /**
  * Find an opt-config block based on its name.
  *
@@ -150,13 +729,11 @@ osbool config_initialise(char *app_name, char *c_dir, char *l_dir, char *s_dir)
 
 static config_opt *config_find_opt(char *name)
 {
-	config_opt	*block = opt_list;
+	struct config_entry	*entry;
 
+	entry = config_find_entry(name, config_hash_name(name));
 
-	while (block != NULL && (strcmp(block->name, name) != 0))
-		block = block->next;
-
-	return block;
+	return (entry != NULL) ? entry->opt : NULL;
 }
 
 
@@ -170,13 +747,20 @@ static config_opt *config_find_opt(char *name)
 
 int config_opt_init(char *name, osbool value)
 {
-	config_opt	*new;
+	config_opt		*new;
+	struct config_entry	*entry;
+
+	entry = config_claim_entry(name);
+	if (entry == NULL)
+		return FALSE;
 
 	new = malloc(sizeof(config_opt));
 	if (new == NULL)
 		return FALSE;
 
-	string_copy(new->name, name, sf_MAX_CONFIG_NAME);
+	new->name = entry->name;
+	entry->opt = new;
+
 	new->initial = value;
 	new->value = value;
 
@@ -203,12 +787,29 @@ osbool config_opt_set(char *name, osbool value)
 	if (option == NULL)
 		return FALSE;
 
-	option->value = value;
+	config_opt_update(option, value);
 
 	return TRUE;
 }
 
 
+/**
+ * Update the value of a boolean config value.
+ *
+ * \param *option	The config value to update.
+ * \param value		The new value to assign.
+ */
+
+static void config_opt_update(config_opt *option, osbool value)
+{
+	if (option->value == value)
+		return;
+
+	option->value = value;
+	config_mark_changed(NULL, option->name);
+}
+
+
 /**
  * Read a boolean config value.
  *
@@ -237,12 +838,11 @@ osbool config_opt_read(char *name)
 
 static config_int *config_find_int(char *name)
 {
-	config_int	*block = int_list;
+	struct config_entry	*entry;
 
-	while (block != NULL && (strcmp(block->name, name) != 0))
-		block = block->next;
+	entry = config_find_entry(name, config_hash_name(name));
 
-	return block;
+	return (entry != NULL) ? entry->integer : NULL;
 }
 
 
@@ -256,13 +856,20 @@ static config_int *config_find_int(char *name)
 
 osbool config_int_init(char *name, int value)
 {
-	config_int	*new;
+	config_int		*new;
+	struct config_entry	*entry;
+
+	entry = config_claim_entry(name);
+	if (entry == NULL)
+		return FALSE;
 
 	new = malloc(sizeof(config_int));
 	if (new == NULL)
 		return FALSE;
 
-	string_copy(new->name, name, sf_MAX_CONFIG_NAME);
+	new->name = entry->name;
+	entry->integer = new;
+
 	new->initial = value;
 	new->value = value;
 
@@ -289,12 +896,29 @@ osbool config_int_set(char *name, int value)
 	if (option == NULL)
 		return FALSE;
 
-	option->value = value;
+	config_int_update(option, value);
 
 	return TRUE;
 }
 
 
+/**
+ * Update the value of an integer config value.
+ *
+ * \param *option	The config value to update.
+ * \param value		The new value to assign.
+ */
+
+static void config_int_update(config_int *option, int value)
+{
+	if (option->value == value)
+		return;
+
+	option->value = value;
+	config_mark_changed(NULL, option->name);
+}
+
+
 /**
  * Read an integer config value.
  *
@@ -323,12 +947,11 @@ int config_int_read(char *name)
 
 static config_str *config_find_str(char *name)
 {
-	config_str	*block = str_list;
+	struct config_entry	*entry;
 
-	while (block != NULL && (strcmp(block->name, name) != 0))
-		block = block->next;
+	entry = config_find_entry(name, config_hash_name(name));
 
-	return block;
+	return (entry != NULL) ? entry->str : NULL;
 }
 
 
@@ -342,15 +965,30 @@ static config_str *config_find_str(char *name)
 
 osbool config_str_init(char *name, char *value)
 {
-	config_str	*new;
+	config_str		*new;
+	struct config_entry	*entry;
+
+	entry = config_claim_entry(name);
+	if (entry == NULL)
+		return FALSE;
 
 	new = malloc(sizeof(config_str));
 	if (new == NULL)
 		return FALSE;
 
-	string_copy(new->name, name, sf_MAX_CONFIG_NAME);
-	string_copy(new->initial, value, sf_MAX_CONFIG_STR);
-	string_copy(new->value, value, sf_MAX_CONFIG_STR);
+	new->name = entry->name;
+	new->initial = config_store_string(value, 0);
+	if (new->initial == NULL) {
+		free(new);
+		return FALSE;
+	}
+
+	entry->str = new;
+
+	/* The value shares the initial string until it is changed. */
+
+	new->value = new->initial;
+	new->buffer = NULL;
 
 	new->next = str_list;
 	str_list = new;
@@ -369,211 +1007,1776 @@ osbool config_str_init(char *name, char *value)
 
 osbool config_str_set(char *name, char *value)
 {
-	config_str *option;
+	config_str	*option;
 
 	option = config_find_str(name);
-	if (option == NULL)
+	if (option == NULL || value == NULL)
 		return FALSE;
 
-	string_copy(option->value, value, sf_MAX_CONFIG_STR);
-
-	return TRUE;
+	return config_str_update(option, value);
+}
+
+
+/**
+ * Update the value of a text config value.
+ *
+ * \param *option	The config value to update.
+ * \param *value	The new value to assign.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+static osbool config_str_update(config_str *option, char *value)
+{
+	char		*buffer;
+	size_t		length, size;
+
+	if (strcmp(option->value, value) == 0)
+		return TRUE;
+
+	/* If the value is returning to its default, share the initial string again. */
+
+	if (strcmp(option->initial, value) == 0) {
+		option->value = option->initial;
+		config_mark_changed(NULL, option->name);
+		return TRUE;
+	}
+
+	/* Otherwise, the value needs a private buffer.  If the existing buffer
+	 * can't hold the text, swap it for an abandoned buffer which can, or
+	 * allocate a new one with room to grow.  As buffers double in size up
+	 * to sf_MAX_CONFIG_STR, each value outgrows its buffer only a few times,
+	 * and buffers given up by values which shrink are passed on to others.
+	 */
+
+	length = strlen(value);
+	if (length >= sf_MAX_CONFIG_STR)
+		length = sf_MAX_CONFIG_STR - 1;
+
+	size = (option->buffer != NULL) ? ((struct config_string *) option->buffer - 1)->size : 0;
+
+	if (option->buffer == NULL || size < length) {
+		buffer = config_reuse_string(value, length);
+		if (buffer == NULL)
+			buffer = config_store_string(value, (length > 0) ? 2 * length : CONFIG_STR_MIN_BUFFER);
+		if (buffer == NULL)
+			return FALSE;
+	} else if (size > CONFIG_STR_MIN_BUFFER && length < size / 4) {
+		/* A much shorter value gives up a big buffer if a smaller one is free. */
+
+		buffer = config_reuse_string(value, length);
+		if (buffer != NULL && ((struct config_string *) buffer - 1)->size >= size) {
+			config_release_string(buffer);
+			buffer = NULL;
+		}
+
+		if (buffer == NULL)
+			config_update_string(option->buffer, value);
+	} else {
+		buffer = NULL;
+		config_update_string(option->buffer, value);
+	}
+
+	/* Arena memory can't be freed, so keep any old buffer for others. */
+
+	if (buffer != NULL) {
+		if (option->buffer != NULL)
+			config_release_string(option->buffer);
+
+		option->buffer = buffer;
+	}
+
+	option->value = option->buffer;
+	config_mark_changed(NULL, option->name);
+
+	return TRUE;
 }
 
 
 /**
  * Read a string config value.
  *
- * \param *name		The name of the config value to read.
- * \return		Pointer to the value, or to "" if not found.
+ * \param *name		The name of the config value to read.
+ * \return		Pointer to the value, or to "" if not found.
+ */
+
+char *config_str_read(char *name)
+{
+	config_str *option;
+
+	option = config_find_str(name);
+	if (option == NULL)
+		return "";
+
+	return option->value;
+}
+
+
+/**
+ * Read a boolean value from a section.
+ *
+ * \param *section	The name of the section to read from.
+ * \param *name		The name of the value to read.
+ * \return		The value, or FALSE if not found.
+ */
+
+osbool config_section_opt_read(char *section, char *name)
+{
+	return config_read_opt_string(config_section_str_read(section, name));
+}
+
+
+/**
+ * Set a boolean value in a section, creating the section and the value
+ * if required.
+ *
+ * \param *section	The name of the section to update.
+ * \param *name		The name of the value to set.
+ * \param value		The new value to assign.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_section_opt_set(char *section, char *name, osbool value)
+{
+	return config_section_str_set(section, name, config_return_opt_string(value));
+}
+
+
+/**
+ * Read an integer value from a section.
+ *
+ * \param *section	The name of the section to read from.
+ * \param *name		The name of the value to read.
+ * \return		The value, or 0 if not found.
+ */
+
+int config_section_int_read(char *section, char *name)
+{
+	return atoi(config_section_str_read(section, name));
+}
+
+
+/**
+ * Set an integer value in a section, creating the section and the value
+ * if required.
+ *
+ * \param *section	The name of the section to update.
+ * \param *name		The name of the value to set.
+ * \param value		The new value to assign.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_section_int_set(char *section, char *name, int value)
+{
+	char	number[CONFIG_NUMBER_LEN];
+
+	string_printf(number, sizeof(number), "%d", value);
+
+	return config_section_str_set(section, name, number);
+}
+
+
+/**
+ * Read a text value from a section.
+ *
+ * \param *section	The name of the section to read from.
+ * \param *name		The name of the value to read.
+ * \return		Pointer to the value, or to "" if not found.
+ */
+
+char *config_section_str_read(char *section, char *name)
+{
+	struct config_section		*block;
+	struct config_section_value	*value;
+
+	if (name == NULL)
+		return "";
+
+	block = config_find_section(section, FALSE);
+	if (block == NULL || !config_load_section(block))
+		return "";
+
+	value = config_find_section_value(block, name, config_hash_name(name));
+	if (value == NULL)
+		return "";
+
+	return value->value;
+}
+
+
+/**
+ * Set a text value in a section, creating the section and the value
+ * if required.
+ *
+ * \param *section	The name of the section to update.
+ * \param *name		The name of the value to set.
+ * \param *value	The new value to assign.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_section_str_set(char *section, char *name, char *value)
+{
+	struct config_section	*block;
+
+	if (name == NULL || value == NULL)
+		return FALSE;
+
+	block = config_find_section(section, TRUE);
+	if (block == NULL || !config_load_section(block))
+		return FALSE;
+
+	return config_store_section_value(block, name, value, TRUE);
+}
+
+
+/**
+ * Test whether a section exists.
+ *
+ * \param *section	The name of the section to test.
+ * \return		TRUE if the section exists; else FALSE.
+ */
+
+osbool config_section_exists(char *section)
+{
+	return (config_find_section(section, FALSE) != NULL) ? TRUE : FALSE;
+}
+
+
+/**
+ * Delete a section and all of the values within it.
+ *
+ * \param *section	The name of the section to delete.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_section_delete(char *section)
+{
+	struct config_section	*block;
+	size_t			slot;
+
+	block = config_find_section(section, FALSE);
+	if (block == NULL)
+		return FALSE;
+
+	for (slot = 0; slot < block->values_size; slot++)
+		free(block->values[slot].value);
+
+	free(block->values);
+
+	block->values = NULL;
+	block->values_size = 0;
+	block->values_used = 0;
+	block->text = NULL;
+	block->deleted = TRUE;
+
+	config_mark_changed(block->name, NULL);
+
+	return TRUE;
+}
+
+
+/**
+ * Find a section in the section table, optionally creating it if it does
+ * not exist.  Sections are not loaded by this call.
+ *
+ * \param *name		The name of the section to find.
+ * \param create	TRUE to create the section if required; else FALSE.
+ * \return		Pointer to the section, or NULL if not found.
+ */
+
+static struct config_section *config_find_section(char *name, osbool create)
+{
+	struct config_section	*section, **old_table, **new_table;
+	unsigned		hash;
+	size_t			slot, old_size, new_size, length;
+
+	if (name == NULL)
+		return NULL;
+
+	hash = config_hash_name(name);
+
+	if (section_table != NULL) {
+		section = config_probe_section(name, hash, FALSE);
+
+		/* A deleted section can be revived if required. */
+
+		if (section != NULL && section->deleted) {
+			if (!create)
+				return NULL;
+
+			section->deleted = FALSE;
+		}
+
+		if (section != NULL || !create)
+			return section;
+	} else if (!create) {
+		return NULL;
+	}
+
+	/* Keep the table no more than three quarters full. */
+
+	if ((4 * (section_table_used + 1)) > (3 * section_table_size)) {
+		old_table = section_table;
+		old_size = section_table_size;
+		new_size = (old_size == 0) ? CONFIG_SECTION_TABLE_INITIAL_SIZE : 2 * old_size;
+
+		new_table = calloc(new_size, sizeof(struct config_section *));
+		if (new_table == NULL)
+			return NULL;
+
+		for (slot = 0; slot < old_size; slot++) {
+			if (old_table[slot] == NULL)
+				continue;
+
+			length = old_table[slot]->hash & (new_size - 1);
+
+			while (new_table[length] != NULL)
+				length = (length + 1) & (new_size - 1);
+
+			new_table[length] = old_table[slot];
+		}
+
+		section_table = new_table;
+		section_table_size = new_size;
+
+		free(old_table);
+	}
+
+	/* Create the new section, and link it in to the end of the chain. */
+
+	section = malloc(sizeof(struct config_section));
+	if (section == NULL)
+		return NULL;
+
+	length = strlen(name);
+
+	section->name = config_arena_alloc(length + 1);
+	if (section->name == NULL) {
+		free(section);
+		return NULL;
+	}
+
+	memcpy(section->name, name, length + 1);
+	section->hash = hash;
+	section->deleted = FALSE;
+	section->changed = FALSE;
+	section->text = NULL;
+	section->text_end = NULL;
+	section->values = NULL;
+	section->values_size = 0;
+	section->values_used = 0;
+	section->previous = NULL;
+	section->previous_size = 0;
+	section->previous_exists = FALSE;
+	section->next = NULL;
+
+	slot = hash & (section_table_size - 1);
+
+	while (section_table[slot] != NULL)
+		slot = (slot + 1) & (section_table_size - 1);
+
+	section_table[slot] = section;
+	section_table_used++;
+
+	if (section_list_tail != NULL)
+		section_list_tail->next = section;
+	else
+		section_list = section;
+
+	section_list_tail = section;
+
+	return section;
+}
+
+
+/**
+ * Look a section up in the section table, including sections which have
+ * been deleted.
+ *
+ * \param *name		The name of the section to find.
+ * \param hash		The hash of the name.
+ * \param interned	TRUE if the name is a section's own name, so that
+ *			it can be matched by address; FALSE to compare text.
+ * \return		Pointer to the section, or NULL if not found.
+ */
+
+static struct config_section *config_probe_section(char *name, unsigned hash, osbool interned)
+{
+	struct config_section	*section;
+	size_t			slot;
+
+	if (section_table == NULL)
+		return NULL;
+
+	slot = hash & (section_table_size - 1);
+
+	for (section = section_table[slot]; section != NULL; section = section_table[slot]) {
+		if (section->hash == hash && (interned ? (section->name == name) : (strcmp(section->name, name) == 0)))
+			return section;
+
+		slot = (slot + 1) & (section_table_size - 1);
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Ensure that a section has been loaded, by parsing any of its text which
+ * remains in the file loaded by config_load().
+ *
+ * \param *section	The section to load.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+static osbool config_load_section(struct config_section *section)
+{
+	char	*line, *next, *token, *contents;
+	osbool	success = TRUE;
+
+	if (section->text == NULL)
+		return TRUE;
+
+	/* The section's text is tokenised in place, and is then no longer required. */
+
+	for (line = section->text; line < section->text_end; line = next) {
+		next = memchr(line, '\n', section->text_end - line);
+		if (next != NULL)
+			*next++ = '\0';
+		else
+			next = section->text_end;
+
+		if (config_parse_line(line, &token, &contents, NULL) == sf_CONFIG_READ_VALUE_RETURNED &&
+				!config_store_section_value(section, token, contents, FALSE))
+			success = FALSE;
+	}
+
+	section->text = NULL;
+
+	return success;
+}
+
+
+/**
+ * Find a value in a section's value table.
+ *
+ * \param *section	The section to search.
+ * \param *name		The name of the value to find.
+ * \param hash		The hash of the name.
+ * \return		Pointer to the value, or NULL if not found.
+ */
+
+static struct config_section_value *config_find_section_value(struct config_section *section, char *name, unsigned hash)
+{
+	struct config_section_value	*value;
+	size_t				slot;
+
+	if (section->values == NULL)
+		return NULL;
+
+	slot = hash & (section->values_size - 1);
+
+	for (value = section->values + slot; value->name != NULL; value = section->values + slot) {
+		if (value->hash == hash && strcmp(value->name, name) == 0)
+			return value;
+
+		slot = (slot + 1) & (section->values_size - 1);
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Store a value in a section, creating it if required.
+ *
+ * \param *section	The section to update.
+ * \param *name		The name of the value to store.
+ * \param *value	The text of the value to store.
+ * \param record	TRUE to record the change; FALSE if the value is
+ *			being loaded from file.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+static osbool config_store_section_value(struct config_section *section, char *name, char *value, osbool record)
+{
+	struct config_section_value	*slot, *old_values, *new_values;
+	struct config_entry		*entry;
+	unsigned			hash;
+	size_t				index, old_size, new_size, target;
+	char				*copy;
+
+	hash = config_hash_name(name);
+
+	slot = config_find_section_value(section, name, hash);
+
+	if (slot != NULL && strcmp(slot->value, value) == 0)
+		return TRUE;
+
+	copy = strdup(value);
+	if (copy == NULL)
+		return FALSE;
+
+	/* Add a new value to the table if the name isn't already there. */
+
+	if (slot == NULL) {
+		if ((4 * (section->values_used + 1)) > (3 * section->values_size)) {
+			old_values = section->values;
+			old_size = section->values_size;
+			new_size = (old_size == 0) ? CONFIG_SECTION_VALUES_INITIAL_SIZE : 2 * old_size;
+
+			new_values = calloc(new_size, sizeof(struct config_section_value));
+			if (new_values == NULL) {
+				free(copy);
+				return FALSE;
+			}
+
+			for (index = 0; index < old_size; index++) {
+				if (old_values[index].name == NULL)
+					continue;
+
+				target = old_values[index].hash & (new_size - 1);
+
+				while (new_values[target].name != NULL)
+					target = (target + 1) & (new_size - 1);
+
+				new_values[target] = old_values[index];
+			}
+
+			section->values = new_values;
+			section->values_size = new_size;
+
+			free(old_values);
+		}
+
+		/* Names are shared between sections via the option table. */
+
+		entry = config_find_entry(name, hash);
+		if (entry == NULL)
+			entry = config_insert_entry(name, hash);
+
+		if (entry == NULL) {
+			free(copy);
+			return FALSE;
+		}
+
+		index = hash & (section->values_size - 1);
+
+		while (section->values[index].name != NULL)
+			index = (index + 1) & (section->values_size - 1);
+
+		slot = section->values + index;
+		slot->hash = hash;
+		slot->name = entry->name;
+		slot->value = NULL;
+		slot->changed = FALSE;
+
+		section->values_used++;
+	}
+
+	free(slot->value);
+	slot->value = copy;
+
+	if (record)
+		config_mark_changed(section->name, slot->name);
+
+	return TRUE;
+}
+
+
+/**
+ * Discard the contents of all of the sections, along with any unparsed
+ * section text.
+ *
+ * \param keep		TRUE to parse the sections and keep their values,
+ *			so that config_compare_sections() can report the
+ *			changes made by a reload; FALSE to free them.
+ */
+
+static void config_clear_sections(osbool keep)
+{
+	struct config_section	*section;
+	size_t			slot;
+
+	for (section = section_list; section != NULL; section = section->next) {
+		if (keep) {
+			config_load_section(section);
+
+			section->previous = section->values;
+			section->previous_size = section->values_size;
+			section->previous_exists = !section->deleted;
+		} else {
+			for (slot = 0; slot < section->values_size; slot++)
+				free(section->values[slot].value);
+
+			free(section->values);
+		}
+
+		section->values = NULL;
+		section->values_size = 0;
+		section->values_used = 0;
+		section->text = NULL;
+		section->deleted = TRUE;
+	}
+
+	free(section_text);
+	section_text = NULL;
+}
+
+
+/**
+ * Compare the sections loaded by a reload with the values kept by
+ * config_clear_sections(), recording any changes and then freeing the
+ * old values.  Any sections still unparsed are parsed, so that they
+ * can be compared.
+ */
+
+static void config_compare_sections(void)
+{
+	struct config_section		*section, previous;
+	struct config_section_value	*value, *old;
+	size_t				slot;
+
+	for (section = section_list; section != NULL; section = section->next) {
+		if (!section->deleted)
+			config_load_section(section);
+
+		previous.values = section->previous;
+		previous.values_size = section->previous_size;
+
+		if (section->deleted) {
+			if (section->previous_exists)
+				config_mark_changed(section->name, NULL);
+		} else {
+			/* Record values which are new or different... */
+
+			for (slot = 0; slot < section->values_size; slot++) {
+				value = section->values + slot;
+				if (value->name == NULL)
+					continue;
+
+				old = config_find_section_value(&previous, value->name, value->hash);
+				if (old == NULL || strcmp(old->value, value->value) != 0)
+					config_mark_changed(section->name, value->name);
+			}
+
+			/* ...and values which have gone, using their old flags. */
+
+			for (slot = 0; slot < section->previous_size; slot++) {
+				old = section->previous + slot;
+				if (old->name == NULL || config_find_section_value(section, old->name, old->hash) != NULL)
+					continue;
+
+				current_generation++;
+
+				if (observer_list != NULL)
+					config_record_change(section->name, old->name, &(old->changed));
+			}
+		}
+
+		for (slot = 0; slot < section->previous_size; slot++)
+			free(section->previous[slot].value);
+
+		free(section->previous);
+
+		section->previous = NULL;
+		section->previous_size = 0;
+		section->previous_exists = FALSE;
+	}
+}
+
+
+/**
+ * Test whether any sections are in use.
+ *
+ * \return		TRUE if there are sections; else FALSE.
+ */
+
+static osbool config_sections_in_use(void)
+{
+	struct config_section	*section;
+
+	for (section = section_list; section != NULL; section = section->next) {
+		if (!section->deleted)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+/**
+ * Write a section to a choices file.  Sections which have not been loaded
+ * are copied directly from the unparsed text.
+ *
+ * \param *out		The file to write to.
+ * \param *section	The section to write.
+ */
+
+static void config_write_section(FILE *out, struct config_section *section)
+{
+	struct config_section_value	*value;
+	size_t				slot, length;
+
+	fprintf(out, "\n[%s]\n", section->name);
+
+	if (section->text != NULL) {
+		length = section->text_end - section->text;
+		fwrite(section->text, 1, length, out);
+
+		if (length > 0 && section->text[length - 1] != '\n')
+			fputc('\n', out);
+
+		return;
+	}
+
+	for (slot = 0; slot < section->values_size; slot++) {
+		value = section->values + slot;
+
+		if (value->name == NULL)
+			continue;
+
+		if (*value->value == '\0')
+			fprintf(out, "%s: \"\"\n", value->name);
+		else
+			config_write_token_pair(out, value->name, value->value);
+	}
+}
+
+
+/**
+ * Test a line from a choices file to see if it is a section header.  The
+ * line need not be terminated, and is only modified if it is a header.
+ *
+ * \param *line		The start of the line to test.
+ * \param *end		The end of the line to test.
+ * \return		Pointer to the terminated section name, or NULL if the
+ *			line is not a section header.
+ */
+
+static char *config_test_section_line(char *line, char *end)
+{
+	if (*line == '#')
+		return NULL;
+
+	while (line < end && isspace((unsigned char) *line))
+		line++;
+
+	while (end > line && isspace((unsigned char) *(end - 1)))
+		end--;
+
+	if ((end - line) < 2 || *line != '[' || *(end - 1) != ']')
+		return NULL;
+
+	*(end - 1) = '\0';
+
+	return line + 1;
+}
+
+
+/**
+ * Get a filename for the file to load the choices settings from.  The global
+ * Choices: paths are tried first; fall back to the application folder.
+ *
+ * \param *file			A buffer to hold a full pathname.
+ * \param len			The size of the buffer.
+ * \param *leaf			The leaf file name to use.
+ */
+
+void config_find_load_file(char *file, size_t len, char *leaf)
+{
+	fileswitch_object_type	type;
+	struct string_builder	path;
+
+	string_builder_init(&path, file, len);
+	string_builder_append_strings(&path, "Choices:", choices_dir, ".", leaf, NULL);
+
+	if (xosfile_read_no_path(file, &type, NULL, NULL, NULL, NULL) != NULL || type != fileswitch_IS_FILE) {
+		string_builder_reset(&path);
+		string_builder_append_strings(&path, local_dir, ".", NULL);
+
+		if (local_sub_dir != NULL)
+			string_builder_append_strings(&path, local_sub_dir, ".", NULL);
+
+		string_builder_append(&path, leaf);
+
+		if (xosfile_read_no_path(file, &type, NULL, NULL, NULL, NULL) != NULL || type != fileswitch_IS_FILE)
+			*file = '\0';
+	}
+}
+
+
+/**
+ * Get a filename for the file to save the choices settings to.  <Choices$Write>
+ * is tried first; if this fails the application folder is used.
+ *
+ * \param *file			A buffer to hold a full pathname.
+ * \param len			The size of the buffer.
+ * \param *leaf			The leaf file name to use.
+ */
+
+void config_find_save_file(char *file, size_t len, char *leaf)
+{
+	fileswitch_object_type	type;
+	struct string_builder	path;
+	int			var_len;
+
+	string_builder_init(&path, file, len);
+
+	os_read_var_val_size("Choices$Write", 0, os_VARTYPE_STRING, &var_len, NULL);
+
+	/* Build the directory first, creating it if required, and then extend
+	 * it in place with the leafname.
+	 */
+
+	if (var_len == 0) {
+		string_builder_append(&path, local_dir);
+
+		if (local_sub_dir != NULL) {
+			string_builder_append_strings(&path, ".", local_sub_dir, NULL);
+
+			if (xosfile_read_no_path(file, &type, NULL, NULL, NULL, NULL) == NULL || type == fileswitch_NOT_FOUND)
+				osfile_create_dir(file, 0);
+		}
+	} else {
+		string_builder_append_strings(&path, "<Choices$Write>.", choices_dir, NULL);
+
+		if (xosfile_read_no_path(file, &type, NULL, NULL, NULL, NULL) == NULL || type == fileswitch_NOT_FOUND)
+			osfile_create_dir(file, 0);
+	}
+
+	string_builder_append_strings(&path, ".", leaf, NULL);
+}
+
+
+/**
+ * Load the currently saved configuration into memory, overriding any settings
+ * currently stored in memory.
+ *
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_load(void)
+{
+	char			file[sf_MAX_CONFIG_FILE_BUFFER];
+	int			size;
+	bits			load_addr, exec_addr;
+	fileswitch_object_type	type;
+	os_error		*error;
+	osbool			clean, loaded, recording;
+
+
+	/* Find the options.  First try the Choices: file then the one in the application. */
+
+	config_find_load_file(file, sizeof(file), "Choices");
+
+	if (*file == '\0')
+		return FALSE;
+
+	error = xosfile_read_stamped_no_path(file, &type, &load_addr, &exec_addr, &size, NULL, NULL);
+	if (error != NULL || type != fileswitch_IS_FILE)
+		return FALSE;
+
+	clean = (current_generation == saved_generation) ? TRUE : FALSE;
+
+	/* Any existing sections are replaced by those in the file.  If there
+	 * are observers, the old values are kept so that the changes can be
+	 * reported in the same way as changes to the global values.
+	 */
+
+	recording = (observer_list != NULL) ? TRUE : FALSE;
+
+	config_clear_sections(recording);
+
+	/* Use a valid binary snapshot if there is one; otherwise parse the text. */
+
+	loaded = snapshot_enabled && config_load_snapshot(file, load_addr, exec_addr);
+
+	if (!loaded)
+		loaded = config_load_text(file, size);
+
+	if (recording)
+		config_compare_sections();
+
+	/* If there were no unsaved changes before the load, the values in
+	 * memory now match those on disc.
+	 */
+
+	if (loaded && clean) {
+		saved_generation = current_generation;
+		config_cancel_write_behind();
+	}
+
+	return loaded;
+}
+
+
+/**
+ * Load config values from a textual choices file.
+ *
+ * \param *file		The name of the file to load.
+ * \param size		The size of the file, in bytes.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+static osbool config_load_text(char *file, int size)
+{
+	char			*data, *line, *end, *eol, *next, *token, *contents, *name;
+	struct config_entry	*entry;
+	struct config_section	*section = NULL;
+	osbool			eager = FALSE, lazy = FALSE;
+
+	/* Load the file into memory in one go. */
+
+	data = malloc(size + 1);
+	if (data == NULL)
+		return FALSE;
+
+	if (xosfile_load_stamped_no_path(file, (byte *) data, NULL, NULL, NULL, NULL, NULL) != NULL) {
+		free(data);
+		return FALSE;
+	}
+
+	/* Tokenise the global values in place, a line at a time.  Once the
+	 * sections start, their text is just indexed, to be parsed when each
+	 * one is first accessed.
+	 */
+
+	end = data + size;
+	*end = '\0';
+
+	for (line = data; line < end; line = next) {
+		eol = memchr(line, '\n', end - line);
+		if (eol != NULL)
+			next = eol + 1;
+		else
+			next = eol = end;
+
+		name = config_test_section_line(line, eol);
+
+		if (name != NULL) {
+			if (section != NULL)
+				section->text_end = line;
+
+			/* If a section appears twice, its later parts are loaded straight away. */
+
+			section = config_find_section(name, TRUE);
+			if (section == NULL)
+				continue;
+
+			eager = (section->text != NULL || section->values != NULL) ? TRUE : FALSE;
+
+			if (eager) {
+				config_load_section(section);
+			} else {
+				section->text = next;
+				section->text_end = end;
+				lazy = TRUE;
+			}
+
+			continue;
+		}
+
+		if (section != NULL && !eager)
+			continue;
+
+		*eol = '\0';
+
+		if (config_parse_line(line, &token, &contents, NULL) != sf_CONFIG_READ_VALUE_RETURNED)
+			continue;
+
+		if (section != NULL) {
+			config_store_section_value(section, token, contents, FALSE);
+			continue;
+		}
+
+		/* If the token can be matched to a current setting, save it. */
+
+		entry = config_find_entry(token, config_hash_name(token));
+		if (entry == NULL)
+			continue;
+
+		if (entry->opt != NULL)
+			config_opt_update(entry->opt, config_read_opt_string(contents));
+		else if (entry->integer != NULL)
+			config_int_update(entry->integer, atoi(contents));
+		else if (entry->str != NULL)
+			config_str_update(entry->str, contents);
+	}
+
+	/* Keep the file if any sections are waiting to be parsed. */
+
+	if (lazy)
+		section_text = data;
+	else
+		free(data);
+
+	return TRUE;
+}
+
+
+/**
+ * Load config values from a binary snapshot, if one exists alongside the
+ * supplied choices file, is newer than it, and matches the current schema.
+ *
+ * \param *file		The name of the textual choices file.
+ * \param load_addr	The load address of the textual choices file.
+ * \param exec_addr	The execution address of the textual choices file.
+ * \return		TRUE if the snapshot was loaded; else FALSE.
+ */
+
+static osbool config_load_snapshot(char *file, bits load_addr, bits exec_addr)
+{
+	char				snapshot[sf_MAX_CONFIG_FILE_BUFFER];
+	int				size;
+	bits				snap_load_addr, snap_exec_addr;
+	byte				*data, *opts, *strs, *end, *scan;
+	int				*ints;
+	size_t				int_count, opt_count, str_count, count;
+	struct config_snapshot_header	*header;
+	fileswitch_object_type		type;
+	config_opt			*opt_block;
+	config_int			*int_block;
+	config_str			*str_block;
+
+	config_find_snapshot_file(snapshot, sizeof(snapshot), file);
+
+	if (xosfile_read_stamped_no_path(snapshot, &type, &snap_load_addr, &snap_exec_addr, &size, NULL, NULL) != NULL ||
+			type != fileswitch_IS_FILE || size < (int) sizeof(struct config_snapshot_header))
+		return FALSE;
+
+	/* Compare the five-byte datestamps: the snapshot mustn't be older than the text. */
+
+	if ((snap_load_addr & 0xffu) < (load_addr & 0xffu) ||
+			((snap_load_addr & 0xffu) == (load_addr & 0xffu) && snap_exec_addr < exec_addr))
+		return FALSE;
+
+	data = malloc(size);
+	if (data == NULL)
+		return FALSE;
+
+	if (xosfile_load_stamped_no_path(snapshot, data, NULL, NULL, NULL, NULL, NULL) != NULL) {
+		free(data);
+		return FALSE;
+	}
+
+	/* Count the registered config values. */
+
+	int_count = 0;
+	for (int_block = int_list; int_block != NULL; int_block = int_block->next)
+		int_count++;
+
+	opt_count = 0;
+	for (opt_block = opt_list; opt_block != NULL; opt_block = opt_block->next)
+		opt_count++;
+
+	str_count = 0;
+	for (str_block = str_list; str_block != NULL; str_block = str_block->next)
+		str_count++;
+
+	/* Validate the header against the registered config values, before
+	 * trusting any of the counts that it contains.
+	 */
+
+	header = (struct config_snapshot_header *) data;
+	end = data + size;
+
+	if (header->magic != CONFIG_SNAPSHOT_MAGIC || header->version != CONFIG_SNAPSHOT_VERSION ||
+			header->size != (unsigned) size || header->schema != config_find_schema() ||
+			header->int_count != int_count || header->opt_count != opt_count ||
+			header->str_count != str_count ||
+			sizeof(struct config_snapshot_header) + (int_count * sizeof(int)) + opt_count + str_count > (size_t) size) {
+		free(data);
+		return FALSE;
+	}
+
+	ints = (int *) (header + 1);
+	opts = (byte *) (ints + int_count);
+	strs = opts + opt_count;
+
+	/* The text values must fill the rest of the snapshot exactly. */
+
+	for (scan = strs, count = 0; count < str_count; count++) {
+		scan = memchr(scan, '\0', end - scan);
+		if (scan == NULL)
+			break;
+
+		scan++;
+	}
+
+	if (scan != end) {
+		free(data);
+		return FALSE;
+	}
+
+	/* Apply the values which differ from the defaults, exactly as if they
+	 * had been read from the text file.  The counts have been checked
+	 * against the chains, so each value has a place in the snapshot.
+	 */
+
+	for (int_block = int_list; int_block != NULL; int_block = int_block->next, ints++) {
+		if (*ints != int_block->initial)
+			config_int_update(int_block, *ints);
+	}
+
+	for (opt_block = opt_list; opt_block != NULL; opt_block = opt_block->next, opts++) {
+		if ((*opts != 0) != (opt_block->initial != FALSE))
+			config_opt_update(opt_block, (*opts != 0) ? TRUE : FALSE);
+	}
+
+	for (str_block = str_list; str_block != NULL; str_block = str_block->next) {
+		if (strcmp((char *) strs, str_block->initial) != 0)
+			config_str_update(str_block, (char *) strs);
+
+		strs += strlen((char *) strs) + 1;
+	}
+
+	free(data);
+
+	return TRUE;
+}
+
+
+/**
+ * Save the current configuration from memory into the applicable Choices
+ * file, recording only those values which differ from the defaults.  If
+ * no values have changed since the last save or load, nothing is written.
+ *
+ * The new file is written under a temporary name and then renamed, so that
+ * the existing file is left intact if the save fails.
+ *
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_save(void)
+{
+	char		file[sf_MAX_CONFIG_FILE_BUFFER], temp[sf_MAX_CONFIG_FILE_BUFFER];
+	FILE		*out;
+	config_opt	*opt_block;
+	config_int	*int_block;
+	config_str	*str_block;
+	struct config_section	*section;
+	osbool		error;
+
+
+	config_cancel_write_behind();
+
+	/* If nothing has changed since the last save or load, there's nothing to do. */
+
+	if (current_generation == saved_generation)
+		return TRUE;
+
+	config_find_save_file(file, sizeof(file), "Choices");
+	config_find_save_file(temp, sizeof(temp), CONFIG_SAVE_TEMP_LEAF);
+
+	if (*file == '\0' || *temp == '\0')
+		return FALSE;
+
+	/* Write the choices to a temporary file, so that the existing file
+	 * remains intact if anything goes wrong.
+	 */
+
+	out = fopen(temp, "w");
+
+	if (out == NULL)
+		return FALSE;
+
+	fprintf(out, "# >Choices for %s\n\n", application_name);
+
+	/* Do the opt configs */
+
+	opt_block = opt_list;
+
+	while (opt_block != NULL) {
+		if (opt_block->value != opt_block->initial)
+			fprintf(out, "%s: %s\n", opt_block->name, config_return_opt_string(opt_block->value));
+
+		opt_block = opt_block->next;
+	}
+
+	/* Do the int configs */
+
+	int_block = int_list;
+
+	while (int_block != NULL) {
+		if (int_block->value != int_block->initial)
+			fprintf(out, "%s: %d\n", int_block->name, int_block->value);
+
+		int_block = int_block->next;
+	}
+
+	/* Do the str configs */
+
+	str_block = str_list;
+
+	while (str_block != NULL) {
+		if (str_block->value != str_block->initial)
+			fprintf(out, "%s: \"%s\"\n", str_block->name, str_block->value);
+
+		str_block = str_block->next;
+	}
+
+	/* Do the sections. */
+
+	for (section = section_list; section != NULL; section = section->next) {
+		if (!section->deleted)
+			config_write_section(out, section);
+	}
+
+	error = (ferror(out) != 0) ? TRUE : FALSE;
+
+	if (fclose(out) != 0 || error) {
+		remove(temp);
+		return FALSE;
+	}
+
+	/* Replace the old file with the new one.  If the filing system won't
+	 * rename over an existing file, the old one must be deleted first.
+	 */
+
+	if (rename(temp, file) != 0 && (remove(file) != 0 || rename(temp, file) != 0))
+		return FALSE;
+
+	saved_generation = current_generation;
+
+	/* The snapshot is written after the text file, so that it is newer.
+	 * Snapshots don't hold sections, so they can't be used if there are any.
+	 */
+
+	if (snapshot_enabled && !config_sections_in_use()) {
+		config_save_snapshot(file);
+	} else if (snapshot_enabled) {
+		config_find_snapshot_file(temp, sizeof(temp), file);
+		remove(temp);
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Set the write-behind delay, after which changes to the config values will
+ * be saved automatically.  Changes made within the delay of each other are
+ * saved together once the delay has passed since the most recent.
+ *
+ * \param delay		The write-behind delay in centiseconds, or zero
+ *			to disable write-behind.
  */
 
-char *config_str_read(char *name)
+void config_set_write_behind(os_t delay)
 {
-	config_str *option;
-
-	option = config_find_str(name);
-	if (option == NULL)
-		return "";
+	write_behind_delay = (delay > 0) ? delay : 0;
 
-	return option->value;
+	if (write_behind_delay == 0)
+		config_cancel_write_behind();
 }
 
 
 /**
- * Get a filename for the file to load the choices settings from.  The global
- * Choices: paths are tried first; fall back to the application folder.
+ * Record that a config value has changed, and schedule a write-behind
+ * save and change notification if required.
  *
- * \param *file			A buffer to hold a full pathname.
- * \param len			The size of the buffer.
- * \param *leaf			The leaf file name to use.
+ * \param *section	The section containing the value, or NULL for the
+ *			global values.
+ * \param *name		The name of the value which has changed.
  */
 
-void config_find_load_file(char *file, size_t len, char *leaf)
+static void config_mark_changed(char *section, char *name)
 {
-	fileswitch_object_type type;
+	os_t	time;
 
-	string_printf(file, len, "Choices:%s.%s", choices_dir, leaf);
+	current_generation++;
 
-	if (xosfile_read_no_path(file, &type, NULL, NULL, NULL, NULL) != NULL || type != fileswitch_IS_FILE) {
-		if (local_sub_dir != NULL)
-			string_printf(file, len, "%s.%s.%s", local_dir, local_sub_dir, leaf);
-		else
-			string_printf(file, len, "%s.%s", local_dir, leaf);
+	if (observer_list != NULL)
+		config_record_change(section, name, NULL);
 
-		if (xosfile_read_no_path(file, &type, NULL, NULL, NULL, NULL) != NULL || type != fileswitch_IS_FILE)
-			*file = '\0';
-	}
+	if (write_behind_delay == 0 || xos_read_monotonic_time(&time) != NULL)
+		return;
+
+	write_behind_due = time + write_behind_delay;
+
+	if (!write_behind_pending)
+		write_behind_pending = event_add_single_callback(NULL, write_behind_delay, config_write_behind_callback, NULL);
 }
 
 
 /**
- * Get a filename for the file to save the choices settings to.  <Choices$Write>
- * is tried first; if this fails the application folder is used.
- *
- * \param *file			A buffer to hold a full pathname.
- * \param len			The size of the buffer.
- * \param *leaf			The leaf file name to use.
+ * Cancel any pending write-behind save.
  */
 
-void config_find_save_file(char *file, size_t len, char *leaf)
+static void config_cancel_write_behind(void)
 {
-	fileswitch_object_type type;
-	int var_len;
+	if (!write_behind_pending)
+		return;
 
-	*file = '\0';
+	event_delete_callback(config_write_behind_callback);
+	write_behind_pending = FALSE;
+}
 
-	os_read_var_val_size("Choices$Write", 0, os_VARTYPE_STRING, &var_len, NULL);
 
-	if (var_len == 0) {
-		if (local_sub_dir != NULL) {
-			string_printf(file, len, "%s.%s", local_dir, local_sub_dir);
+/**
+ * Callback to perform a write-behind save, once the delay has passed since
+ * the most recent change.
+ *
+ * \param time		The time of the callback.
+ * \param *data		Unused.
+ * \return		FALSE, to allow the Null event to be passed on.
+ */
 
-			if (xosfile_read_no_path(file, &type, NULL, NULL, NULL, NULL) == NULL || type == fileswitch_NOT_FOUND)
-				osfile_create_dir(file, 0);
+static osbool config_write_behind_callback(os_t time, void *data)
+{
+	write_behind_pending = FALSE;
 
-			string_printf(file, len, "%s.%s.%s", local_dir, local_sub_dir, leaf);
-		} else {
-			string_printf(file, len, "%s.%s", local_dir, leaf);
-		}
-	} else {
-		string_printf(file, len, "<Choices$Write>.%s", choices_dir);
-		if (xosfile_read_no_path(file, &type, NULL, NULL, NULL, NULL) == NULL || type == fileswitch_NOT_FOUND)
-			osfile_create_dir(file, 0);
+	/* If there have been further changes, wait for things to settle. */
 
-		string_printf(file, len, "<Choices$Write>.%s.%s", choices_dir, leaf);
+	if ((write_behind_due - time) > 0) {
+		write_behind_pending = event_add_single_callback(NULL, write_behind_due - time, config_write_behind_callback, NULL);
+		return FALSE;
 	}
+
+	config_save();
+
+	return FALSE;
 }
 
 
 /**
- * Load the currently saved configuration into memory, overriding any settings
- * currently stored in memory.
+ * Enable or disable the use of binary snapshots of the config values.  When
+ * enabled, config_save() writes a snapshot alongside the textual choices
+ * file, and config_load() uses it in place of the text if it is newer and
+ * matches the registered config values.
  *
- * \return		TRUE if successful; else FALSE.
+ * \param enable	TRUE to use binary snapshots; FALSE to disable them.
  */
 
-osbool config_load(void)
+void config_set_snapshot(osbool enable)
 {
-	char		file[sf_MAX_CONFIG_FILE_BUFFER], token[sf_MAX_CONFIG_FILE_BUFFER], contents[sf_MAX_CONFIG_FILE_BUFFER];
-	FILE		*in;
+	snapshot_enabled = enable;
+}
 
 
-	/* Find the options.  First try the Choices: file then the one in the application. */
+/**
+ * Write a binary snapshot of the current config values alongside the
+ * supplied choices file.  Failures are ignored, as the snapshot is only
+ * a cache of the text file.
+ *
+ * \param *file		The name of the textual choices file.
+ */
 
-	config_find_load_file(file, sizeof(file), "Choices");
+static void config_save_snapshot(char *file)
+{
+	char				snapshot[sf_MAX_CONFIG_FILE_BUFFER];
+	size_t				size, length;
+	byte				*data, *opts, *strs;
+	int				*ints;
+	struct config_snapshot_header	*header;
+	config_opt			*opt_block;
+	config_int			*int_block;
+	config_str			*str_block;
 
-	if (file == NULL || *file == '\0')
-		return FALSE;
+	config_find_snapshot_file(snapshot, sizeof(snapshot), file);
 
-	/* If a config file was found, use it. */
+	/* Count the values and calculate the size of the snapshot. */
 
-	in = fopen(file, "r");
+	size = sizeof(struct config_snapshot_header);
 
-	if (in == NULL)
-		return FALSE;
+	for (int_block = int_list; int_block != NULL; int_block = int_block->next)
+		size += sizeof(int);
 
-	while (config_read_token_pair(in, token, contents, NULL) != sf_CONFIG_READ_EOF) {
-		/* If the token can be matched to a current setting, save it. */
+	for (opt_block = opt_list; opt_block != NULL; opt_block = opt_block->next)
+		size++;
+
+	for (str_block = str_list; str_block != NULL; str_block = str_block->next)
+		size += ((struct config_string *) str_block->value - 1)->length + 1;
+
+	data = malloc(size);
+	if (data == NULL)
+		return;
+
+	/* Fill in the header and the packed values. */
 
-		if (config_find_opt(token) != NULL)
-			config_opt_set(token, config_read_opt_string(contents));
-		else if (config_find_int(token) != NULL)
-			config_int_set(token, atoi (contents));
-		else if (config_find_str(token) != NULL)
-			config_str_set(token, contents);
+	header = (struct config_snapshot_header *) data;
+	header->magic = CONFIG_SNAPSHOT_MAGIC;
+	header->version = CONFIG_SNAPSHOT_VERSION;
+	header->schema = config_find_schema();
+	header->size = size;
+	header->opt_count = 0;
+	header->int_count = 0;
+	header->str_count = 0;
+
+	ints = (int *) (header + 1);
+
+	for (int_block = int_list; int_block != NULL; int_block = int_block->next, header->int_count++)
+		*ints++ = int_block->value;
+
+	opts = (byte *) ints;
+
+	for (opt_block = opt_list; opt_block != NULL; opt_block = opt_block->next, header->opt_count++)
+		*opts++ = (opt_block->value != FALSE) ? 1 : 0;
+
+	strs = opts;
+
+	for (str_block = str_list; str_block != NULL; str_block = str_block->next, header->str_count++) {
+		length = ((struct config_string *) str_block->value - 1)->length + 1;
+		memcpy(strs, str_block->value, length);
+		strs += length;
 	}
 
-	fclose(in);
+	if (xosfile_save_stamped(snapshot, osfile_TYPE_DATA, data, data + size) != NULL)
+		remove(snapshot);
 
-	return TRUE;
+	free(data);
 }
 
 
 /**
- * Save the current configuration from memory into the applicable Choices
- * file, recording only those values which differ from the defaults.
+ * Calculate a hash of the schema of the registered config values: their
+ * types, names and initial values, in the order in which they are held.
  *
- * \return		TRUE if successful; else FALSE.
+ * \return		The schema hash.
  */
 
-osbool config_save(void)
+static unsigned config_find_schema(void)
 {
-	char		file[1024];
-	FILE		*out;
+	unsigned	hash = CONFIG_HASH_SEED;
 	config_opt	*opt_block;
 	config_int	*int_block;
 	config_str	*str_block;
+	char		number[CONFIG_BOOL_LEN];
+
+	for (int_block = int_list; int_block != NULL; int_block = int_block->next) {
+		string_printf(number, sizeof(number), "i%d:", int_block->initial);
+		hash = config_hash_add(config_hash_add(hash, int_block->name), number);
+	}
 
+	for (opt_block = opt_list; opt_block != NULL; opt_block = opt_block->next)
+		hash = config_hash_add(config_hash_add(hash, opt_block->name), (opt_block->initial) ? "o1:" : "o0:");
 
-	config_find_save_file(file, sizeof(file), "Choices");
+	for (str_block = str_list; str_block != NULL; str_block = str_block->next)
+		hash = config_hash_add(config_hash_add(config_hash_add(hash, str_block->name), "s:"), str_block->initial);
+
+	return hash;
+}
+
+
+/**
+ * Get the filename of the binary snapshot which corresponds to a textual
+ * choices file: a file in the same directory with a different leafname.
+ *
+ * \param *file		A buffer to hold the snapshot's full pathname.
+ * \param len		The size of the buffer.
+ * \param *choices	The full pathname of the choices file.
+ */
+
+static void config_find_snapshot_file(char *file, size_t len, char *choices)
+{
+	char	*leaf;
+
+	string_copy(file, choices, len);
 
-	if (file == NULL || *file == '\0')
+	leaf = string_find_leafname(file);
+	*leaf = '\0';
+
+	string_printf(leaf, len - (leaf - file), "%s", CONFIG_SNAPSHOT_LEAF);
+}
+
+
+/**
+ * Add an observer to be notified of changes to config values, whether made
+ * through the config_*_set() calls or by config_load().  Changes are
+ * collected together and delivered in a single batch, from the first Null
+ * poll after they were made or on a call to config_notify_changes().
+ *
+ * \param *section	The section to observe, or NULL for the global
+ *			values registered with the config_*_init() calls.
+ * \param *name		The name of the value to observe, or NULL to
+ *			observe all of the values in the section.
+ * \param *callback	The function to be called with each batch of
+ *			changes which includes a value being observed.
+ * \param *data		Client data to be passed to the callback.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_add_observer(char *section, char *name, void (*callback)(struct config_change *changes, size_t count, void *data), void *data)
+{
+	struct config_observer	*new;
+
+	if (callback == NULL)
+		return FALSE;
+
+	new = malloc(sizeof(struct config_observer));
+	if (new == NULL)
 		return FALSE;
 
-	out = fopen(file, "w");
+	new->section = (section != NULL) ? strdup(section) : NULL;
+	new->name = (name != NULL) ? strdup(name) : NULL;
 
-	if (out == NULL)
+	if ((section != NULL && new->section == NULL) || (name != NULL && new->name == NULL)) {
+		free(new->section);
+		free(new->name);
+		free(new);
 		return FALSE;
+	}
 
-	fprintf(out, "# >Choices for %s\n\n", application_name);
+	new->callback = callback;
+	new->data = data;
+	new->deleted = FALSE;
 
-	/* Do the opt configs */
+	new->next = observer_list;
+	observer_list = new;
 
-	opt_block = opt_list;
+	return TRUE;
+}
 
-	while (opt_block != NULL) {
-		if (opt_block->value != opt_block->initial)
-			fprintf(out, "%s: %s\n", opt_block->name, config_return_opt_string(opt_block->value));
 
-		opt_block = opt_block->next;
+/**
+ * Remove any observers with the given callback function and client data.
+ * If changes are being delivered, the observers are only marked, so that
+ * an observer can safely delete itself or others from its callback.
+ *
+ * \param *callback	The callback function of the observers to remove.
+ * \param *data		The client data of the observers to remove.
+ */
+
+void config_delete_observer(void (*callback)(struct config_change *changes, size_t count, void *data), void *data)
+{
+	struct config_observer	*observer;
+
+	for (observer = observer_list; observer != NULL; observer = observer->next) {
+		if (observer->callback == callback && observer->data == data)
+			observer->deleted = TRUE;
 	}
 
-	/* Do the int configs */
+	if (notify_depth == 0)
+		config_purge_observers();
+}
 
-	int_block = int_list;
 
-	while (int_block != NULL) {
-		if (int_block->value != int_block->initial)
-			fprintf(out, "%s: %d\n", int_block->name, int_block->value);
+/**
+ * Deliver any pending changes to the interested observers immediately,
+ * without waiting for the next Null poll.  Each observer is called at most
+ * once, with all of the pending changes which it is observing.
+ */
 
-		int_block = int_block->next;
+void config_notify_changes(void)
+{
+	struct config_change	*changes, *matches;
+	struct config_observer	*observer;
+	osbool			*flag;
+	size_t			count, change, found;
+
+	if (notify_pending) {
+		event_delete_callback(config_notify_callback);
+		notify_pending = FALSE;
 	}
 
-	/* Do the str configs */
+	if (pending_changes_count == 0)
+		return;
 
-	str_block = str_list;
+	/* Take the current batch, so that any changes made by the observers
+	 * are collected into a new one.
+	 */
 
-	while (str_block != NULL) {
-		if (strcmp(str_block->value, str_block->initial) != 0)
-			fprintf(out, "%s: \"%s\"\n", str_block->name, str_block->value);
+	changes = pending_changes;
+	count = pending_changes_count;
 
-		str_block = str_block->next;
+	pending_changes = NULL;
+	pending_changes_size = 0;
+	pending_changes_count = 0;
+
+	for (change = 0; change < count; change++) {
+		flag = config_find_change_flag(changes[change].section, changes[change].name);
+		if (flag != NULL)
+			*flag = FALSE;
 	}
 
-	fclose(out);
+	/* Pass each observer the changes that it is interested in. */
 
-	return TRUE;
+	matches = malloc(count * sizeof(struct config_change));
+
+	notify_depth++;
+
+	for (observer = observer_list; observer != NULL && matches != NULL; observer = observer->next) {
+		if (observer->deleted)
+			continue;
+
+		found = 0;
+
+		for (change = 0; change < count; change++) {
+			if (config_observer_matches(observer, changes + change))
+				matches[found++] = changes[change];
+		}
+
+		if (found > 0)
+			observer->callback(matches, found, observer->data);
+	}
+
+	if (--notify_depth == 0)
+		config_purge_observers();
+
+	free(matches);
+	free(changes);
+}
+
+
+/**
+ * Add a change to the pending change list, unless it is already there, and
+ * schedule a notification callback for the next Null poll.
+ *
+ * \param *section	The section containing the value, or NULL for the
+ *			global values.
+ * \param *name		The name of the value which has changed.
+ * \param *flag		Pointer to the value's change flag, or NULL to
+ *			look it up.
+ */
+
+static void config_record_change(char *section, char *name, osbool *flag)
+{
+	struct config_change	*list;
+	size_t			size;
+
+	/* Values are flagged once they have been recorded. */
+
+	if (flag == NULL)
+		flag = config_find_change_flag(section, name);
+
+	if (flag == NULL || *flag)
+		return;
+
+	if (pending_changes_count >= pending_changes_size) {
+		size = (pending_changes_size == 0) ? CONFIG_CHANGES_INITIAL_SIZE : 2 * pending_changes_size;
+
+		list = realloc(pending_changes, size * sizeof(struct config_change));
+		if (list == NULL)
+			return;
+
+		pending_changes = list;
+		pending_changes_size = size;
+	}
+
+	pending_changes[pending_changes_count].section = section;
+	pending_changes[pending_changes_count].name = name;
+	pending_changes_count++;
+
+	*flag = TRUE;
+
+	if (!notify_pending)
+		notify_pending = event_add_single_callback(NULL, 0, config_notify_callback, NULL);
+}
+
+
+/**
+ * Find the flag which records whether a value is in the pending change list.
+ *
+ * \param *section	The section containing the value, or NULL for the
+ *			global values.
+ * \param *name		The name of the value, or NULL for the deletion
+ *			of the section.
+ * \return		Pointer to the flag, or NULL if the value wasn't found.
+ */
+
+static osbool *config_find_change_flag(char *section, char *name)
+{
+	struct config_entry		*entry;
+	struct config_section		*block;
+	struct config_section_value	*value;
+
+	if (section == NULL) {
+		entry = config_find_entry(name, config_hash_name(name));
+		return (entry != NULL) ? &(entry->changed) : NULL;
+	}
+
+	/* Deleted sections must be found too, so probe the table directly. */
+
+	block = config_probe_section(section, config_hash_name(section), TRUE);
+
+	if (block == NULL)
+		return NULL;
+
+	if (name == NULL)
+		return &(block->changed);
+
+	value = config_find_section_value(block, name, config_hash_name(name));
+
+	return (value != NULL) ? &(value->changed) : NULL;
+}
+
+
+/**
+ * Callback to deliver pending changes to the observers.
+ *
+ * \param time		The time of the callback.
+ * \param *data		Unused.
+ * \return		FALSE, to allow the Null event to be passed on.
+ */
+
+static osbool config_notify_callback(os_t time, void *data)
+{
+	notify_pending = FALSE;
+
+	config_notify_changes();
+
+	return FALSE;
+}
+
+
+/**
+ * Test whether an observer is interested in a change.
+ *
+ * \param *observer	The observer to test.
+ * \param *change	The change to test.
+ * \return		TRUE if the observer is interested; else FALSE.
+ */
+
+static osbool config_observer_matches(struct config_observer *observer, struct config_change *change)
+{
+	if (!config_names_match(observer->section, change->section))
+		return FALSE;
+
+	/* The deletion of a section affects all of the values within it. */
+
+	return (observer->name == NULL || change->name == NULL || config_names_match(observer->name, change->name)) ? TRUE : FALSE;
+}
+
+
+/**
+ * Free any observers which have been marked as deleted.
+ */
+
+static void config_purge_observers(void)
+{
+	struct config_observer	**observer, *old;
+
+	observer = &observer_list;
+
+	while (*observer != NULL) {
+		if ((*observer)->deleted) {
+			old = *observer;
+			*observer = old->next;
+
+			free(old->section);
+			free(old->name);
+			free(old);
+		} else {
+			observer = &((*observer)->next);
+		}
+	}
+}
+
+
+/**
+ * Compare two names, either or both of which may be NULL.
+ *
+ * \param *a		The first name to compare.
+ * \param *b		The second name to compare.
+ * \return		TRUE if the names are the same; else FALSE.
+ */
+
+static osbool config_names_match(char *a, char *b)
+{
+	if (a == NULL || b == NULL)
+		return (a == b) ? TRUE : FALSE;
+
+	return (strcmp(a, b) == 0) ? TRUE : FALSE;
 }
 
 
@@ -612,7 +2815,7 @@ osbool config_restore_default(void)
 
 enum config_read_status config_read_token_pair(FILE *file, char *token, char *value, char *section)
 {
-	char				line[sf_MAX_CONFIG_FILE_BUFFER], *stripped_line, *a, *b;
+	char				line[sf_MAX_CONFIG_FILE_BUFFER], *a, *b, *c;
 	enum config_read_status		result = sf_CONFIG_READ_EOF;
 	osbool				read = FALSE;
 
@@ -621,54 +2824,94 @@ enum config_read_status config_read_token_pair(FILE *file, char *token, char *va
 		return result;
 
 	while (!read && (fgets(line, sf_MAX_CONFIG_FILE_BUFFER, file) != NULL)) {
-		if (*line != '#') {
-			stripped_line = string_strip_surrounding_whitespace(line);
-
-			if (string_wildcard_compare("[*]", stripped_line, 1)) {
-				*strrchr(stripped_line, ']') = '\0';
-				if (section != NULL)
-					string_copy(section, stripped_line + 1, sf_MAX_CONFIG_FILE_BUFFER);
-				result = sf_CONFIG_READ_NEW_SECTION;
-			} else {
-				a = NULL;
-				b = strchr(stripped_line, ':');
+		switch (config_parse_line(line, &a, &b, &c)) {
+		case sf_CONFIG_READ_NEW_SECTION:
+			if (section != NULL)
+				string_copy(section, c, sf_MAX_CONFIG_FILE_BUFFER);
+			result = sf_CONFIG_READ_NEW_SECTION;
+			break;
 
-				if (b != NULL) {
-					a = stripped_line;
-					*b++ = '\0';
+		case sf_CONFIG_READ_VALUE_RETURNED:
+			if (token != NULL)
+				string_copy(token, a, sf_MAX_CONFIG_FILE_BUFFER);
 
-					if (token != NULL)
-						string_copy(token, a, sf_MAX_CONFIG_FILE_BUFFER);
+			if (value != NULL)
+				string_copy(value, b, sf_MAX_CONFIG_FILE_BUFFER);
 
-					if (value != NULL) {
-						/* Remove external whitespace and enclosing quotes if presnt. */
+			if (result != sf_CONFIG_READ_NEW_SECTION)
+				result = sf_CONFIG_READ_VALUE_RETURNED;
 
-						b = string_strip_surrounding_whitespace(b);
+			read = TRUE;
+			break;
 
-						if (*b == '"' && *(strchr(b, '\0')-1) == '"') {
-							b++;
-							*(strchr(b, '\0')-1) = '\0';
-						}
+		case sf_CONFIG_READ_EOF:
+			break;
+		}
+	}
 
-						string_copy(value, b, sf_MAX_CONFIG_FILE_BUFFER);
-					}
+	return result;
+}
 
-					if (result != sf_CONFIG_READ_NEW_SECTION)
-						result = sf_CONFIG_READ_VALUE_RETURNED;
 
-					read = TRUE;
-				} else {
-					if (token != NULL)
-						*token = '\0';
+/**
+ * Tokenise a single line from a config file in place, returning pointers
+ * to the token and value or to the section name within the supplied buffer.
+ *
+ * \param *line		The line to tokenise, which will be modified.
+ * \param **token	Pointer to a variable to take a pointer to the token name.
+ * \param **value	Pointer to a variable to take a pointer to the token value.
+ * \param **section	Pointer to a variable to take a pointer to the section
+ *			name, or NULL if not required.
+ * \return		sf_CONFIG_READ_VALUE_RETURNED if a token was found,
+ *			sf_CONFIG_READ_NEW_SECTION if a section was found, or
+ *			sf_CONFIG_READ_EOF if the line contained neither.
+ */
 
-					if (value != NULL)
-						*value = '\0';
-				}
-			}
-		}
+static enum config_read_status config_parse_line(char *line, char **token, char **value, char **section)
+{
+	char	*start, *end, *b;
+
+	if (*line == '#')
+		return sf_CONFIG_READ_EOF;
+
+	start = string_strip_surrounding_whitespace(line);
+	if (*start == '\0')
+		return sf_CONFIG_READ_EOF;
+
+	end = start + strlen(start);
+
+	/* Sections are enclosed in square brackets. */
+
+	if (*start == '[' && (end - start) >= 2 && *(end - 1) == ']') {
+		*(end - 1) = '\0';
+		if (section != NULL)
+			*section = start + 1;
+		return sf_CONFIG_READ_NEW_SECTION;
 	}
 
-	return result;
+	/* Tokens are separated from their values by a colon. */
+
+	b = memchr(start, ':', end - start);
+	if (b == NULL)
+		return sf_CONFIG_READ_EOF;
+
+	*b++ = '\0';
+	*token = start;
+
+	/* Remove external whitespace and enclosing quotes if present. */
+
+	b = string_strip_surrounding_whitespace(b);
+	end = b + strlen(b);
+
+	if (*b == '"' && *(end - 1) == '"') {
+		b++;
+		if (end > b)
+			*(end - 1) = '\0';
+	}
+
+	*value = b;
+
+	return sf_CONFIG_READ_VALUE_RETURNED;
 }
 
 
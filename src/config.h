@@ -28,6 +28,15 @@
  * string and boolean parameters: each having a default value and the ability
  * to be updated and read as required.  Changed values can be saved to and
  * loaded from a textual choices file in the standard locations.
+ *
+ * In addition, the choices file can contain named sections, each starting
+ * with a [Name] line and holding any number of free-form values.  Sections
+ * are only parsed when they are first accessed, so files holding many of
+ * them load quickly.
+ *
+ * Values following a [Name] line belong to that section alone.  Older
+ * versions of the library ignored section headers, and applied any such
+ * values to the global values of the same name; they no longer do so.
  */
 
 #ifndef SFLIB_CONFIG
@@ -35,7 +44,14 @@
 
 #include <stdio.h>
 
+/* The config module can also be built for the host, which doesn't have OSLib. */
+
+#ifdef SFLIB_HOST
+#include "heaphost.h"
+#else
+#include "oslib/os.h"
 #include "oslib/types.h"
+#endif
 
 /* ================================================================================================================== */
 
@@ -43,6 +59,15 @@
 #define sf_MAX_CONFIG_STR  1024							/**< The maximum length of a textual config value.	*/
 #define sf_MAX_CONFIG_FILE_BUFFER 1024						/**< The maximum size of a file load buffer.		*/
 
+/**
+ * Details of a change to a config value, passed to observers.
+ */
+
+struct config_change {
+	char		*section;						/**< The section containing the value, or NULL for the global values.	*/
+	char		*name;							/**< The name of the value which has changed, or NULL if the section was deleted.	*/
+};
+
 enum config_read_status {
 	sf_CONFIG_READ_EOF = 0,							/**< Nothing returned; End Of File.			*/
 	sf_CONFIG_READ_VALUE_RETURNED = 1,					/**< Value returned.					*/
@@ -75,7 +100,11 @@ osbool config_load(void);
 
 /**
  * Save the current configuration from memory into the applicable Choices
- * file, recording only those values which differ from the defaults.
+ * file, recording only those values which differ from the defaults.  If
+ * no values have changed since the last save or load, nothing is written.
+ *
+ * The new file is written under a temporary name and then renamed, so that
+ * the existing file is left intact if the save fails.
  *
  * \return		TRUE if successful; else FALSE.
  */
@@ -83,6 +112,167 @@ osbool config_load(void);
 osbool config_save(void);
 
 
+/**
+ * Set the write-behind delay, after which changes to the config values will
+ * be saved automatically.  Changes made within the delay of each other are
+ * saved together once the delay has passed since the most recent.
+ *
+ * Write-behind saves are made from the event module's callbacks, so the
+ * client must pass Null polls to event_process_event(); any outstanding
+ * changes should be saved with config_save() before the application exits.
+ *
+ * \param delay		The write-behind delay in centiseconds, or zero
+ *			to disable write-behind.
+ */
+
+void config_set_write_behind(os_t delay);
+
+
+/**
+ * Enable or disable the use of binary snapshots of the config values.  When
+ * enabled, config_save() writes a snapshot alongside the textual choices
+ * file, and config_load() uses it in place of the text if it is newer and
+ * matches the registered config values.  Otherwise, or if the snapshot is
+ * invalid, config_load() falls back to parsing the text.
+ *
+ * \param enable	TRUE to use binary snapshots; FALSE to disable them.
+ */
+
+void config_set_snapshot(osbool enable);
+
+
+/**
+ * Add an observer to be notified of changes to config values, whether made
+ * through the config_*_set() calls or by config_load().  Changes are
+ * collected together and delivered in a single batch, from the first Null
+ * poll after they were made or on a call to config_notify_changes(); each
+ * observer is called once per batch, with just those changes which it is
+ * observing, and the details are only valid for the duration of the call.
+ *
+ * \param *section	The section to observe, or NULL for the global
+ *			values registered with the config_*_init() calls.
+ * \param *name		The name of the value to observe, or NULL to
+ *			observe all of the values in the section.
+ * \param *callback	The function to be called with each batch of
+ *			changes which includes a value being observed.
+ * \param *data		Client data to be passed to the callback.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_add_observer(char *section, char *name, void (*callback)(struct config_change *changes, size_t count, void *data), void *data);
+
+
+/**
+ * Remove any observers with the given callback function and client data.
+ *
+ * \param *callback	The callback function of the observers to remove.
+ * \param *data		The client data of the observers to remove.
+ */
+
+void config_delete_observer(void (*callback)(struct config_change *changes, size_t count, void *data), void *data);
+
+
+/**
+ * Deliver any pending changes to the interested observers immediately,
+ * without waiting for the next Null poll.
+ */
+
+void config_notify_changes(void);
+
+
+/**
+ * Read a boolean value from a section.
+ *
+ * \param *section	The name of the section to read from.
+ * \param *name		The name of the value to read.
+ * \return		The value, or FALSE if not found.
+ */
+
+osbool config_section_opt_read(char *section, char *name);
+
+
+/**
+ * Set a boolean value in a section, creating the section and the value
+ * if required.
+ *
+ * \param *section	The name of the section to update.
+ * \param *name		The name of the value to set.
+ * \param value		The new value to assign.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_section_opt_set(char *section, char *name, osbool value);
+
+
+/**
+ * Read an integer value from a section.
+ *
+ * \param *section	The name of the section to read from.
+ * \param *name		The name of the value to read.
+ * \return		The value, or 0 if not found.
+ */
+
+int config_section_int_read(char *section, char *name);
+
+
+/**
+ * Set an integer value in a section, creating the section and the value
+ * if required.
+ *
+ * \param *section	The name of the section to update.
+ * \param *name		The name of the value to set.
+ * \param value		The new value to assign.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_section_int_set(char *section, char *name, int value);
+
+
+/**
+ * Read a text value from a section.  The pointer is only valid until the
+ * value is next changed.
+ *
+ * \param *section	The name of the section to read from.
+ * \param *name		The name of the value to read.
+ * \return		Pointer to the value, or to "" if not found.
+ */
+
+char *config_section_str_read(char *section, char *name);
+
+
+/**
+ * Set a text value in a section, creating the section and the value
+ * if required.
+ *
+ * \param *section	The name of the section to update.
+ * \param *name		The name of the value to set.
+ * \param *value	The new value to assign.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_section_str_set(char *section, char *name, char *value);
+
+
+/**
+ * Test whether a section exists.
+ *
+ * \param *section	The name of the section to test.
+ * \return		TRUE if the section exists; else FALSE.
+ */
+
+osbool config_section_exists(char *section);
+
+
+/**
+ * Delete a section and all of the values within it.
+ *
+ * \param *section	The name of the section to delete.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool config_section_delete(char *section);
+
+
 /**
  * Restore the default configuration settings.
  *
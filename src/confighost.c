@@ -0,0 +1,253 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: confighost.c
+ *
+ * Host implementations of the OS_File and system variable calls used by
+ * the config module.  This file is only built for the host, with
+ * SFLIB_HOST defined.
+ */
+
+/* ANSII C header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX header files. */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* SF-Lib header files. */
+
+#include "confighost.h"
+
+
+#define CONFIGHOST_EPOCH_OFFSET 2208988800u					/**< The seconds between the RISC OS and Unix epochs.		*/
+
+/**
+ * The error block returned by failing file operations.
+ */
+
+static os_error	confighost_error;
+
+
+/* Static Function Prototypes. */
+
+static void confighost_stamp(struct stat *status, bits *load_addr, bits *exec_addr);
+static os_error *confighost_make_error(char *message, char const *file_name);
+
+
+/* Read the catalogue information for an object.
+ *
+ * This is an external interface, documented in confighost.h
+ */
+
+os_error *xosfile_read_no_path(char const *file_name, fileswitch_object_type *obj_type, bits *load_addr, bits *exec_addr, int *size, fileswitch_attr *attr)
+{
+	return xosfile_read_stamped_no_path(file_name, obj_type, load_addr, exec_addr, size, attr, NULL);
+}
+
+
+/* Read the catalogue information for an object, including its filetype.
+ *
+ * This is an external interface, documented in confighost.h
+ */
+
+os_error *xosfile_read_stamped_no_path(char const *file_name, fileswitch_object_type *obj_type, bits *load_addr, bits *exec_addr, int *size, fileswitch_attr *attr, bits *file_type)
+{
+	struct stat	status;
+
+	if (stat(file_name, &status) != 0) {
+		status.st_mode = 0;
+		status.st_size = 0;
+		status.st_mtime = 0;
+	}
+
+	if (obj_type != NULL) {
+		if (S_ISREG(status.st_mode))
+			*obj_type = fileswitch_IS_FILE;
+		else if (S_ISDIR(status.st_mode))
+			*obj_type = fileswitch_IS_DIR;
+		else
+			*obj_type = fileswitch_NOT_FOUND;
+	}
+
+	confighost_stamp(&status, load_addr, exec_addr);
+
+	if (size != NULL)
+		*size = (int) status.st_size;
+
+	if (attr != NULL)
+		*attr = 0;
+
+	if (file_type != NULL)
+		*file_type = osfile_TYPE_TEXT;
+
+	return NULL;
+}
+
+
+/* Load a file into memory.
+ *
+ * This is an external interface, documented in confighost.h
+ */
+
+os_error *xosfile_load_stamped_no_path(char const *file_name, byte *addr, fileswitch_object_type *obj_type, bits *load_addr, bits *exec_addr, int *size, fileswitch_attr *attr)
+{
+	struct stat	status;
+	FILE		*file;
+	size_t		read;
+
+	if (stat(file_name, &status) != 0 || !S_ISREG(status.st_mode))
+		return confighost_make_error("File not found", file_name);
+
+	file = fopen(file_name, "rb");
+	if (file == NULL)
+		return confighost_make_error("Unable to open", file_name);
+
+	read = fread(addr, 1, status.st_size, file);
+	fclose(file);
+
+	if (read != (size_t) status.st_size)
+		return confighost_make_error("Unable to read", file_name);
+
+	if (obj_type != NULL)
+		*obj_type = fileswitch_IS_FILE;
+
+	confighost_stamp(&status, load_addr, exec_addr);
+
+	if (size != NULL)
+		*size = (int) status.st_size;
+
+	if (attr != NULL)
+		*attr = 0;
+
+	return NULL;
+}
+
+
+/* Save a block of memory to a file.
+ *
+ * This is an external interface, documented in confighost.h
+ */
+
+os_error *xosfile_save_stamped(char const *file_name, bits file_type, byte const *data, byte const *end)
+{
+	FILE	*file;
+	size_t	length = end - data;
+	osbool	success;
+
+	(void) file_type;
+
+	file = fopen(file_name, "wb");
+	if (file == NULL)
+		return confighost_make_error("Unable to open", file_name);
+
+	success = (fwrite(data, 1, length, file) == length) ? TRUE : FALSE;
+
+	if (fclose(file) != 0 || !success)
+		return confighost_make_error("Unable to write", file_name);
+
+	return NULL;
+}
+
+
+/* Create a directory.
+ *
+ * This is an external interface, documented in confighost.h
+ */
+
+void osfile_create_dir(char const *dir_name, int entry_count)
+{
+	(void) entry_count;
+
+	mkdir(dir_name, 0777);
+}
+
+
+/* Read the size of a system variable from the host's environment.
+ *
+ * This is an external interface, documented in confighost.h
+ */
+
+void os_read_var_val_size(char const *var, int context, os_var_type var_type, int *used, os_var_type *var_type_out)
+{
+	char	*value;
+
+	(void) context;
+	(void) var_type;
+
+	value = getenv(var);
+
+	if (used != NULL)
+		*used = (value != NULL) ? -(int) strlen(value) : 0;
+
+	if (var_type_out != NULL)
+		*var_type_out = os_VARTYPE_STRING;
+}
+
+
+/**
+ * Convert a host modification time into RISC OS load and execution
+ * addresses, holding the time in centiseconds since 1900 and the Text
+ * filetype.
+ *
+ * \param *status		The host file status to convert.
+ * \param *load_addr		Pointer to a variable to take the load address,
+ *				or NULL.
+ * \param *exec_addr		Pointer to a variable to take the execution
+ *				address, or NULL.
+ */
+
+static void confighost_stamp(struct stat *status, bits *load_addr, bits *exec_addr)
+{
+	unsigned long long	stamp;
+
+	stamp = ((unsigned long long) status->st_mtime + CONFIGHOST_EPOCH_OFFSET) * 100;
+
+	if (load_addr != NULL)
+		*load_addr = 0xfff00000u | (osfile_TYPE_TEXT << 8) | (bits) ((stamp >> 32) & 0xff);
+
+	if (exec_addr != NULL)
+		*exec_addr = (bits) (stamp & 0xffffffffu);
+}
+
+
+/**
+ * Fill in the error block.
+ *
+ * \param *message		The error message.
+ * \param *file_name		The file to which the error applies.
+ * \return			Pointer to the error block.
+ */
+
+static os_error *confighost_make_error(char *message, char const *file_name)
+{
+	confighost_error.errnum = 0;
+	snprintf(confighost_error.errmess, sizeof(confighost_error.errmess), "%s %s", message, file_name);
+
+	return &confighost_error;
+}
@@ -0,0 +1,172 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: confighost.h
+ *
+ * Host implementations of the OS_File and system variable calls used by
+ * the config module, so that it can be built, tested and benchmarked on
+ * other platforms.  Filenames are passed to the host unchanged, so a
+ * RISC OS path such as "Choices:App.Choices" simply won't be found and
+ * the config module will fall back to its local folder.
+ *
+ * This header is only used when SFLIB_HOST is defined, and builds on the
+ * types, clock and event stubs provided for the host heap.
+ */
+
+#ifndef SFLIB_CONFIGHOST
+#define SFLIB_CONFIGHOST
+
+#include "heaphost.h"
+
+/**
+ * A host bitfield, as used for file load and execution addresses.
+ */
+
+typedef unsigned int bits;
+
+/**
+ * A host object type, as returned by OS_File.
+ */
+
+typedef int fileswitch_object_type;
+
+/**
+ * Host file attributes; these aren't emulated.
+ */
+
+typedef bits fileswitch_attr;
+
+/**
+ * A host system variable type.
+ */
+
+typedef int os_var_type;
+
+#define fileswitch_NOT_FOUND 0							/**< The object was not found.						*/
+#define fileswitch_IS_FILE 1							/**< The object is a file.						*/
+#define fileswitch_IS_DIR 2							/**< The object is a directory.						*/
+
+#define os_VARTYPE_STRING 0							/**< A string system variable.						*/
+
+#define osfile_TYPE_DATA 0xffd							/**< The Data filetype.							*/
+#define osfile_TYPE_TEXT 0xfff							/**< The Text filetype.							*/
+
+
+/**
+ * Read the catalogue information for an object.  Host files all appear to
+ * be stamped with the Text filetype.
+ *
+ * \param *file_name		The name of the object.
+ * \param *obj_type		Pointer to a variable to take the object type.
+ * \param *load_addr		Pointer to a variable to take the load address,
+ *				or NULL.
+ * \param *exec_addr		Pointer to a variable to take the execution
+ *				address, or NULL.
+ * \param *size			Pointer to a variable to take the size, or NULL.
+ * \param *attr			Pointer to a variable to take the attributes,
+ *				or NULL.
+ * \return			NULL, as a missing object isn't an error.
+ */
+
+os_error *xosfile_read_no_path(char const *file_name, fileswitch_object_type *obj_type, bits *load_addr, bits *exec_addr, int *size, fileswitch_attr *attr);
+
+
+/**
+ * Read the catalogue information for an object, including its filetype.
+ *
+ * \param *file_name		The name of the object.
+ * \param *obj_type		Pointer to a variable to take the object type.
+ * \param *load_addr		Pointer to a variable to take the load address,
+ *				or NULL.
+ * \param *exec_addr		Pointer to a variable to take the execution
+ *				address, or NULL.
+ * \param *size			Pointer to a variable to take the size, or NULL.
+ * \param *attr			Pointer to a variable to take the attributes,
+ *				or NULL.
+ * \param *file_type		Pointer to a variable to take the filetype,
+ *				or NULL.
+ * \return			NULL, as a missing object isn't an error.
+ */
+
+os_error *xosfile_read_stamped_no_path(char const *file_name, fileswitch_object_type *obj_type, bits *load_addr, bits *exec_addr, int *size, fileswitch_attr *attr, bits *file_type);
+
+
+/**
+ * Load a file into memory, which must be big enough to hold all of it.
+ *
+ * \param *file_name		The name of the file to load.
+ * \param *addr			The memory to load the file into.
+ * \param *obj_type		Pointer to a variable to take the object type,
+ *				or NULL.
+ * \param *load_addr		Pointer to a variable to take the load address,
+ *				or NULL.
+ * \param *exec_addr		Pointer to a variable to take the execution
+ *				address, or NULL.
+ * \param *size			Pointer to a variable to take the size, or NULL.
+ * \param *attr			Pointer to a variable to take the attributes,
+ *				or NULL.
+ * \return			NULL on success, or a pointer to an error block.
+ */
+
+os_error *xosfile_load_stamped_no_path(char const *file_name, byte *addr, fileswitch_object_type *obj_type, bits *load_addr, bits *exec_addr, int *size, fileswitch_attr *attr);
+
+
+/**
+ * Save a block of memory to a file.  The filetype is ignored.
+ *
+ * \param *file_name		The name of the file to save.
+ * \param file_type		The filetype to give the file.
+ * \param *data			The start of the data to save.
+ * \param *end			The end of the data to save.
+ * \return			NULL on success, or a pointer to an error block.
+ */
+
+os_error *xosfile_save_stamped(char const *file_name, bits file_type, byte const *data, byte const *end);
+
+
+/**
+ * Create a directory, if it doesn't already exist.
+ *
+ * \param *dir_name		The name of the directory to create.
+ * \param entry_count		Unused.
+ */
+
+void osfile_create_dir(char const *dir_name, int entry_count);
+
+
+/**
+ * Read the size of a system variable, which is taken from the host's
+ * environment.  As with OS_ReadVarVal, the size is returned as a negative
+ * value, or zero if the variable doesn't exist.
+ *
+ * \param *var			The name of the variable.
+ * \param context		Unused.
+ * \param var_type		Unused.
+ * \param *used			Pointer to a variable to take the size.
+ * \param *var_type_out		Pointer to a variable to take the type, or NULL.
+ */
+
+void os_read_var_val_size(char const *var, int context, os_var_type var_type, int *used, os_var_type *var_type_out);
+
+#endif
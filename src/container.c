@@ -0,0 +1,948 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: container.c
+ *
+ * Generic containers: growable vectors, stacks and ring buffers, and
+ * open-addressed hash maps keyed by integers or strings.
+ */
+
+/* ANSII C header files. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* OSLib header files. */
+
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "container.h"
+#include "heap.h"
+
+
+#define CONTAINER_MIN_ELEMENTS 8						/**< The smallest number of elements claimed for a vector or ring.	*/
+#define CONTAINER_MIN_SLOTS 16							/**< The smallest number of slots in a hash map.			*/
+
+#define CONTAINER_SLOT_EMPTY 0							/**< An integer map slot which has never been used.			*/
+#define CONTAINER_SLOT_USED 1							/**< An integer map slot which holds a key.				*/
+#define CONTAINER_SLOT_DELETED 2						/**< An integer map slot whose key has been removed.			*/
+
+/**
+ * The marker used for the keys of deleted string map slots.
+ */
+
+static char container_deleted_key[1];
+
+
+/* Static Function Prototypes. */
+
+static void *container_resize(container_allocator allocator, void *context, void *block, size_t old_size, size_t new_size);
+static osbool container_ring_grow(struct container_ring *ring);
+static unsigned container_hash_int(int key);
+static unsigned container_hash_string(const char *key);
+static struct container_int_entry *container_int_map_slot(struct container_int_map *map, int key, osbool insert);
+static osbool container_int_map_rehash(struct container_int_map *map);
+static struct container_string_entry *container_string_map_slot(struct container_string_map *map, const char *key, unsigned hash, osbool insert);
+static osbool container_string_map_rehash(struct container_string_map *map);
+
+
+/* An allocator which uses malloc(), realloc() and free().
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void *container_malloc_allocator(void *context, void *block, size_t old_size, size_t new_size)
+{
+	if (new_size == 0) {
+		free(block);
+		return NULL;
+	}
+
+	return realloc(block, new_size);
+}
+
+
+/* An allocator which uses heap_alloc(), heap_extend() and heap_free().
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void *container_heap_allocator(void *context, void *block, size_t old_size, size_t new_size)
+{
+	if (new_size == 0) {
+		if (block != NULL)
+			heap_free(block);
+
+		return NULL;
+	}
+
+	if (block == NULL)
+		return heap_alloc(new_size);
+
+	return heap_extend(block, new_size);
+}
+
+
+/* Initialise an empty vector.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_vector_init(struct container_vector *vector, size_t element_size, container_allocator allocator, void *context)
+{
+	if (vector == NULL)
+		return;
+
+	vector->data = NULL;
+	vector->count = 0;
+	vector->capacity = 0;
+	vector->element_size = element_size;
+	vector->allocator = allocator;
+	vector->context = context;
+}
+
+
+/* Release the storage used by a vector.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_vector_free(struct container_vector *vector)
+{
+	if (vector == NULL)
+		return;
+
+	if (vector->data != NULL)
+		container_resize(vector->allocator, vector->context, vector->data, vector->capacity * vector->element_size, 0);
+
+	vector->data = NULL;
+	vector->count = 0;
+	vector->capacity = 0;
+}
+
+
+/* Make sure that a vector has space for a number of elements.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_vector_reserve(struct container_vector *vector, size_t capacity)
+{
+	char	*data;
+	size_t	size;
+
+	if (vector == NULL || vector->element_size == 0)
+		return FALSE;
+
+	if (capacity <= vector->capacity)
+		return TRUE;
+
+	/* Grow geometrically, so that pushes take amortised constant time. */
+
+	size = (vector->capacity > 0) ? vector->capacity : CONTAINER_MIN_ELEMENTS;
+
+	while (size < capacity)
+		size *= 2;
+
+	data = container_resize(vector->allocator, vector->context, vector->data,
+			vector->capacity * vector->element_size, size * vector->element_size);
+	if (data == NULL)
+		return FALSE;
+
+	vector->data = data;
+	vector->capacity = size;
+
+	return TRUE;
+}
+
+
+/* Add an element to the end of a vector.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void *container_vector_push(struct container_vector *vector, void *element)
+{
+	char	*slot;
+
+	if (vector == NULL || !container_vector_reserve(vector, vector->count + 1))
+		return NULL;
+
+	slot = vector->data + vector->count++ * vector->element_size;
+
+	if (element != NULL)
+		memcpy(slot, element, vector->element_size);
+	else
+		memset(slot, 0, vector->element_size);
+
+	return slot;
+}
+
+
+/* Remove the element at the end of a vector.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_vector_pop(struct container_vector *vector, void *element)
+{
+	if (vector == NULL || vector->count == 0)
+		return FALSE;
+
+	vector->count--;
+
+	if (element != NULL)
+		memcpy(element, vector->data + vector->count * vector->element_size, vector->element_size);
+
+	return TRUE;
+}
+
+
+/* Find an element in a vector.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void *container_vector_get(struct container_vector *vector, size_t index)
+{
+	if (vector == NULL || index >= vector->count)
+		return NULL;
+
+	return vector->data + index * vector->element_size;
+}
+
+
+/* Remove an element from a vector.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_vector_remove(struct container_vector *vector, size_t index)
+{
+	if (vector == NULL || index >= vector->count)
+		return FALSE;
+
+	memmove(vector->data + index * vector->element_size, vector->data + (index + 1) * vector->element_size,
+			(vector->count - index - 1) * vector->element_size);
+
+	vector->count--;
+
+	return TRUE;
+}
+
+
+/* Remove all of the elements from a vector.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_vector_clear(struct container_vector *vector)
+{
+	if (vector != NULL)
+		vector->count = 0;
+}
+
+
+/* Initialise an empty stack.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_stack_init(struct container_stack *stack, size_t element_size, container_allocator allocator, void *context)
+{
+	if (stack != NULL)
+		container_vector_init(&(stack->vector), element_size, allocator, context);
+}
+
+
+/* Release the storage used by a stack.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_stack_free(struct container_stack *stack)
+{
+	if (stack != NULL)
+		container_vector_free(&(stack->vector));
+}
+
+
+/* Push an element on to a stack.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_stack_push(struct container_stack *stack, void *element)
+{
+	if (stack == NULL || element == NULL)
+		return FALSE;
+
+	return (container_vector_push(&(stack->vector), element) != NULL) ? TRUE : FALSE;
+}
+
+
+/* Pull the element from the top of a stack.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_stack_pull(struct container_stack *stack, void *element)
+{
+	if (stack == NULL)
+		return FALSE;
+
+	return container_vector_pop(&(stack->vector), element);
+}
+
+
+/* Find the element at the top of a stack.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void *container_stack_top(struct container_stack *stack)
+{
+	if (stack == NULL || stack->vector.count == 0)
+		return NULL;
+
+	return container_vector_get(&(stack->vector), stack->vector.count - 1);
+}
+
+
+/* Initialise an empty ring buffer.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_ring_init(struct container_ring *ring, size_t element_size, container_allocator allocator, void *context)
+{
+	if (ring == NULL)
+		return;
+
+	ring->data = NULL;
+	ring->head = 0;
+	ring->count = 0;
+	ring->capacity = 0;
+	ring->element_size = element_size;
+	ring->allocator = allocator;
+	ring->context = context;
+}
+
+
+/* Release the storage used by a ring buffer.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_ring_free(struct container_ring *ring)
+{
+	if (ring == NULL)
+		return;
+
+	if (ring->data != NULL)
+		container_resize(ring->allocator, ring->context, ring->data, ring->capacity * ring->element_size, 0);
+
+	ring->data = NULL;
+	ring->head = 0;
+	ring->count = 0;
+	ring->capacity = 0;
+}
+
+
+/* Add an element to the tail of a ring buffer.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_ring_push(struct container_ring *ring, void *element)
+{
+	size_t	tail;
+
+	if (ring == NULL || element == NULL || ring->element_size == 0)
+		return FALSE;
+
+	if (ring->count == ring->capacity && !container_ring_grow(ring))
+		return FALSE;
+
+	tail = (ring->head + ring->count) % ring->capacity;
+	memcpy(ring->data + tail * ring->element_size, element, ring->element_size);
+	ring->count++;
+
+	return TRUE;
+}
+
+
+/* Remove the element from the head of a ring buffer.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_ring_pull(struct container_ring *ring, void *element)
+{
+	if (ring == NULL || ring->count == 0)
+		return FALSE;
+
+	if (element != NULL)
+		memcpy(element, ring->data + ring->head * ring->element_size, ring->element_size);
+
+	ring->head = (ring->head + 1) % ring->capacity;
+	ring->count--;
+
+	return TRUE;
+}
+
+
+/* Find the element at the head of a ring buffer.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void *container_ring_peek(struct container_ring *ring)
+{
+	if (ring == NULL || ring->count == 0)
+		return NULL;
+
+	return ring->data + ring->head * ring->element_size;
+}
+
+
+/* Initialise an empty integer-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_int_map_init(struct container_int_map *map, container_allocator allocator, void *context)
+{
+	if (map == NULL)
+		return;
+
+	map->entries = NULL;
+	map->count = 0;
+	map->used = 0;
+	map->capacity = 0;
+	map->allocator = allocator;
+	map->context = context;
+}
+
+
+/* Release the storage used by an integer-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_int_map_free(struct container_int_map *map)
+{
+	if (map == NULL)
+		return;
+
+	if (map->entries != NULL)
+		container_resize(map->allocator, map->context, map->entries, map->capacity * sizeof(struct container_int_entry), 0);
+
+	map->entries = NULL;
+	map->count = 0;
+	map->used = 0;
+	map->capacity = 0;
+}
+
+
+/* Set the value for a key in an integer-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_int_map_set(struct container_int_map *map, int key, void *value)
+{
+	struct container_int_entry	*entry;
+
+	if (map == NULL)
+		return FALSE;
+
+	/* Keep the table no more than three quarters full, counting deleted slots. */
+
+	if ((map->used + 1) * 4 > map->capacity * 3 && !container_int_map_rehash(map))
+		return FALSE;
+
+	entry = container_int_map_slot(map, key, TRUE);
+
+	if (entry->state != CONTAINER_SLOT_USED) {
+		if (entry->state == CONTAINER_SLOT_EMPTY)
+			map->used++;
+
+		entry->key = key;
+		entry->state = CONTAINER_SLOT_USED;
+		map->count++;
+	}
+
+	entry->value = value;
+
+	return TRUE;
+}
+
+
+/* Look up a key in an integer-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_int_map_find(struct container_int_map *map, int key, void **value)
+{
+	struct container_int_entry	*entry;
+
+	if (map == NULL || map->count == 0)
+		return FALSE;
+
+	entry = container_int_map_slot(map, key, FALSE);
+	if (entry == NULL)
+		return FALSE;
+
+	if (value != NULL)
+		*value = entry->value;
+
+	return TRUE;
+}
+
+
+/* Remove a key from an integer-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_int_map_remove(struct container_int_map *map, int key)
+{
+	struct container_int_entry	*entry;
+
+	if (map == NULL || map->count == 0)
+		return FALSE;
+
+	entry = container_int_map_slot(map, key, FALSE);
+	if (entry == NULL)
+		return FALSE;
+
+	entry->state = CONTAINER_SLOT_DELETED;
+	entry->value = NULL;
+	map->count--;
+
+	return TRUE;
+}
+
+
+/* Initialise an empty string-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_string_map_init(struct container_string_map *map, container_allocator allocator, void *context)
+{
+	if (map == NULL)
+		return;
+
+	map->entries = NULL;
+	map->count = 0;
+	map->used = 0;
+	map->capacity = 0;
+	map->allocator = allocator;
+	map->context = context;
+}
+
+
+/* Release the storage used by a string-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+void container_string_map_free(struct container_string_map *map)
+{
+	size_t	i;
+	char	*key;
+
+	if (map == NULL)
+		return;
+
+	if (map->entries != NULL) {
+		for (i = 0; i < map->capacity; i++) {
+			key = map->entries[i].key;
+
+			if (key != NULL && key != container_deleted_key)
+				container_resize(map->allocator, map->context, key, strlen(key) + 1, 0);
+		}
+
+		container_resize(map->allocator, map->context, map->entries, map->capacity * sizeof(struct container_string_entry), 0);
+	}
+
+	map->entries = NULL;
+	map->count = 0;
+	map->used = 0;
+	map->capacity = 0;
+}
+
+
+/* Set the value for a key in a string-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_string_map_set(struct container_string_map *map, const char *key, void *value)
+{
+	struct container_string_entry	*entry;
+	unsigned			hash;
+	size_t				length;
+	char				*copy;
+
+	if (map == NULL || key == NULL)
+		return FALSE;
+
+	if ((map->used + 1) * 4 > map->capacity * 3 && !container_string_map_rehash(map))
+		return FALSE;
+
+	hash = container_hash_string(key);
+	entry = container_string_map_slot(map, key, hash, TRUE);
+
+	if (entry->key == NULL || entry->key == container_deleted_key) {
+		length = strlen(key) + 1;
+
+		copy = container_resize(map->allocator, map->context, NULL, 0, length);
+		if (copy == NULL)
+			return FALSE;
+
+		memcpy(copy, key, length);
+
+		if (entry->key == NULL)
+			map->used++;
+
+		entry->key = copy;
+		entry->hash = hash;
+		map->count++;
+	}
+
+	entry->value = value;
+
+	return TRUE;
+}
+
+
+/* Look up a key in a string-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_string_map_find(struct container_string_map *map, const char *key, void **value)
+{
+	struct container_string_entry	*entry;
+
+	if (map == NULL || key == NULL || map->count == 0)
+		return FALSE;
+
+	entry = container_string_map_slot(map, key, container_hash_string(key), FALSE);
+	if (entry == NULL)
+		return FALSE;
+
+	if (value != NULL)
+		*value = entry->value;
+
+	return TRUE;
+}
+
+
+/* Remove a key from a string-keyed map.
+ *
+ * This is an external interface, documented in container.h
+ */
+
+osbool container_string_map_remove(struct container_string_map *map, const char *key)
+{
+	struct container_string_entry	*entry;
+
+	if (map == NULL || key == NULL || map->count == 0)
+		return FALSE;
+
+	entry = container_string_map_slot(map, key, container_hash_string(key), FALSE);
+	if (entry == NULL)
+		return FALSE;
+
+	container_resize(map->allocator, map->context, entry->key, strlen(entry->key) + 1, 0);
+
+	entry->key = container_deleted_key;
+	entry->value = NULL;
+	map->count--;
+
+	return TRUE;
+}
+
+
+/**
+ * Claim, resize or release a block through a container's allocator.
+ *
+ * \param allocator		The allocator to use, or NULL for malloc().
+ * \param *context		The context for the allocator.
+ * \param *block		The current block, or NULL.
+ * \param old_size		The current size of the block.
+ * \param new_size		The size required, or 0 to release the block.
+ * \return			Pointer to the new block, or NULL.
+ */
+
+static void *container_resize(container_allocator allocator, void *context, void *block, size_t old_size, size_t new_size)
+{
+	if (allocator == NULL)
+		allocator = container_malloc_allocator;
+
+	return allocator(context, block, old_size, new_size);
+}
+
+
+/**
+ * Double the capacity of a ring buffer, moving its contents to the start
+ * of the new storage.
+ *
+ * \param *ring			The ring buffer to grow.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+static osbool container_ring_grow(struct container_ring *ring)
+{
+	char	*data;
+	size_t	capacity, first;
+
+	capacity = (ring->capacity > 0) ? ring->capacity * 2 : CONTAINER_MIN_ELEMENTS;
+
+	data = container_resize(ring->allocator, ring->context, NULL, 0, capacity * ring->element_size);
+	if (data == NULL)
+		return FALSE;
+
+	/* Copy the elements from the head to the end of the old storage, then
+	 * any which had wrapped round to the start.
+	 */
+
+	if (ring->data != NULL) {
+		first = ring->capacity - ring->head;
+		if (first > ring->count)
+			first = ring->count;
+
+		memcpy(data, ring->data + ring->head * ring->element_size, first * ring->element_size);
+		memcpy(data + first * ring->element_size, ring->data, (ring->count - first) * ring->element_size);
+
+		container_resize(ring->allocator, ring->context, ring->data, ring->capacity * ring->element_size, 0);
+	}
+
+	ring->data = data;
+	ring->head = 0;
+	ring->capacity = capacity;
+
+	return TRUE;
+}
+
+
+/**
+ * Hash an integer key, mixing the bits so that sequential keys spread
+ * across the table.
+ *
+ * \param key			The key to hash.
+ * \return			The hash value.
+ */
+
+static unsigned container_hash_int(int key)
+{
+	unsigned	hash = (unsigned) key * 2654435761u;
+
+	return hash ^ (hash >> 16);
+}
+
+
+/**
+ * Hash a string key, using the djb2 algorithm.
+ *
+ * \param *key			The key to hash.
+ * \return			The hash value.
+ */
+
+static unsigned container_hash_string(const char *key)
+{
+	unsigned	hash = 5381;
+
+	while (*key != '\0')
+		hash = ((hash << 5) + hash) + (unsigned char) *key++;
+
+	return hash;
+}
+
+
+/**
+ * Find the slot holding a key in an integer-keyed map, or the slot where
+ * it should be inserted.
+ *
+ * \param *map			The map to search, which must have a table.
+ * \param key			The key to find.
+ * \param insert		TRUE to return a slot for insertion if the key
+ *				isn't found; FALSE to return NULL.
+ * \return			Pointer to the slot, or NULL.
+ */
+
+static struct container_int_entry *container_int_map_slot(struct container_int_map *map, int key, osbool insert)
+{
+	struct container_int_entry	*entry, *deleted = NULL;
+	size_t				mask = map->capacity - 1, index;
+
+	index = container_hash_int(key) & mask;
+
+	while (1) {
+		entry = map->entries + index;
+
+		if (entry->state == CONTAINER_SLOT_EMPTY)
+			return (insert) ? ((deleted != NULL) ? deleted : entry) : NULL;
+
+		if (entry->state == CONTAINER_SLOT_DELETED) {
+			if (deleted == NULL)
+				deleted = entry;
+		} else if (entry->key == key) {
+			return entry;
+		}
+
+		index = (index + 1) & mask;
+	}
+}
+
+
+/**
+ * Rebuild the table of an integer-keyed map, doubling it if it is at least
+ * half full of live keys and otherwise just clearing out deleted slots.
+ *
+ * \param *map			The map to rehash.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+static osbool container_int_map_rehash(struct container_int_map *map)
+{
+	struct container_int_entry	*old_entries = map->entries, *entry;
+	size_t				old_capacity = map->capacity, capacity, i;
+
+	capacity = (old_capacity > 0) ? old_capacity : CONTAINER_MIN_SLOTS;
+
+	if ((map->count + 1) * 2 > capacity)
+		capacity *= 2;
+
+	entry = container_resize(map->allocator, map->context, NULL, 0, capacity * sizeof(struct container_int_entry));
+	if (entry == NULL)
+		return FALSE;
+
+	for (i = 0; i < capacity; i++)
+		entry[i].state = CONTAINER_SLOT_EMPTY;
+
+	map->entries = entry;
+	map->capacity = capacity;
+	map->used = map->count;
+
+	for (i = 0; i < old_capacity; i++) {
+		if (old_entries[i].state != CONTAINER_SLOT_USED)
+			continue;
+
+		*container_int_map_slot(map, old_entries[i].key, TRUE) = old_entries[i];
+	}
+
+	if (old_entries != NULL)
+		container_resize(map->allocator, map->context, old_entries, old_capacity * sizeof(struct container_int_entry), 0);
+
+	return TRUE;
+}
+
+
+/**
+ * Find the slot holding a key in a string-keyed map, or the slot where
+ * it should be inserted.
+ *
+ * \param *map			The map to search, which must have a table.
+ * \param *key			The key to find.
+ * \param hash			The hash of the key.
+ * \param insert		TRUE to return a slot for insertion if the key
+ *				isn't found; FALSE to return NULL.
+ * \return			Pointer to the slot, or NULL.
+ */
+
+static struct container_string_entry *container_string_map_slot(struct container_string_map *map, const char *key, unsigned hash, osbool insert)
+{
+	struct container_string_entry	*entry, *deleted = NULL;
+	size_t				mask = map->capacity - 1, index;
+
+	index = hash & mask;
+
+	while (1) {
+		entry = map->entries + index;
+
+		if (entry->key == NULL)
+			return (insert) ? ((deleted != NULL) ? deleted : entry) : NULL;
+
+		if (entry->key == container_deleted_key) {
+			if (deleted == NULL)
+				deleted = entry;
+		} else if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+			return entry;
+		}
+
+		index = (index + 1) & mask;
+	}
+}
+
+
+/**
+ * Rebuild the table of a string-keyed map, doubling it if it is at least
+ * half full of live keys and otherwise just clearing out deleted slots.
+ *
+ * \param *map			The map to rehash.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+static osbool container_string_map_rehash(struct container_string_map *map)
+{
+	struct container_string_entry	*old_entries = map->entries, *entry;
+	size_t				old_capacity = map->capacity, capacity, i;
+
+	capacity = (old_capacity > 0) ? old_capacity : CONTAINER_MIN_SLOTS;
+
+	if ((map->count + 1) * 2 > capacity)
+		capacity *= 2;
+
+	entry = container_resize(map->allocator, map->context, NULL, 0, capacity * sizeof(struct container_string_entry));
+	if (entry == NULL)
+		return FALSE;
+
+	for (i = 0; i < capacity; i++)
+		entry[i].key = NULL;
+
+	map->entries = entry;
+	map->capacity = capacity;
+	map->used = map->count;
+
+	for (i = 0; i < old_capacity; i++) {
+		if (old_entries[i].key == NULL || old_entries[i].key == container_deleted_key)
+			continue;
+
+		*container_string_map_slot(map, old_entries[i].key, old_entries[i].hash, TRUE) = old_entries[i];
+	}
+
+	if (old_entries != NULL)
+		container_resize(map->allocator, map->context, old_entries, old_capacity * sizeof(struct container_string_entry), 0);
+
+	return TRUE;
+}
+
@@ -0,0 +1,464 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: container.h
+ *
+ * Generic containers: growable vectors, stacks and ring buffers of
+ * fixed-size elements, and open-addressed hash maps keyed by integers or
+ * strings.  Each container claims its storage through an allocator, which
+ * can be malloc() (the default), the flex-based heap, or an arena.
+ *
+ * The container structures are public so that they can be embedded in
+ * client data, but their contents should only be changed through the
+ * functions provided.
+ */
+
+#ifndef SFLIB_CONTAINER
+#define SFLIB_CONTAINER
+
+#include <stddef.h>
+#include "oslib/types.h"
+
+/**
+ * An allocator for container storage, called to claim, resize and release
+ * blocks in the manner of realloc().  The parameters match those of
+ * heap_arena_realloc() and string builder allocators, so that arenas can
+ * be used directly.
+ *
+ * \param *context		The context supplied with the allocator.
+ * \param *block		The current block, or NULL to claim a new one.
+ * \param old_size		The current size of the block.
+ * \param new_size		The size required, or 0 to release the block.
+ * \return			Pointer to the new block, which must contain
+ *				the contents of the old, or NULL on failure.
+ */
+
+typedef void *(*container_allocator)(void *context, void *block, size_t old_size, size_t new_size);
+
+/**
+ * A growable vector of fixed-size elements.
+ */
+
+struct container_vector {
+	char				*data;				/**< The element storage, or NULL.				*/
+	size_t				count;				/**< The number of elements in the vector.			*/
+	size_t				capacity;			/**< The number of elements which will fit in the storage.	*/
+	size_t				element_size;			/**< The size of each element, in bytes.			*/
+	container_allocator		allocator;			/**< The allocator for the storage.				*/
+	void				*context;			/**< The context for the allocator.				*/
+};
+
+/**
+ * A stack of fixed-size elements.
+ */
+
+struct container_stack {
+	struct container_vector		vector;				/**< The vector holding the stack, with the top at the end.	*/
+};
+
+/**
+ * A growable ring buffer, or queue, of fixed-size elements.
+ */
+
+struct container_ring {
+	char				*data;				/**< The element storage, or NULL.				*/
+	size_t				head;				/**< The index of the first element.				*/
+	size_t				count;				/**< The number of elements in the buffer.			*/
+	size_t				capacity;			/**< The number of elements which will fit in the storage.	*/
+	size_t				element_size;			/**< The size of each element, in bytes.			*/
+	container_allocator		allocator;			/**< The allocator for the storage.				*/
+	void				*context;			/**< The context for the allocator.				*/
+};
+
+/**
+ * An entry in an integer-keyed hash map.
+ */
+
+struct container_int_entry {
+	int				key;				/**< The key.							*/
+	int				state;				/**< The state of the entry: empty, used or deleted.		*/
+	void				*value;				/**< The value.							*/
+};
+
+/**
+ * An open-addressed hash map, keyed by integers.
+ */
+
+struct container_int_map {
+	struct container_int_entry	*entries;			/**< The hash table, or NULL.					*/
+	size_t				count;				/**< The number of keys in the map.				*/
+	size_t				used;				/**< The number of slots which are used or deleted.		*/
+	size_t				capacity;			/**< The number of slots in the table; a power of 2.		*/
+	container_allocator		allocator;			/**< The allocator for the storage.				*/
+	void				*context;			/**< The context for the allocator.				*/
+};
+
+/**
+ * An entry in a string-keyed hash map.
+ */
+
+struct container_string_entry {
+	char				*key;				/**< A copy of the key, NULL if empty, or a deleted marker.	*/
+	unsigned			hash;				/**< The hash of the key.					*/
+	void				*value;				/**< The value.							*/
+};
+
+/**
+ * An open-addressed hash map, keyed by strings.
+ */
+
+struct container_string_map {
+	struct container_string_entry	*entries;			/**< The hash table, or NULL.					*/
+	size_t				count;				/**< The number of keys in the map.				*/
+	size_t				used;				/**< The number of slots which are used or deleted.		*/
+	size_t				capacity;			/**< The number of slots in the table; a power of 2.		*/
+	container_allocator		allocator;			/**< The allocator for the storage.				*/
+	void				*context;			/**< The context for the allocator.				*/
+};
+
+
+/**
+ * An allocator which uses malloc(), realloc() and free().
+ */
+
+void *container_malloc_allocator(void *context, void *block, size_t old_size, size_t new_size);
+
+
+/**
+ * An allocator which uses heap_alloc(), heap_extend() and heap_free().
+ */
+
+void *container_heap_allocator(void *context, void *block, size_t old_size, size_t new_size);
+
+
+/**
+ * Initialise an empty vector.
+ *
+ * \param *vector		The vector to initialise.
+ * \param element_size		The size of each element, in bytes.
+ * \param allocator		The allocator to use, or NULL for malloc().
+ * \param *context		The context to pass to the allocator.
+ */
+
+void container_vector_init(struct container_vector *vector, size_t element_size, container_allocator allocator, void *context);
+
+
+/**
+ * Release the storage used by a vector, leaving it empty.
+ *
+ * \param *vector		The vector to free.
+ */
+
+void container_vector_free(struct container_vector *vector);
+
+
+/**
+ * Make sure that a vector has space for a number of elements without
+ * needing to claim more storage.
+ *
+ * \param *vector		The vector to update.
+ * \param capacity		The number of elements required.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+osbool container_vector_reserve(struct container_vector *vector, size_t capacity);
+
+
+/**
+ * Add an element to the end of a vector.
+ *
+ * \param *vector		The vector to add to.
+ * \param *element		Pointer to the element to copy in, or NULL to
+ *				add an element cleared to zero.
+ * \return			Pointer to the new element in the vector, or
+ *				NULL on failure.
+ */
+
+void *container_vector_push(struct container_vector *vector, void *element);
+
+
+/**
+ * Remove the element at the end of a vector.
+ *
+ * \param *vector		The vector to remove from.
+ * \param *element		Pointer to a buffer to take the element, or NULL.
+ * \return			TRUE if an element was removed; FALSE if empty.
+ */
+
+osbool container_vector_pop(struct container_vector *vector, void *element);
+
+
+/**
+ * Find an element in a vector.  The pointer remains valid until the vector
+ * is next changed in size.
+ *
+ * \param *vector		The vector to look in.
+ * \param index			The index of the element.
+ * \return			Pointer to the element, or NULL if out of range.
+ */
+
+void *container_vector_get(struct container_vector *vector, size_t index);
+
+
+/**
+ * Remove an element from a vector, moving those after it down to fill the
+ * space.
+ *
+ * \param *vector		The vector to remove from.
+ * \param index			The index of the element to remove.
+ * \return			TRUE if the element was removed; else FALSE.
+ */
+
+osbool container_vector_remove(struct container_vector *vector, size_t index);
+
+
+/**
+ * Remove all of the elements from a vector, keeping its storage.
+ *
+ * \param *vector		The vector to clear.
+ */
+
+void container_vector_clear(struct container_vector *vector);
+
+
+/**
+ * Initialise an empty stack.
+ *
+ * \param *stack		The stack to initialise.
+ * \param element_size		The size of each element, in bytes.
+ * \param allocator		The allocator to use, or NULL for malloc().
+ * \param *context		The context to pass to the allocator.
+ */
+
+void container_stack_init(struct container_stack *stack, size_t element_size, container_allocator allocator, void *context);
+
+
+/**
+ * Release the storage used by a stack, leaving it empty.
+ *
+ * \param *stack		The stack to free.
+ */
+
+void container_stack_free(struct container_stack *stack);
+
+
+/**
+ * Push an element on to a stack.
+ *
+ * \param *stack		The stack to push on to.
+ * \param *element		Pointer to the element to copy in.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+osbool container_stack_push(struct container_stack *stack, void *element);
+
+
+/**
+ * Pull (remove completely) the element from the top of a stack.
+ *
+ * \param *stack		The stack to pull from.
+ * \param *element		Pointer to a buffer to take the element, or NULL.
+ * \return			TRUE if an element was pulled; FALSE if empty.
+ */
+
+osbool container_stack_pull(struct container_stack *stack, void *element);
+
+
+/**
+ * Find the element at the top of a stack, without removing it.
+ *
+ * \param *stack		The stack to look at.
+ * \return			Pointer to the top element, or NULL if empty.
+ */
+
+void *container_stack_top(struct container_stack *stack);
+
+
+/**
+ * Initialise an empty ring buffer.
+ *
+ * \param *ring			The ring buffer to initialise.
+ * \param element_size		The size of each element, in bytes.
+ * \param allocator		The allocator to use, or NULL for malloc().
+ * \param *context		The context to pass to the allocator.
+ */
+
+void container_ring_init(struct container_ring *ring, size_t element_size, container_allocator allocator, void *context);
+
+
+/**
+ * Release the storage used by a ring buffer, leaving it empty.
+ *
+ * \param *ring			The ring buffer to free.
+ */
+
+void container_ring_free(struct container_ring *ring);
+
+
+/**
+ * Add an element to the tail of a ring buffer, growing it if required.
+ *
+ * \param *ring			The ring buffer to add to.
+ * \param *element		Pointer to the element to copy in.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+osbool container_ring_push(struct container_ring *ring, void *element);
+
+
+/**
+ * Remove the element from the head of a ring buffer.
+ *
+ * \param *ring			The ring buffer to remove from.
+ * \param *element		Pointer to a buffer to take the element, or NULL.
+ * \return			TRUE if an element was removed; FALSE if empty.
+ */
+
+osbool container_ring_pull(struct container_ring *ring, void *element);
+
+
+/**
+ * Find the element at the head of a ring buffer, without removing it.
+ *
+ * \param *ring			The ring buffer to look at.
+ * \return			Pointer to the head element, or NULL if empty.
+ */
+
+void *container_ring_peek(struct container_ring *ring);
+
+
+/**
+ * Initialise an empty integer-keyed map.
+ *
+ * \param *map			The map to initialise.
+ * \param allocator		The allocator to use, or NULL for malloc().
+ * \param *context		The context to pass to the allocator.
+ */
+
+void container_int_map_init(struct container_int_map *map, container_allocator allocator, void *context);
+
+
+/**
+ * Release the storage used by an integer-keyed map, leaving it empty.
+ *
+ * \param *map			The map to free.
+ */
+
+void container_int_map_free(struct container_int_map *map);
+
+
+/**
+ * Set the value for a key in an integer-keyed map, replacing any existing
+ * value.
+ *
+ * \param *map			The map to update.
+ * \param key			The key to set.
+ * \param *value		The value to store.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+osbool container_int_map_set(struct container_int_map *map, int key, void *value);
+
+
+/**
+ * Look up a key in an integer-keyed map.
+ *
+ * \param *map			The map to search.
+ * \param key			The key to look up.
+ * \param **value		Pointer to a variable to take the value, or NULL.
+ * \return			TRUE if the key was found; else FALSE.
+ */
+
+osbool container_int_map_find(struct container_int_map *map, int key, void **value);
+
+
+/**
+ * Remove a key from an integer-keyed map.
+ *
+ * \param *map			The map to update.
+ * \param key			The key to remove.
+ * \return			TRUE if the key was removed; FALSE if not found.
+ */
+
+osbool container_int_map_remove(struct container_int_map *map, int key);
+
+
+/**
+ * Initialise an empty string-keyed map.  Keys are copied into the map, and
+ * are compared case-sensitively.
+ *
+ * \param *map			The map to initialise.
+ * \param allocator		The allocator to use, or NULL for malloc().
+ * \param *context		The context to pass to the allocator.
+ */
+
+void container_string_map_init(struct container_string_map *map, container_allocator allocator, void *context);
+
+
+/**
+ * Release the storage used by a string-keyed map, leaving it empty.
+ *
+ * \param *map			The map to free.
+ */
+
+void container_string_map_free(struct container_string_map *map);
+
+
+/**
+ * Set the value for a key in a string-keyed map, replacing any existing
+ * value.
+ *
+ * \param *map			The map to update.
+ * \param *key			The key to set.
+ * \param *value		The value to store.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+osbool container_string_map_set(struct container_string_map *map, const char *key, void *value);
+
+
+/**
+ * Look up a key in a string-keyed map.
+ *
+ * \param *map			The map to search.
+ * \param *key			The key to look up.
+ * \param **value		Pointer to a variable to take the value, or NULL.
+ * \return			TRUE if the key was found; else FALSE.
+ */
+
+osbool container_string_map_find(struct container_string_map *map, const char *key, void **value);
+
+
+/**
+ * Remove a key from a string-keyed map.
+ *
+ * \param *map			The map to update.
+ * \param *key			The key to remove.
+ * \return			TRUE if the key was removed; FALSE if not found.
+ */
+
+osbool container_string_map_remove(struct container_string_map *map, const char *key);
+
+#endif
+
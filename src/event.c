@@ -37,6 +37,7 @@
 #include "event.h"
 #include "icons.h"
 #include "menus.h"
+#include "pool.h"
 #include "string.h"
 
 /* ANSII C header files. */
@@ -177,6 +178,7 @@ struct event_window {
 	void				(*gain_caret)(wimp_caret *caret);						/**< Callback handler for Gain Caret events, or NULL.			*/
 
 	wimp_menu			*menu;										/**< Wimp window block for the Window Menu, or NULL.			*/
+	struct menus_virtual		*virtual_menu;									/**< The virtual menu supplying the Window Menu, or NULL.		*/
 	void				(*menu_prepare)(wimp_w w, wimp_menu *m, wimp_pointer *pointer);			/**< Callback handler for Menu Prepare events, or NULL.			*/
 	void				(*menu_selection)(wimp_w w, wimp_menu *m, wimp_selection *selection);		/**< Callback handler for Menu Selection events, or NULL.		*/
 	void				(*menu_close)(wimp_w w, wimp_menu *m);						/**< Callback handler for Menu Close events, or NULL.			*/
@@ -235,6 +237,7 @@ struct event_callback {
 static struct event_message	*event_message_list = NULL;
 static struct event_window	*event_window_list = NULL;
 static struct event_callback	*event_callback_list = NULL;
+static struct pool_block	*event_callback_pool = NULL;
 
 static struct event_window	*current_menu = NULL;
 static enum event_menu_type	current_menu_type = EVENT_MENU_NONE;
@@ -547,8 +550,10 @@ static osbool event_process_mouse_click(wimp_pointer *pointer)
 		new_client_menu = NULL;
 		if (win->menu_prepare != NULL)
 			(win->menu_prepare)(win->w, win->menu, pointer);
-		if (new_client_menu != NULL)
+		if (new_client_menu != NULL && new_client_menu != win->menu) {
 			win->menu = new_client_menu;
+			win->virtual_menu = NULL;
+		}
 		if (win->w == wimp_ICON_BAR)
 			menu = menus_create_iconbar_menu(win->menu, pointer);
 		else
@@ -764,6 +769,12 @@ static osbool event_process_menu_selection(wimp_selection *selection)
 			complete = current_menu_action->data.popup.complete;
 	}
 
+	/* Selecting a range entry in a virtual menu doesn't select anything. */
+
+	if (current_menu_type == EVENT_MENU_WINDOW && current_menu->virtual_menu != NULL &&
+			menus_virtual_decode(current_menu->virtual_menu, selection, 0) == -1)
+		complete = TRUE;
+
 	/* Process the window-level callback if required. */
 
 	if (current_menu->menu_selection != NULL && complete == FALSE)
@@ -783,7 +794,10 @@ static osbool event_process_menu_selection(wimp_selection *selection)
 		if (new_client_menu != NULL) {
 			switch (current_menu_type) {
 			case EVENT_MENU_WINDOW:
-				current_menu->menu = new_client_menu;
+				if (new_client_menu != current_menu->menu) {
+					current_menu->menu = new_client_menu;
+					current_menu->virtual_menu = NULL;
+				}
 				break;
 			case EVENT_MENU_POPUP_MANUAL:
 			case EVENT_MENU_POPUP_AUTO:
@@ -805,6 +819,8 @@ static osbool event_process_menu_selection(wimp_selection *selection)
 	} else {
 		if (current_menu->menu_close != NULL && current_menu_type != EVENT_MENU_POPUP_AUTO)
 			(current_menu->menu_close)(current_menu->w, menu);
+		if (current_menu != NULL && current_menu_type == EVENT_MENU_WINDOW)
+			menus_virtual_release(current_menu->virtual_menu);
 		current_menu = NULL;
 		current_menu_type = EVENT_MENU_NONE;
 		current_menu_icon = NULL;
@@ -915,6 +931,8 @@ static osbool event_process_user_message(wimp_event_no event, wimp_message *mess
 							current_menu_action->data.popup.menu == menus_deleted->menu))  ) {
 				if (current_menu->menu_close != NULL && current_menu_type != EVENT_MENU_POPUP_AUTO)
 					(current_menu->menu_close)(current_menu->w, menus_deleted->menu);
+				if (current_menu != NULL && current_menu_type == EVENT_MENU_WINDOW)
+					menus_virtual_release(current_menu->virtual_menu);
 				current_menu = NULL;
 				current_menu_type = EVENT_MENU_NONE;
 				current_menu_icon = NULL;
@@ -926,7 +944,9 @@ static osbool event_process_user_message(wimp_event_no event, wimp_message *mess
 
 		case message_MENU_WARNING:
 			if (current_menu != NULL) {
-				if (current_menu->menu_warning != NULL && current_menu_type != EVENT_MENU_POPUP_AUTO)
+				if ((current_menu_type != EVENT_MENU_WINDOW || current_menu->virtual_menu == NULL ||
+						!menus_virtual_warning(current_menu->virtual_menu, (wimp_message_menu_warning *) &(message->data), 0)) &&
+						current_menu->menu_warning != NULL && current_menu_type != EVENT_MENU_POPUP_AUTO)
 					(current_menu->menu_warning)(current_menu->w, current_menu->menu, (wimp_message_menu_warning *) &(message->data));
 				special = TRUE;
 			}
@@ -1170,6 +1190,7 @@ osbool event_add_window_menu(wimp_w w, wimp_menu *menu)
 
 	if (block != NULL) {
 		block->menu = menu;
+		block->virtual_menu = NULL;
 		event_add_message_handler(message_MENUS_DELETED, EVENT_MESSAGE_INCOMING, NULL);
 	}
 
@@ -1177,6 +1198,34 @@ osbool event_add_window_menu(wimp_w w, wimp_menu *menu)
 }
 
 
+/* Register a virtual menu to the specified window, to be opened in the
+ * same way as a menu registered by event_add_window_menu().
+ *
+ * This function is an external interface, documented in event.h.
+ */
+
+osbool event_add_window_virtual_menu(wimp_w w, struct menus_virtual *virtual)
+{
+	struct event_window	*block;
+	wimp_menu		*menu;
+
+	menu = menus_virtual_get_menu(virtual);
+	if (menu == NULL)
+		return FALSE;
+
+	block = event_create_window(w);
+
+	if (block != NULL) {
+		block->menu = menu;
+		block->virtual_menu = virtual;
+		event_add_message_handler(message_MENUS_DELETED, EVENT_MESSAGE_INCOMING, NULL);
+		event_add_message_handler(message_MENU_WARNING, EVENT_MESSAGE_INCOMING, NULL);
+	}
+
+	return (block == NULL) ? FALSE : TRUE;
+}
+
+
 /* Add a menu prepare event handler for the specified window.
  *
  * This function is an external interface, documented in event.h.
@@ -1805,6 +1854,7 @@ static struct event_window *event_create_window(wimp_w w)
 		block->gain_caret = NULL;
 
 		block->menu = NULL;
+		block->virtual_menu = NULL;
 
 		block->menu_prepare = NULL;
 		block->menu_selection = NULL;
@@ -2229,7 +2279,10 @@ osbool event_add_regular_callback(wimp_w w, os_t delay, os_t interval, osbool (*
 
 	/* Create a new callback block. */
 
-	new = (struct event_callback *) malloc(sizeof(struct event_callback));
+	if (event_callback_pool == NULL)
+		event_callback_pool = pool_create_for(struct event_callback, POOL_FLAGS_NONE);
+
+	new = pool_alloc(event_callback_pool);
 	if (new == NULL)
 		return FALSE;
 
@@ -2288,7 +2341,7 @@ void event_delete_callback(osbool (*callback)(os_t time, void *data))
 		if ((*list)->callback == callback) {
 			delete = *list;
 			*list = (*list)->next;
-			free(delete);
+			pool_free(event_callback_pool, delete);
 		} else {
 			list = &((*list)->next);
 		}
@@ -2311,7 +2364,7 @@ void event_delete_callback_by_data(osbool (*callback)(os_t time, void *data), vo
 		if ((*list)->callback == callback && (*list)->data == data) {
 			delete = *list;
 			*list = (*list)->next;
-			free(delete);
+			pool_free(event_callback_pool, delete);
 		} else {
 			list = &((*list)->next);
 		}
@@ -2333,7 +2386,7 @@ static void event_delete_window_callbacks(struct event_window *window)
 		if ((*list)->window == window) {
 			delete = *list;
 			*list = (*list)->next;
-			free(delete);
+			pool_free(event_callback_pool, delete);
 		} else {
 			list = &((*list)->next);
 		}
@@ -2392,7 +2445,7 @@ static osbool event_process_callbacks(os_t time)
 	/* If this is a one-shot, free the memory. */
 
 	if (free_pending == TRUE)
-		free(callback);
+		pool_free(event_callback_pool, callback);
 
 	return result;
 }
@@ -99,6 +99,10 @@
  * closes, either via a Select-click selection, or via a click away from the
  * menu itself.
  *
+ * Window menus can also be virtual menus, registered via
+ * event_add_window_virtual_menu(), whose pages are built as they are opened
+ * and whose Menu Warning events are handled by EventLib.
+ *
  * It follows from the above that any Mouse Click event handler associated
  * with a window will never be called to process Menu-clicks if the window has
  * a Window menu associated with it.
@@ -129,6 +133,12 @@
 #include "oslib/types.h"
 #include "oslib/wimp.h"
 
+/**
+ * A virtual menu, defined in menus.h.
+ */
+
+struct menus_virtual;
+
 /**
  * Categorization of Wimp Message types.  A bitfield, where:
  *
@@ -291,6 +301,23 @@ osbool event_add_window_gain_caret_event(wimp_w w, void (*callback)(wimp_caret *
 osbool event_add_window_menu(wimp_w w, wimp_menu *menu);
 
 
+/**
+ * Register a virtual menu to the specified window, which will be opened as
+ * if it had been registered by event_add_window_menu().  The pages of the
+ * menu are built and opened as the Wimp warns of them, and released when
+ * the menu closes; Menu Selection events are only sent when an entry in
+ * the logical list is chosen, and the handler can find the entry's index
+ * with menus_virtual_decode() at level 0.  The virtual menu must not be
+ * destroyed while it remains registered.
+ *
+ * \param  w		The window handle to attach the menu to.
+ * \param  *virtual	The virtual menu.
+ * \return		TRUE if the handler was registered; else FALSE.
+ */
+
+osbool event_add_window_virtual_menu(wimp_w w, struct menus_virtual *virtual);
+
+
 /**
  * Add a menu prepare event handler for the specified window.
  *
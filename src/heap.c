@@ -25,12 +25,27 @@
  * \file: heap.c
  *
  * Flexlib-based static heap implementation, providing malloc-like calls
- * on an OS_Heap managed heap inside the first block of a flex heap.
+ * on an OS_Heap managed heap inside the first block of a flex heap.  If
+ * SFLIB_HOST is defined, the heap is built over the host implementations
+ * of flex and OS_Heap in heaphost.c instead.
  */
 
+/* The heap always provides both the standard and the debug entry points. */
+
+#undef HEAP_DEBUG
+
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 
+#ifdef SFLIB_HOST
+
+/* Host implementations of the flex and OS_Heap calls. */
+
+#include "heaphost.h"
+
+#else
+
 /* Acorn C header files. */
 
 #include "flex.h"
@@ -42,10 +57,16 @@
 #include "oslib/messagetrans.h"
 #include "oslib/wimp.h"
 
+#endif
+
 /* SF-Lib header files. */
 
 #include "heap.h"
+
+#ifndef SFLIB_HOST
 #include "errors.h"
+#include "event.h"
+#endif
 
 #include "debug.h"
 
@@ -53,11 +74,142 @@
 #define HEAP_GRANULARITY 1024							/**< The size of standard allocations from flex.			*/
 #define HEAP_BLOCK_OHEAD 16							/**< The amount of memory requuired by OS_Heap to manage a heap block.	*/
 
+#define HEAP_CLASS_MIN_SHIFT 4							/**< The log2 of the smallest size class, in bytes.			*/
+#define HEAP_CLASSES 8								/**< The number of size classes, so the largest is 2048 bytes.		*/
+#define HEAP_CLASS_MAX (1 << (HEAP_CLASS_MIN_SHIFT + HEAP_CLASSES - 1))		/**< The size of the largest size class, in bytes.			*/
+#define HEAP_CACHE_LIMIT (64 * 1024)						/**< The number of bytes held on the free lists before a bulk trim.	*/
+
+#define HEAP_DEFAULT_LOW_WATER (4 * 1024)					/**< The default amount of free space left after a trim.		*/
+#define HEAP_DEFAULT_HIGH_WATER (16 * 1024)					/**< The default amount of free space which triggers a trim.		*/
+#define HEAP_TRIM_DELAY 100							/**< The delay before a deferred trim, in centiseconds.			*/
+
+#define HEAP_DEBUG_BUCKETS 256							/**< The number of hash buckets used to track debug allocations.	*/
+
+#define HEAP_ARENA_CHUNK_SIZE (16 * 1024)					/**< The default size of the chunks claimed by an arena.		*/
+#define HEAP_ARENA_ALIGN 8							/**< The default alignment of blocks allocated from an arena.		*/
+
+/**
+ * A chunk of memory owned by an arena.  The chunk's memory follows
+ * directly after this header.
+ */
+
+struct heap_arena_chunk {
+	struct heap_arena_chunk	*previous;					/**< The previous chunk in the arena, or the next spare chunk.	*/
+	size_t			size;						/**< The size of the memory in the chunk.			*/
+	size_t			used;						/**< The number of bytes allocated from the chunk.		*/
+	size_t			last;						/**< The offset of the most recent block in the chunk.		*/
+};
+
+/**
+ * A record of the location which claimed a block, for heap debugging.
+ */
+
+struct heap_debug_record {
+	void				*block;					/**< The block which was claimed.				*/
+	size_t				size;					/**< The size of the block.					*/
+	const char			*file;					/**< The source file which claimed the block.			*/
+	int				line;					/**< The source line which claimed the block.			*/
+	struct heap_debug_record	*next;					/**< The next record in the hash bucket.			*/
+};
+
+/**
+ * An arena.
+ */
+
+struct heap_arena {
+	struct heap_arena_chunk	*current;					/**< The chunk being allocated from, or NULL.			*/
+	struct heap_arena_chunk	*first;						/**< The oldest chunk in use, or NULL.				*/
+	struct heap_arena_chunk	*spare;						/**< A list of empty chunks available for re-use.		*/
+	size_t			chunk_size;					/**< The default size of chunk to claim.			*/
+};
+
+/**
+ * Free lists of recycled small blocks, one per size class.  The links are
+ * held as offsets from the heap base in the first word of each free block,
+ * with zero marking the end of a list.
+ */
+
+static int	heap_free_lists[HEAP_CLASSES];
+
+/**
+ * The number of bytes currently held on the free lists.
+ */
+
+static size_t	heap_cached_bytes = 0;
+
+/**
+ * The amount of free space to leave at the end of the heap after a trim.
+ */
+
+static size_t	heap_low_water = HEAP_DEFAULT_LOW_WATER;
+
+/**
+ * The amount of free space at the end of the heap above which a trim will
+ * shrink it.
+ */
+
+static size_t	heap_high_water = HEAP_DEFAULT_HIGH_WATER;
+
+/**
+ * TRUE if a deferred trim is waiting for its callback.
+ */
+
+static osbool	heap_trim_pending = FALSE;
+
+/**
+ * The time at which the pending deferred trim is due.
+ */
+
+static os_t	heap_trim_due = 0;
+
+/**
+ * The total number of bytes returned to flex by trims.
+ */
+
+static size_t	heap_reclaimed_bytes = 0;
+
+/**
+ * TRUE if heap debugging is enabled.
+ */
+
+static osbool			heap_debug_enabled = FALSE;
+
+/**
+ * The allocation counts collected while heap debugging is enabled.
+ */
+
+static struct heap_statistics	heap_debug_counts;
+
+/**
+ * The hash table of tracked blocks, held outside of the heap so that it
+ * doesn't disturb the statistics.
+ */
+
+static struct heap_debug_record	*heap_debug_records[HEAP_DEBUG_BUCKETS];
 
 static byte	*heap_anchor = NULL;
 static int	heap_block_size = HEAP_GRANULARITY;
 
 
+/* Static Function Prototypes. */
+
+static int heap_find_class(size_t size);
+static void *heap_claim(size_t size);
+static void heap_release(void *block);
+static void heap_flush_free_lists(void);
+static void heap_schedule_trim(void);
+static osbool heap_trim_callback(os_t time, void *data);
+static size_t heap_shrink(osbool force);
+static struct heap_arena_chunk *heap_arena_add_chunk(struct heap_arena *arena, size_t size);
+static int heap_debug_find_class(size_t size);
+static void heap_debug_count_alloc(size_t size);
+static void heap_debug_count_free(size_t size);
+static void heap_debug_count_resize(size_t old_size, size_t new_size);
+static void heap_debug_track(void *block, size_t size, const char *file, int line);
+static void heap_debug_untrack(void *block);
+static void heap_debug_move(void *old_block, void *new_block, size_t size);
+
+
 /* Initialise the heap.  Flex must have been initialised via flex_init() before
  * this is called.
  *
@@ -85,28 +237,33 @@ osbool heap_initialise(void)
 
 void *heap_alloc(size_t size)
 {
-	void		*block;
-	os_error	*error;
+	void	*block;
+	int	class, *link;
 
-	size += sizeof(int);
+	class = heap_find_class(size);
 
-	error = xosheap_alloc(heap_anchor, size, &block);
-	if (error != NULL) {
-		if (flex_extend ((flex_ptr) &heap_anchor, heap_block_size + size + HEAP_BLOCK_OHEAD)) {
-			osheap_resize(heap_anchor, size + HEAP_BLOCK_OHEAD);
-			heap_block_size += (size + HEAP_BLOCK_OHEAD);
+	/* Small blocks are recycled from the free lists if possible, and are
+	 * otherwise claimed at the full size of their class so that they can
+	 * be recycled for any request in it later on.
+	 */
 
-			error = xosheap_alloc(heap_anchor, size, &block);
-			if (error != NULL)
-				error_report_program (error);
-		} else {
-			block = NULL;
-		}
+	if (class == -1) {
+		block = heap_claim(size + sizeof(int));
+	} else if (heap_free_lists[class] != 0) {
+		block = heap_anchor + heap_free_lists[class];
+		link = (int *) block + 1;
+		heap_free_lists[class] = *link;
+		heap_cached_bytes -= (1 << (class + HEAP_CLASS_MIN_SHIFT));
+	} else {
+		block = heap_claim((1 << (class + HEAP_CLASS_MIN_SHIFT)) + sizeof(int));
 	}
 
 	if (block != NULL) {
-		*(int *)block = size - sizeof (int);
+		*(int *)block = size;
 		block = (int *) block + 1;
+
+		if (heap_debug_enabled)
+			heap_debug_count_alloc(size);
 	}
 
 	return block;
@@ -120,17 +277,38 @@ void *heap_alloc(size_t size)
 
 void heap_free(void *ptr)
 {
-	int	shrink;
+	int	class;
+
+	if (ptr == NULL)
+		return;
+
+	if (heap_debug_enabled) {
+		heap_debug_count_free(*((int *) ptr - 1));
+		heap_debug_untrack(ptr);
+	}
 
 	ptr = (int *) ptr - 1;
 
-	osheap_free(heap_anchor, ptr);
+	class = heap_find_class(*(int *) ptr);
 
-	shrink = osheap_resize_no_fail(heap_anchor, 0x80000000);
+	/* Large blocks go straight back to OS_Heap. */
 
-	if (shrink < 0) {
-		heap_block_size += shrink;
-		flex_extend((flex_ptr) &heap_anchor, heap_block_size);
+	if (class == -1) {
+		heap_release(ptr);
+		return;
+	}
+
+	/* Small blocks are pushed on to the free list for their class, without
+	 * any SWIs, until enough have built up to be worth trimming.
+	 */
+
+	*((int *) ptr + 1) = heap_free_lists[class];
+	heap_free_lists[class] = (byte *) ptr - heap_anchor;
+	heap_cached_bytes += (1 << (class + HEAP_CLASS_MIN_SHIFT));
+
+	if (heap_cached_bytes > HEAP_CACHE_LIMIT) {
+		heap_flush_free_lists();
+		heap_schedule_trim();
 	}
 }
 
@@ -143,13 +321,51 @@ void heap_free(void *ptr)
 
 void *heap_extend(void *ptr, size_t new_size)
 {
-	int		change;
-	void		*block;
+	int		change, old_class, new_class;
+	void		*block, *old_ptr = ptr;
+	size_t		old_size;
 	os_error	*error;
 
+	old_size = *((int *) ptr - 1);
+	old_class = heap_find_class(old_size);
+	new_class = heap_find_class(new_size);
+
+	/* A small block which stays within its size class can be updated in
+	 * place; if either end of the change is small, the block must move
+	 * between the free list and OS_Heap regimes, so copy it.
+	 */
+
+	if (old_class != -1 && old_class == new_class) {
+		*((int *) ptr - 1) = new_size;
+
+		if (heap_debug_enabled) {
+			heap_debug_count_resize(old_size, new_size);
+			heap_debug_move(ptr, ptr, new_size);
+		}
+
+		return ptr;
+	}
+
+	if (old_class != -1 || new_class != -1) {
+		block = heap_alloc(new_size);
+
+		if (block != NULL) {
+			memcpy(block, ptr, (old_size < new_size) ? old_size : new_size);
+
+			/* Move any record before heap_free() can discard it. */
+
+			if (heap_debug_enabled)
+				heap_debug_move(ptr, block, new_size);
+
+			heap_free(ptr);
+		}
+
+		return block;
+	}
+
 	new_size += sizeof(int);
 	ptr = (int *) ptr - 1;
-	change = new_size - *(int *)ptr;
+	change = new_size - (*(int *)ptr + sizeof(int));
 
 	error = xosheap_realloc(heap_anchor, ptr, change, &block);
 	if (error != NULL) {
@@ -168,46 +384,917 @@ void *heap_extend(void *ptr, size_t new_size)
 	if (block != NULL) {
 		*(int *) block = new_size - sizeof(int);
 		block = (int *) block + 1;
+
+		if (heap_debug_enabled) {
+			heap_debug_count_resize(old_size, new_size - sizeof(int));
+			heap_debug_move(old_ptr, block, new_size - sizeof(int));
+		}
 	}
 
 	return block;
 }
 
 
-/* Find the size of a block of memory previously claimed from the heap.
+/* Release all of the small blocks held on the free lists back to OS_Heap,
+ * and shrink the heap as far as possible.
  *
  * This is an external interface, documented in heap.h
  */
 
-size_t heap_size(void *ptr)
+size_t heap_trim(void)
 {
-	return *((size_t *) ptr - 1);
+	if (heap_trim_pending) {
+		event_delete_callback(heap_trim_callback);
+		heap_trim_pending = FALSE;
+	}
+
+	heap_flush_free_lists();
+
+	return heap_shrink(TRUE);
 }
 
 
-/* Perform a strdup() on a string, using memory cliamed by heap_alloc().
+/* Set the thresholds used to decide when the heap should be shrunk.
  *
  * This is an external interface, documented in heap.h
  */
 
-char *heap_strdup(char *string)
+void heap_set_shrink_policy(size_t low_water, size_t high_water)
 {
-	size_t		size = strlen(string) + 1;
-	char		*new = heap_alloc(size);
+	if (high_water < low_water)
+		high_water = low_water;
 
-	if (new != NULL)
-		strncpy(new, string, size);
+	heap_low_water = low_water;
+	heap_high_water = high_water;
+}
+
+
+/* Return the total number of bytes which have been returned to flex by
+ * shrinking the heap.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+size_t heap_get_reclaimed_bytes(void)
+{
+	return heap_reclaimed_bytes;
+}
+
+
+/* Initialise the heap, and enable heap debugging.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+osbool heap_debug_initialise(void)
+{
+	int	i;
+
+	heap_debug_enabled = TRUE;
+
+	memset(&heap_debug_counts, 0, sizeof(struct heap_statistics));
+
+	for (i = 0; i < HEAP_DEBUG_BUCKETS; i++)
+		heap_debug_records[i] = NULL;
+
+	return heap_initialise();
+}
+
+
+/* Allocate a block of memory from the heap, recording the location which
+ * claimed it.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void *heap_debug_alloc(size_t size, const char *file, int line)
+{
+	void	*block;
+
+	block = heap_alloc(size);
+
+	if (block != NULL && heap_debug_enabled)
+		heap_debug_track(block, size, file, line);
+
+	return block;
+}
+
+
+/* Change the size of a block of memory, recording the location which
+ * changed it.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void *heap_debug_extend(void *ptr, size_t new_size, const char *file, int line)
+{
+	void	*block;
+
+	block = heap_extend(ptr, new_size);
+
+	if (block != NULL && heap_debug_enabled) {
+		heap_debug_untrack(ptr);
+		heap_debug_track(block, new_size, file, line);
+	}
+
+	return block;
+}
+
+
+/* Perform a strdup() on a string, recording the location which claimed it.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+char *heap_debug_strdup(char *string, const char *file, int line)
+{
+	char	*new;
+
+	new = heap_strdup(string);
+
+	if (new != NULL && heap_debug_enabled)
+		heap_debug_track(new, heap_size(new), file, line);
 
 	return new;
 }
 
 
-/* Return the pointer to the heap base.
+/* Collect statistics about the use of the heap.
  *
  * This is an external interface, documented in heap.h
  */
 
-byte *heap_base(void)
+osbool heap_get_statistics(struct heap_statistics *statistics)
 {
-	return heap_anchor;
+	int	largest, total;
+
+	if (statistics == NULL || heap_anchor == NULL)
+		return FALSE;
+
+	*statistics = heap_debug_counts;
+
+	statistics->heap_size = heap_block_size;
+	statistics->cached_bytes = heap_cached_bytes;
+
+	/* The fragmentation is the proportion of OS_Heap's free space which
+	 * can't be used for a single claim.
+	 */
+
+	if (xosheap_describe(heap_anchor, &largest, &total) != NULL) {
+		largest = 0;
+		total = 0;
+	}
+
+	statistics->free_bytes = total;
+	statistics->largest_free = largest;
+	statistics->fragmentation = (total > 0) ? 100 - (int) ((largest * 100.0) / total) : 0;
+
+	return TRUE;
+}
+
+
+/* Write the heap statistics and details of the tracked blocks to a file.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+osbool heap_dump_statistics(char *filename)
+{
+	FILE				*out;
+	struct heap_statistics		statistics;
+	struct heap_debug_record	*record;
+	int				i;
+
+	if (!heap_get_statistics(&statistics))
+		return FALSE;
+
+	out = fopen(filename, "w");
+	if (out == NULL)
+		return FALSE;
+
+	fprintf(out, "Heap size:     %u bytes\n", (unsigned) statistics.heap_size);
+	fprintf(out, "Free space:    %u bytes (largest block %u bytes, %d%% fragmented)\n",
+			(unsigned) statistics.free_bytes, (unsigned) statistics.largest_free, statistics.fragmentation);
+	fprintf(out, "Cached blocks: %u bytes\n", (unsigned) statistics.cached_bytes);
+
+	if (!heap_debug_enabled) {
+		fprintf(out, "\nHeap debugging is not enabled.\n");
+		return (fclose(out) == 0) ? TRUE : FALSE;
+	}
+
+	fprintf(out, "Live:          %u bytes in %u blocks\n", (unsigned) statistics.live_bytes, (unsigned) statistics.live_blocks);
+	fprintf(out, "Peak:          %u bytes\n", (unsigned) statistics.peak_bytes);
+	fprintf(out, "Allocations:   %u (%u freed)\n", (unsigned) statistics.allocations, (unsigned) statistics.frees);
+
+	fprintf(out, "\nSize class   Allocations   Live blocks\n");
+
+	for (i = 0; i < HEAP_STATISTICS_CLASSES; i++) {
+		if (i < HEAP_CLASSES)
+			fprintf(out, "<= %-8d", 1 << (i + HEAP_CLASS_MIN_SHIFT));
+		else
+			fprintf(out, "%-11s", "Larger");
+
+		fprintf(out, "  %11u   %11u\n", (unsigned) statistics.class_allocations[i], (unsigned) statistics.class_live_blocks[i]);
+	}
+
+	fprintf(out, "\nTracked live blocks:\n");
+
+	for (i = 0; i < HEAP_DEBUG_BUCKETS; i++) {
+		for (record = heap_debug_records[i]; record != NULL; record = record->next)
+			fprintf(out, "%p %8u bytes  %s:%d\n", record->block, (unsigned) record->size, record->file, record->line);
+	}
+
+	return (fclose(out) == 0) ? TRUE : FALSE;
+}
+
+
+/* Create a new arena, for allocating blocks which will all be released
+ * together.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+struct heap_arena *heap_arena_create(size_t chunk_size)
+{
+	struct heap_arena	*arena;
+
+	arena = malloc(sizeof(struct heap_arena));
+	if (arena == NULL)
+		return NULL;
+
+	arena->current = NULL;
+	arena->first = NULL;
+	arena->spare = NULL;
+	arena->chunk_size = (chunk_size > 0) ? chunk_size : HEAP_ARENA_CHUNK_SIZE;
+
+	return arena;
+}
+
+
+/* Destroy an arena, releasing all of the blocks allocated from it.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void heap_arena_destroy(struct heap_arena *arena)
+{
+	struct heap_arena_chunk	*chunk, *previous;
+
+	if (arena == NULL)
+		return;
+
+	heap_arena_reset(arena);
+
+	chunk = arena->spare;
+
+	while (chunk != NULL) {
+		previous = chunk->previous;
+		free(chunk);
+		chunk = previous;
+	}
+
+	free(arena);
+}
+
+
+/* Allocate a block of memory from an arena, aligned for any type.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void *heap_arena_alloc(struct heap_arena *arena, size_t size)
+{
+	return heap_arena_alloc_aligned(arena, size, HEAP_ARENA_ALIGN);
+}
+
+
+/* Allocate a block of memory from an arena, with a given alignment.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void *heap_arena_alloc_aligned(struct heap_arena *arena, size_t size, size_t align)
+{
+	struct heap_arena_chunk	*chunk;
+	byte			*base;
+	size_t			offset;
+
+	if (arena == NULL || align == 0 || (align & (align - 1)) != 0)
+		return NULL;
+
+	/* Bump-allocate from the current chunk if the block will fit. */
+
+	chunk = arena->current;
+
+	if (chunk != NULL) {
+		base = (byte *) (chunk + 1);
+		offset = (((size_t) base + chunk->used + align - 1) & ~(align - 1)) - (size_t) base;
+
+		if (offset <= chunk->size && size <= chunk->size - offset) {
+			chunk->used = offset + size;
+			chunk->last = offset;
+			return base + offset;
+		}
+	}
+
+	/* Otherwise start a new chunk, big enough to allow for the alignment. */
+
+	chunk = heap_arena_add_chunk(arena, size + align);
+	if (chunk == NULL)
+		return NULL;
+
+	base = (byte *) (chunk + 1);
+	offset = (((size_t) base + align - 1) & ~(align - 1)) - (size_t) base;
+
+	chunk->used = offset + size;
+	chunk->last = offset;
+
+	return base + offset;
+}
+
+
+/* Change the size of a block allocated from an arena.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void *heap_arena_realloc(void *arena, void *block, size_t old_size, size_t new_size)
+{
+	struct heap_arena_chunk	*chunk;
+	void			*new;
+
+	if (arena == NULL || new_size == 0)
+		return NULL;
+
+	/* If this is the most recent block, try to extend it in place. */
+
+	chunk = ((struct heap_arena *) arena)->current;
+
+	if (block != NULL && chunk != NULL && (byte *) block == (byte *) (chunk + 1) + chunk->last &&
+			new_size <= chunk->size - chunk->last) {
+		chunk->used = chunk->last + new_size;
+		return block;
+	}
+
+	new = heap_arena_alloc(arena, new_size);
+
+	if (new != NULL && block != NULL)
+		memcpy(new, block, (old_size < new_size) ? old_size : new_size);
+
+	return new;
+}
+
+
+/* Perform a strdup() on a string, using memory from an arena.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+char *heap_arena_strdup(struct heap_arena *arena, char *string)
+{
+	size_t		size = strlen(string) + 1;
+	char		*new = heap_arena_alloc_aligned(arena, size, 1);
+
+	if (new != NULL)
+		memcpy(new, string, size);
+
+	return new;
+}
+
+
+/* Record the current state of an arena.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void heap_arena_mark(struct heap_arena *arena, struct heap_arena_mark *mark)
+{
+	if (arena == NULL || mark == NULL)
+		return;
+
+	mark->chunk = arena->current;
+	mark->used = (arena->current != NULL) ? arena->current->used : 0;
+}
+
+
+/* Release all of the blocks allocated from an arena since a mark was taken.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void heap_arena_rollback(struct heap_arena *arena, struct heap_arena_mark *mark)
+{
+	struct heap_arena_chunk	*chunk, *previous;
+
+	if (arena == NULL || mark == NULL)
+		return;
+
+	if (mark->chunk == NULL) {
+		heap_arena_reset(arena);
+		return;
+	}
+
+	/* Move any chunks started since the mark on to the spare list. */
+
+	chunk = arena->current;
+
+	while (chunk != NULL && chunk != mark->chunk) {
+		previous = chunk->previous;
+		chunk->previous = arena->spare;
+		arena->spare = chunk;
+		chunk = previous;
+	}
+
+	arena->current = chunk;
+
+	if (chunk != NULL) {
+		chunk->used = mark->used;
+		chunk->last = mark->used;
+	}
+}
+
+
+/* Release all of the blocks allocated from an arena, keeping its memory.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+void heap_arena_reset(struct heap_arena *arena)
+{
+	if (arena == NULL || arena->current == NULL)
+		return;
+
+	/* Splice the whole chain of chunks on to the front of the spare list. */
+
+	arena->first->previous = arena->spare;
+	arena->spare = arena->current;
+
+	arena->current = NULL;
+	arena->first = NULL;
+}
+
+
+/* Find the size of a block of memory previously claimed from the heap.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+size_t heap_size(void *ptr)
+{
+	return *((int *) ptr - 1);
+}
+
+
+/* Perform a strdup() on a string, using memory cliamed by heap_alloc().
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+char *heap_strdup(char *string)
+{
+	size_t		size = strlen(string) + 1;
+	char		*new = heap_alloc(size);
+
+	if (new != NULL)
+		strncpy(new, string, size);
+
+	return new;
+}
+
+
+/* Return the pointer to the heap base.
+ *
+ * This is an external interface, documented in heap.h
+ */
+
+byte *heap_base(void)
+{
+	return heap_anchor;
+}
+
+
+/**
+ * Find the size class which will hold a block of a given size.
+ *
+ * \param size		The size of the block, in bytes.
+ * \return		The size class index, or -1 if the block is too big
+ *			for the size classes.
+ */
+
+static int heap_find_class(size_t size)
+{
+	int	class = 0;
+
+	if (size > HEAP_CLASS_MAX)
+		return -1;
+
+	while (size > ((size_t) 1 << (class + HEAP_CLASS_MIN_SHIFT)))
+		class++;
+
+	return class;
+}
+
+
+/**
+ * Claim a raw block from OS_Heap, extending the flex block holding the
+ * heap if required.
+ *
+ * \param size		The size of the block to claim, including the header.
+ * \return		Pointer to the block, or NULL on failure.
+ */
+
+static void *heap_claim(size_t size)
+{
+	void		*block;
+	os_error	*error;
+
+	error = xosheap_alloc(heap_anchor, size, &block);
+	if (error != NULL) {
+		if (flex_extend ((flex_ptr) &heap_anchor, heap_block_size + size + HEAP_BLOCK_OHEAD)) {
+			osheap_resize(heap_anchor, size + HEAP_BLOCK_OHEAD);
+			heap_block_size += (size + HEAP_BLOCK_OHEAD);
+
+			error = xosheap_alloc(heap_anchor, size, &block);
+			if (error != NULL)
+				error_report_program (error);
+		} else {
+			block = NULL;
+		}
+	}
+
+	return block;
+}
+
+
+/**
+ * Release a raw block to OS_Heap, and arrange for the heap to be checked
+ * for shrinking once the application is idle.
+ *
+ * \param *block	Pointer to the block to release.
+ */
+
+static void heap_release(void *block)
+{
+	osheap_free(heap_anchor, block);
+
+	heap_schedule_trim();
+}
+
+
+/**
+ * Release all of the small blocks held on the free lists back to OS_Heap.
+ */
+
+static void heap_flush_free_lists(void)
+{
+	int	class, offset, next;
+
+	for (class = 0; class < HEAP_CLASSES; class++) {
+		offset = heap_free_lists[class];
+
+		while (offset != 0) {
+			next = *((int *) (heap_anchor + offset) + 1);
+			osheap_free(heap_anchor, heap_anchor + offset);
+			offset = next;
+		}
+
+		heap_free_lists[class] = 0;
+	}
+
+	heap_cached_bytes = 0;
+}
+
+
+/**
+ * Schedule a deferred trim of the heap, if one isn't already pending.  This
+ * means that bursts of frees only result in a single check of the heap,
+ * and alternating claims and frees don't move flex memory back and forth.
+ */
+
+static void heap_schedule_trim(void)
+{
+	os_t	now;
+
+	if (xos_read_monotonic_time(&now) != NULL) {
+		heap_shrink(FALSE);
+		return;
+	}
+
+	/* A pending trim which is well overdue means that Null events aren't
+	 * reaching the event library's callbacks, so trim immediately instead.
+	 */
+
+	if (heap_trim_pending) {
+		if (now - heap_trim_due > HEAP_TRIM_DELAY)
+			heap_shrink(FALSE);
+
+		return;
+	}
+
+	heap_trim_pending = event_add_single_callback(NULL, HEAP_TRIM_DELAY, heap_trim_callback, NULL);
+	heap_trim_due = now + HEAP_TRIM_DELAY;
+
+	/* If the callback couldn't be registered, trim immediately instead. */
+
+	if (!heap_trim_pending)
+		heap_shrink(FALSE);
+}
+
+
+/**
+ * Callback to carry out a deferred trim of the heap.
+ *
+ * \param time		The time of the callback (unused).
+ * \param *data		NULL (unused).
+ * \return		FALSE, so that the Null event is passed on.
+ */
+
+static osbool heap_trim_callback(os_t time, void *data)
+{
+	(void) time;
+	(void) data;
+
+	heap_trim_pending = FALSE;
+
+	heap_shrink(FALSE);
+
+	return FALSE;
+}
+
+
+/**
+ * Shrink the heap and the flex block holding it, if the amount of free
+ * space at the end of the heap is above the high water mark.  The heap
+ * is shrunk so that the low water mark's worth of free space remains.
+ *
+ * \param force		TRUE to shrink the heap as far as possible,
+ *			regardless of the thresholds.
+ * \return		The number of bytes returned to flex.
+ */
+
+static size_t heap_shrink(osbool force)
+{
+	int	shrink;
+	size_t	slack, keep, reclaimed;
+
+	/* Find the free space at the end of the heap by shrinking it as far as
+	 * possible; the amount to keep is then handed back to the heap, which
+	 * doesn't involve moving any flex memory.
+	 */
+
+	shrink = osheap_resize_no_fail(heap_anchor, 0x80000000);
+	if (shrink >= 0)
+		return 0;
+
+	slack = -shrink;
+
+	if (force)
+		keep = 0;
+	else if (slack <= heap_high_water)
+		keep = slack;
+	else
+		keep = heap_low_water;
+
+	if (keep > 0)
+		osheap_resize(heap_anchor, keep);
+
+	reclaimed = slack - keep;
+
+	if (reclaimed > 0) {
+		heap_block_size -= reclaimed;
+		flex_extend((flex_ptr) &heap_anchor, heap_block_size);
+		heap_reclaimed_bytes += reclaimed;
+	}
+
+	return reclaimed;
+}
+
+
+/**
+ * Start a new chunk in an arena, re-using a spare chunk if there is one
+ * which is big enough.
+ *
+ * \param *arena	The arena to add the chunk to.
+ * \param size		The minimum amount of memory required in the chunk.
+ * \return		Pointer to the new chunk, or NULL on failure.
+ */
+
+static struct heap_arena_chunk *heap_arena_add_chunk(struct heap_arena *arena, size_t size)
+{
+	struct heap_arena_chunk	*chunk;
+
+	chunk = arena->spare;
+
+	if (chunk != NULL && chunk->size >= size) {
+		arena->spare = chunk->previous;
+	} else {
+		if (size < arena->chunk_size)
+			size = arena->chunk_size;
+
+		chunk = malloc(sizeof(struct heap_arena_chunk) + size);
+		if (chunk == NULL)
+			return NULL;
+
+		chunk->size = size;
+	}
+
+	chunk->used = 0;
+	chunk->last = 0;
+	chunk->previous = arena->current;
+
+	if (arena->first == NULL)
+		arena->first = chunk;
+
+	arena->current = chunk;
+
+	return chunk;
+}
+
+
+/**
+ * Find the statistics histogram slot for a block of a given size.
+ *
+ * \param size		The size of the block, in bytes.
+ * \return		The histogram slot index.
+ */
+
+static int heap_debug_find_class(size_t size)
+{
+	int	class;
+
+	class = heap_find_class(size);
+
+	return (class == -1) ? HEAP_CLASSES : class;
+}
+
+
+/**
+ * Count a new allocation in the heap debug statistics.
+ *
+ * \param size		The size of the new block.
+ */
+
+static void heap_debug_count_alloc(size_t size)
+{
+	int	class = heap_debug_find_class(size);
+
+	heap_debug_counts.live_bytes += size;
+	heap_debug_counts.live_blocks++;
+	heap_debug_counts.allocations++;
+	heap_debug_counts.class_allocations[class]++;
+	heap_debug_counts.class_live_blocks[class]++;
+
+	if (heap_debug_counts.live_bytes > heap_debug_counts.peak_bytes)
+		heap_debug_counts.peak_bytes = heap_debug_counts.live_bytes;
+}
+
+
+/**
+ * Count a block being freed in the heap debug statistics.
+ *
+ * \param size		The size of the block.
+ */
+
+static void heap_debug_count_free(size_t size)
+{
+	int	class = heap_debug_find_class(size);
+
+	/* Blocks claimed before debugging was enabled mustn't wrap the counts. */
+
+	heap_debug_counts.live_bytes -= (size < heap_debug_counts.live_bytes) ? size : heap_debug_counts.live_bytes;
+
+	if (heap_debug_counts.live_blocks > 0)
+		heap_debug_counts.live_blocks--;
+
+	if (heap_debug_counts.class_live_blocks[class] > 0)
+		heap_debug_counts.class_live_blocks[class]--;
+
+	heap_debug_counts.frees++;
+}
+
+
+/**
+ * Count a block changing size in the heap debug statistics.
+ *
+ * \param old_size	The old size of the block.
+ * \param new_size	The new size of the block.
+ */
+
+static void heap_debug_count_resize(size_t old_size, size_t new_size)
+{
+	int	old_class = heap_debug_find_class(old_size);
+	int	new_class = heap_debug_find_class(new_size);
+
+	heap_debug_counts.live_bytes -= (old_size < heap_debug_counts.live_bytes) ? old_size : heap_debug_counts.live_bytes;
+	heap_debug_counts.live_bytes += new_size;
+
+	if (old_class != new_class) {
+		if (heap_debug_counts.class_live_blocks[old_class] > 0)
+			heap_debug_counts.class_live_blocks[old_class]--;
+
+		heap_debug_counts.class_live_blocks[new_class]++;
+	}
+
+	if (heap_debug_counts.live_bytes > heap_debug_counts.peak_bytes)
+		heap_debug_counts.peak_bytes = heap_debug_counts.live_bytes;
+}
+
+
+/**
+ * Record the location which claimed a block.  Any existing record for the
+ * block is replaced.
+ *
+ * \param *block	The block which was claimed.
+ * \param size		The size of the block.
+ * \param *file		The source file which claimed the block.
+ * \param line		The source line which claimed the block.
+ */
+
+static void heap_debug_track(void *block, size_t size, const char *file, int line)
+{
+	struct heap_debug_record	*record;
+	int				bucket;
+
+	heap_debug_untrack(block);
+
+	record = malloc(sizeof(struct heap_debug_record));
+	if (record == NULL)
+		return;
+
+	bucket = ((size_t) block >> 2) % HEAP_DEBUG_BUCKETS;
+
+	record->block = block;
+	record->size = size;
+	record->file = file;
+	record->line = line;
+	record->next = heap_debug_records[bucket];
+
+	heap_debug_records[bucket] = record;
+}
+
+
+/**
+ * Remove the record of the location which claimed a block, if there is one.
+ *
+ * \param *block	The block to remove the record for.
+ */
+
+static void heap_debug_untrack(void *block)
+{
+	struct heap_debug_record	**link, *record;
+
+	link = &heap_debug_records[((size_t) block >> 2) % HEAP_DEBUG_BUCKETS];
+
+	while (*link != NULL) {
+		record = *link;
+
+		if (record->block == block) {
+			*link = record->next;
+			free(record);
+			return;
+		}
+
+		link = &record->next;
+	}
+}
+
+
+/**
+ * Move the record of the location which claimed a block to follow the
+ * block to a new address and size, if there is a record for it.
+ *
+ * \param *old_block	The block's previous address.
+ * \param *new_block	The block's new address, which may be the same.
+ * \param size		The block's new size.
+ */
+
+static void heap_debug_move(void *old_block, void *new_block, size_t size)
+{
+	struct heap_debug_record	**link, *record;
+	int				bucket;
+
+	link = &heap_debug_records[((size_t) old_block >> 2) % HEAP_DEBUG_BUCKETS];
+
+	while (*link != NULL && (*link)->block != old_block)
+		link = &(*link)->next;
+
+	record = *link;
+	if (record == NULL)
+		return;
+
+	record->size = size;
+
+	if (new_block == old_block)
+		return;
+
+	*link = record->next;
+
+	heap_debug_untrack(new_block);
+
+	bucket = ((size_t) new_block >> 2) % HEAP_DEBUG_BUCKETS;
+
+	record->block = new_block;
+	record->next = heap_debug_records[bucket];
+
+	heap_debug_records[bucket] = record;
 }
@@ -25,14 +25,73 @@
  * \file: heap.h
  *
  * Flexlib-based static heap implementation, providing malloc-like calls
- * on an OS_Heap managed heap inside the first block of a flex heap.
+ * on an OS_Heap managed heap inside the first block of a flex heap.  Small
+ * blocks are recycled through size-class free lists held within the heap,
+ * so that they can be claimed and freed without calling OS_Heap.
  */
 
 #ifndef SFLIB_HEAP
 #define SFLIB_HEAP
 
 #include <stdlib.h>
+
+/* The heap can also be built for the host, which doesn't have OSLib. */
+
+#ifdef SFLIB_HOST
+#ifndef SFLIB_HOST_TYPES
+#define SFLIB_HOST_TYPES
+typedef int osbool;
+typedef unsigned char byte;
+#define TRUE 1
+#define FALSE 0
+#endif
+#else
 #include "oslib/types.h"
+#endif
+
+/**
+ * The number of size classes reported in the heap statistics histograms.
+ * The first eight cover blocks of up to 16, 32, ... 2048 bytes; the last
+ * covers all larger blocks.
+ */
+
+#define HEAP_STATISTICS_CLASSES 9
+
+/**
+ * Statistics about the use of the heap.  The allocation counts are only
+ * collected while heap debugging is enabled.
+ */
+
+struct heap_statistics {
+	size_t			live_bytes;				/**< The number of bytes currently allocated.			*/
+	size_t			peak_bytes;				/**< The largest number of bytes allocated at once.		*/
+	size_t			live_blocks;				/**< The number of blocks currently allocated.			*/
+	size_t			allocations;				/**< The total number of allocations made.			*/
+	size_t			frees;					/**< The total number of blocks freed.				*/
+	size_t			class_allocations[HEAP_STATISTICS_CLASSES];	/**< The total allocations made in each size class.	*/
+	size_t			class_live_blocks[HEAP_STATISTICS_CLASSES];	/**< The blocks currently allocated in each size class.	*/
+	size_t			heap_size;				/**< The size of the flex block holding the heap.		*/
+	size_t			free_bytes;				/**< The free space within OS_Heap.				*/
+	size_t			largest_free;				/**< The largest free block within OS_Heap.			*/
+	size_t			cached_bytes;				/**< The bytes held on the small block free lists.		*/
+	int			fragmentation;				/**< The percentage of OS_Heap free space outside the largest block.	*/
+};
+
+/**
+ * An arena, from which blocks can be allocated and then all released
+ * together.
+ */
+
+struct heap_arena;
+
+/**
+ * A point in an arena's allocations, which it can later be rolled back to.
+ */
+
+struct heap_arena_mark {
+	void			*chunk;					/**< The chunk which was current when the mark was taken.	*/
+	size_t			used;					/**< The number of bytes used in the chunk.			*/
+};
 
 /**
  * Initialise the heap.  Flex must have been initialised via flex_init() before
@@ -63,6 +122,48 @@ void * heap_alloc(size_t size);
 void heap_free(void *ptr);
 
 
+/**
+ * Release any small blocks which are being held for re-use back to the
+ * heap, and shrink the heap as far as possible.  Freed memory is otherwise
+ * returned to flex by a deferred trim, which runs from an event library
+ * callback once the application is idle; this only needs to be called if
+ * the memory is wanted immediately.
+ *
+ * Clients which don't pass Null events to event_process_event() never
+ * receive the callback.  Once it is overdue, the heap trims as memory is
+ * freed instead, but such clients should call this after releasing large
+ * amounts of memory, as nothing is trimmed until something else is freed.
+ *
+ * \return		The number of bytes returned to flex.
+ */
+
+size_t heap_trim(void);
+
+
+/**
+ * Set the thresholds used by deferred trims to decide when the heap should
+ * be shrunk.  The heap is only shrunk once the free space at its end
+ * exceeds the high water mark, and is then shrunk so that the low water
+ * mark's worth of free space remains, so that alternating claims and
+ * frees don't repeatedly move flex memory.
+ *
+ * \param low_water	The free space to leave after a trim, in bytes.
+ * \param high_water	The free space which triggers a trim, in bytes.
+ */
+
+void heap_set_shrink_policy(size_t low_water, size_t high_water);
+
+
+/**
+ * Return the total number of bytes which have been returned to flex by
+ * trims since the heap was initialised.
+ *
+ * \return		The number of bytes reclaimed.
+ */
+
+size_t heap_get_reclaimed_bytes(void);
+
+
 /**
  * Change the size of a block of memory previously claimed from the heap.
  * This may result in the block moving.
@@ -103,4 +204,194 @@ char *heap_strdup(char *string);
 
 byte *heap_base(void);
 
+
+/**
+ * Create a new arena, for allocating blocks which will all be released
+ * together.  Its memory is claimed in chunks using malloc(), so that
+ * blocks allocated from it don't move.
+ *
+ * \param chunk_size	The size of chunk to claim, or 0 for the default.
+ * \return		Pointer to the new arena, or NULL on failure.
+ */
+
+struct heap_arena *heap_arena_create(size_t chunk_size);
+
+
+/**
+ * Destroy an arena, releasing all of the blocks allocated from it.
+ *
+ * \param *arena	The arena to destroy.
+ */
+
+void heap_arena_destroy(struct heap_arena *arena);
+
+
+/**
+ * Allocate a block of memory from an arena, aligned for any type.
+ *
+ * \param *arena	The arena to allocate from.
+ * \param size		The amount of memory to claim, in bytes.
+ * \return		Pointer to the claimed memory, or NULL on failure.
+ */
+
+void *heap_arena_alloc(struct heap_arena *arena, size_t size);
+
+
+/**
+ * Allocate a block of memory from an arena, with a given alignment.
+ *
+ * \param *arena	The arena to allocate from.
+ * \param size		The amount of memory to claim, in bytes.
+ * \param align		The alignment required, which must be a power of 2.
+ * \return		Pointer to the claimed memory, or NULL on failure.
+ */
+
+void *heap_arena_alloc_aligned(struct heap_arena *arena, size_t size, size_t align);
+
+
+/**
+ * Change the size of a block allocated from an arena.  The most recent
+ * block can grow in place if there is room; otherwise a new block is
+ * allocated and the contents copied.  The function's parameters match
+ * those of a string builder allocator, so that an arena can be used to
+ * back string builders.
+ *
+ * \param *arena	The arena holding the block.
+ * \param *block	The block to change, or NULL to allocate a new one.
+ * \param old_size	The current size of the block.
+ * \param new_size	The required size of the block; 0 does nothing.
+ * \return		Pointer to the block after update, or NULL.
+ */
+
+void *heap_arena_realloc(void *arena, void *block, size_t old_size, size_t new_size);
+
+
+/**
+ * Perform a strdup() on a string, using memory from an arena.
+ *
+ * \param *arena	The arena to allocate from.
+ * \param *string	Pointer to the string to be duplicated.
+ * \return		Pointer to the duplicate string, or NULL on failure.
+ */
+
+char *heap_arena_strdup(struct heap_arena *arena, char *string);
+
+
+/**
+ * Record the current state of an arena, so that any blocks allocated
+ * after this point can be released together.
+ *
+ * \param *arena	The arena to mark.
+ * \param *mark		Pointer to a mark to take the state.
+ */
+
+void heap_arena_mark(struct heap_arena *arena, struct heap_arena_mark *mark);
+
+
+/**
+ * Release all of the blocks allocated from an arena since a mark was taken.
+ * Any marks taken after this one become invalid.
+ *
+ * \param *arena	The arena to roll back.
+ * \param *mark		The mark to roll back to.
+ */
+
+void heap_arena_rollback(struct heap_arena *arena, struct heap_arena_mark *mark);
+
+
+/**
+ * Release all of the blocks allocated from an arena, keeping its memory
+ * to be re-used by future allocations.
+ *
+ * \param *arena	The arena to reset.
+ */
+
+void heap_arena_reset(struct heap_arena *arena);
+
+
+/**
+ * Initialise the heap as heap_initialise(), and enable heap debugging so
+ * that allocations are counted, and blocks claimed through the debug entry
+ * points are tracked with the source location which claimed them.
+ *
+ * \return		TRUE if the heap was initialised; else FALSE.
+ */
+
+osbool heap_debug_initialise(void);
+
+
+/**
+ * Allocate a block of memory from the heap as heap_alloc(), recording the
+ * location which claimed it if heap debugging is enabled.
+ *
+ * \param size		The amount of memory to claim, in bytes.
+ * \param *file		The source file making the claim.
+ * \param line		The source line making the claim.
+ * \return		Pointer to the claimed memory, or NULL on failure.
+ */
+
+void *heap_debug_alloc(size_t size, const char *file, int line);
+
+
+/**
+ * Change the size of a block of memory as heap_extend(), recording the
+ * location which changed it if heap debugging is enabled.
+ *
+ * \param *ptr		Pointer to the block of memory to change.
+ * \param new_size	The new size for the block.
+ * \param *file		The source file making the change.
+ * \param line		The source line making the change.
+ * \return		Pointer to the block of memory after update.
+ */
+
+void *heap_debug_extend(void *ptr, size_t new_size, const char *file, int line);
+
+
+/**
+ * Perform a strdup() on a string as heap_strdup(), recording the location
+ * which claimed it if heap debugging is enabled.
+ *
+ * \param *string	Pointer to the string to be duplicated.
+ * \param *file		The source file making the claim.
+ * \param line		The source line making the claim.
+ * \return		Pointer to the duplicate string, or NULL on failure.
+ */
+
+char *heap_debug_strdup(char *string, const char *file, int line);
+
+
+/**
+ * Collect statistics about the use of the heap.
+ *
+ * \param *statistics	Pointer to a block to take the statistics.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool heap_get_statistics(struct heap_statistics *statistics);
+
+
+/**
+ * Write the heap statistics and, if heap debugging is enabled, details of
+ * all of the tracked blocks which are still allocated to a text file.
+ *
+ * \param *filename	The name of the file to write to.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+osbool heap_dump_statistics(char *filename);
+
+
+/**
+ * If HEAP_DEBUG is defined when this header is included, the standard
+ * entry points are replaced by the debug ones, so that each claim is
+ * tagged with the location of the code which made it.
+ */
+
+#ifdef HEAP_DEBUG
+#define heap_initialise() heap_debug_initialise()
+#define heap_alloc(size) heap_debug_alloc((size), __FILE__, __LINE__)
+#define heap_extend(ptr, new_size) heap_debug_extend((ptr), (new_size), __FILE__, __LINE__)
+#define heap_strdup(string) heap_debug_strdup((string), __FILE__, __LINE__)
+#endif
+
 #endif
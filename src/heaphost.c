@@ -0,0 +1,524 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: heaphost.c
+ *
+ * Host implementations of the flex and OS_Heap calls used by the heap.
+ * This file is only built for the host, with SFLIB_HOST defined.
+ */
+
+/* ANSII C header files. */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX header files. */
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* SF-Lib header files. */
+
+#include "heaphost.h"
+#include "debug.h"
+
+
+#define HEAPHOST_RESERVE (256 * 1024 * 1024)					/**< The address space reserved for the flex block.			*/
+#define HEAPHOST_MAGIC 0x70616548						/**< The word identifying an emulated heap ("Heap").		*/
+#define HEAPHOST_ALIGN 8							/**< The granularity of blocks within an emulated heap.		*/
+
+/**
+ * The header at the base of an emulated OS_Heap heap.  All of the values
+ * are offsets from the heap base, so that the heap could move.
+ */
+
+struct heaphost_header {
+	int	magic;									/**< The word identifying the heap.				*/
+	int	free;									/**< The first free block, or 0 if there are none.		*/
+	int	top;									/**< The end of the blocks claimed from the heap.		*/
+	int	size;									/**< The size of the heap.					*/
+};
+
+/**
+ * A free block in an emulated heap.  Claimed blocks keep the size word,
+ * with the client's memory following it; this keeps the client's memory
+ * offset by one word from the heap granularity, as with OS_Heap.
+ */
+
+struct heaphost_free {
+	int	size;									/**< The size of the block, including this header.		*/
+	int	next;									/**< The next free block, or 0 if this is the last.		*/
+};
+
+/**
+ * The base of the emulated flex block, or NULL if it hasn't been claimed.
+ */
+
+static byte	*heaphost_region = NULL;
+
+/**
+ * The amount of the emulated flex block which is accessible.
+ */
+
+static size_t	heaphost_committed = 0;
+
+/**
+ * The error block returned by failing heap operations.
+ */
+
+static os_error	heaphost_error;
+
+
+/* Static Function Prototypes. */
+
+static os_error *heaphost_make_error(char *message);
+static size_t heaphost_round_page(size_t size);
+
+
+/* Claim the emulated flex block.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+int flex_alloc(flex_ptr anchor, int size)
+{
+	void	*region;
+
+	if (heaphost_region != NULL || size < 0 || size > HEAPHOST_RESERVE)
+		return 0;
+
+	/* Reserve address space for the largest possible block, so that the
+	 * block can grow without moving.
+	 */
+
+	region = mmap(NULL, HEAPHOST_RESERVE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (region == MAP_FAILED)
+		return 0;
+
+	heaphost_region = region;
+	heaphost_committed = 0;
+
+	if (!flex_extend((flex_ptr) &region, size)) {
+		munmap(heaphost_region, HEAPHOST_RESERVE);
+		heaphost_region = NULL;
+		return 0;
+	}
+
+	*anchor = heaphost_region;
+
+	return 1;
+}
+
+
+/* Change the size of the emulated flex block.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+int flex_extend(flex_ptr anchor, int size)
+{
+	size_t	required;
+
+	if (heaphost_region == NULL || *anchor != heaphost_region || size < 0 || size > HEAPHOST_RESERVE)
+		return 0;
+
+	required = heaphost_round_page(size);
+
+	if (required > heaphost_committed) {
+		if (mprotect(heaphost_region + heaphost_committed, required - heaphost_committed, PROT_READ | PROT_WRITE) != 0)
+			return 0;
+	} else if (required < heaphost_committed) {
+		madvise(heaphost_region + required, heaphost_committed - required, MADV_DONTNEED);
+		mprotect(heaphost_region + required, heaphost_committed - required, PROT_NONE);
+	}
+
+	heaphost_committed = required;
+
+	return 1;
+}
+
+
+/* Initialise an emulated OS_Heap heap.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+os_error *xosheap_initialise(byte *heap, int size)
+{
+	struct heaphost_header	*header = (struct heaphost_header *) heap;
+
+	if (size < (int) sizeof(struct heaphost_header))
+		return heaphost_make_error("Heap too small");
+
+	header->magic = HEAPHOST_MAGIC;
+	header->free = 0;
+	header->top = sizeof(struct heaphost_header);
+	header->size = size;
+
+	return NULL;
+}
+
+
+/* Claim a block from an emulated OS_Heap heap.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+os_error *xosheap_alloc(byte *heap, int size, void **block)
+{
+	struct heaphost_header	*header = (struct heaphost_header *) heap;
+	struct heaphost_free	*free, *rest;
+	int			required, *link, offset;
+
+	if (header->magic != HEAPHOST_MAGIC)
+		return heaphost_make_error("Bad heap");
+
+	if (size <= 0)
+		return heaphost_make_error("Bad size");
+
+	required = (size + sizeof(int) + HEAPHOST_ALIGN - 1) & ~(HEAPHOST_ALIGN - 1);
+
+	/* Take the first free block which is big enough, splitting it if
+	 * there's space left over.
+	 */
+
+	for (link = &header->free; *link != 0; link = &free->next) {
+		free = (struct heaphost_free *) (heap + *link);
+
+		if (free->size < required)
+			continue;
+
+		offset = *link;
+
+		if (free->size - required >= (int) sizeof(struct heaphost_free)) {
+			rest = (struct heaphost_free *) (heap + offset + required);
+			rest->size = free->size - required;
+			rest->next = free->next;
+			*link = offset + required;
+			free->size = required;
+		} else {
+			*link = free->next;
+		}
+
+		*block = heap + offset + sizeof(int);
+
+		return NULL;
+	}
+
+	/* Otherwise claim the block from the unused space at the top. */
+
+	if (header->size - header->top < required)
+		return heaphost_make_error("Heap full");
+
+	offset = header->top;
+	header->top += required;
+
+	*(int *) (heap + offset) = required;
+	*block = heap + offset + sizeof(int);
+
+	return NULL;
+}
+
+
+/* Free a block in an emulated OS_Heap heap.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+void osheap_free(byte *heap, void *block)
+{
+	struct heaphost_header	*header = (struct heaphost_header *) heap;
+	struct heaphost_free	*free, *previous = NULL, *next;
+	int			offset, *link;
+
+	offset = (byte *) block - sizeof(int) - heap;
+
+	if (header->magic != HEAPHOST_MAGIC || offset < (int) sizeof(struct heaphost_header) || offset >= header->top) {
+		error_report_program(heaphost_make_error("Not a heap block"));
+		return;
+	}
+
+	free = (struct heaphost_free *) (heap + offset);
+
+	/* Insert the block into the address-ordered free list. */
+
+	for (link = &header->free; *link != 0 && *link < offset; link = &previous->next)
+		previous = (struct heaphost_free *) (heap + *link);
+
+	free->next = *link;
+	*link = offset;
+
+	/* Merge it with the following block, and then the preceding one. */
+
+	if (free->next != 0 && offset + free->size == free->next) {
+		next = (struct heaphost_free *) (heap + free->next);
+		free->size += next->size;
+		free->next = next->next;
+	}
+
+	if (previous != NULL && (byte *) previous + previous->size == (byte *) free) {
+		previous->size += free->size;
+		previous->next = free->next;
+		free = previous;
+		offset = (byte *) previous - heap;
+	}
+
+	/* If the block is now the last before the top, return it to the
+	 * unused space.
+	 */
+
+	if (offset + free->size == header->top && free->next == 0) {
+		for (link = &header->free; *link != offset; link = &((struct heaphost_free *) (heap + *link))->next)
+			;
+
+		*link = 0;
+		header->top = offset;
+	}
+}
+
+
+/* Change the size of a block in an emulated OS_Heap heap.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+os_error *xosheap_realloc(byte *heap, void *block, int change, void **new_block)
+{
+	os_error	*error;
+	int		size, required, *tail;
+
+	size = *((int *) block - 1) - sizeof(int);
+
+	/* Blocks which are shrinking stay where they are, with any space
+	 * which is no longer needed being split off and freed.
+	 */
+
+	if (change <= 0) {
+		required = (size + change + sizeof(int) + HEAPHOST_ALIGN - 1) & ~(HEAPHOST_ALIGN - 1);
+
+		if (required < (int) sizeof(struct heaphost_free))
+			required = sizeof(struct heaphost_free);
+
+		if (required < size + (int) sizeof(int)) {
+			tail = (int *) ((byte *) block - sizeof(int) + required);
+			*tail = size + sizeof(int) - required;
+			*((int *) block - 1) = required;
+			osheap_free(heap, tail + 1);
+		}
+
+		*new_block = block;
+		return NULL;
+	}
+
+	error = xosheap_alloc(heap, size + change, new_block);
+	if (error != NULL)
+		return error;
+
+	memcpy(*new_block, block, size);
+	osheap_free(heap, block);
+
+	return NULL;
+}
+
+
+/* Change the size of an emulated OS_Heap heap.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+void osheap_resize(byte *heap, int change)
+{
+	struct heaphost_header	*header = (struct heaphost_header *) heap;
+
+	if (header->size + change < header->top) {
+		error_report_program(heaphost_make_error("Heap can't be shrunk"));
+		return;
+	}
+
+	header->size += change;
+}
+
+
+/* Change the size of an emulated OS_Heap heap, shrinking it as far as
+ * possible if required.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+int osheap_resize_no_fail(byte *heap, int change)
+{
+	struct heaphost_header	*header = (struct heaphost_header *) heap;
+
+	if (header->size + change < header->top)
+		change = header->top - header->size;
+
+	header->size += change;
+
+	return change;
+}
+
+
+/* Describe the free space in an emulated OS_Heap heap.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+os_error *xosheap_describe(byte *heap, int *largest, int *total)
+{
+	struct heaphost_header	*header = (struct heaphost_header *) heap;
+	struct heaphost_free	*free;
+	int			offset;
+
+	if (header->magic != HEAPHOST_MAGIC)
+		return heaphost_make_error("Bad heap");
+
+	*largest = header->size - header->top;
+	*total = *largest;
+
+	for (offset = header->free; offset != 0; offset = free->next) {
+		free = (struct heaphost_free *) (heap + offset);
+
+		*total += free->size;
+
+		if (free->size > *largest)
+			*largest = free->size;
+	}
+
+	return NULL;
+}
+
+
+/* Report a program error on stderr.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+void error_report_program(os_error *error)
+{
+	if (error != NULL)
+		fprintf(stderr, "Program error: %s\n", error->errmess);
+}
+
+
+/* Host builds can't schedule callbacks.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+osbool event_add_single_callback(wimp_w w, os_t delay, osbool (*callback)(os_t time, void *data), void *data)
+{
+	(void) w;
+	(void) delay;
+	(void) callback;
+	(void) data;
+
+	return FALSE;
+}
+
+
+/* Host builds have no callbacks to delete.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+void event_delete_callback(osbool (*callback)(os_t time, void *data))
+{
+	(void) callback;
+}
+
+
+/* Read the time since the host started, in centiseconds.
+ *
+ * This is an external interface, documented in heaphost.h
+ */
+
+os_error *xos_read_monotonic_time(os_t *t)
+{
+	static os_error	error = {0, "Unable to read clock"};
+	struct timespec	now;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+		return &error;
+
+	/* Wrap the time at 32 bits, as the RISC OS monotonic timer does. */
+
+	*t = (os_t) (unsigned int) ((unsigned long) now.tv_sec * 100 + (unsigned long) now.tv_nsec / 10000000);
+
+	return NULL;
+}
+
+
+/* Print a string to stderr, in place of Reporter.
+ *
+ * This is an external interface, documented in debug.h
+ */
+
+int debug_printf(char *cntrl_string, ...)
+{
+	va_list		ap;
+	int		written;
+
+	va_start(ap, cntrl_string);
+	written = vfprintf(stderr, cntrl_string, ap);
+	va_end(ap);
+
+	fputc('\n', stderr);
+
+	return written;
+}
+
+
+/**
+ * Fill in the error block.
+ *
+ * \param *message		The error message.
+ * \return			Pointer to the error block.
+ */
+
+static os_error *heaphost_make_error(char *message)
+{
+	heaphost_error.errnum = 0;
+	strncpy(heaphost_error.errmess, message, sizeof(heaphost_error.errmess));
+	heaphost_error.errmess[sizeof(heaphost_error.errmess) - 1] = '\0';
+
+	return &heaphost_error;
+}
+
+
+/**
+ * Round a size up to a whole number of pages.
+ *
+ * \param size			The size to round.
+ * \return			The rounded size.
+ */
+
+static size_t heaphost_round_page(size_t size)
+{
+	size_t	page = sysconf(_SC_PAGESIZE);
+
+	return (size + page - 1) & ~(page - 1);
+}
+
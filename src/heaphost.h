@@ -0,0 +1,217 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: heaphost.h
+ *
+ * Host implementations of the flex and OS_Heap calls used by the heap, so
+ * that code which allocates through heap_alloc() can be built, tested and
+ * profiled on other platforms.  The flex block is emulated by a region of
+ * address space reserved with mmap(), which grows in place, and OS_Heap by
+ * a first-fit allocator working to the same rules.
+ *
+ * This header is only used when SFLIB_HOST is defined, and provides the
+ * small subset of OSLib and SFLib on which the heap depends.
+ */
+
+#ifndef SFLIB_HEAPHOST
+#define SFLIB_HEAPHOST
+
+#include "heap.h"
+
+/**
+ * A host error block, laid out as OSLib's os_error.
+ */
+
+typedef struct {
+	int			errnum;					/**< The error number.					*/
+	char			errmess[252];				/**< The error message.					*/
+} os_error;
+
+/**
+ * A host time, in centiseconds.  As in OSLib, this is signed, so that times
+ * are compared by subtracting them and testing the sign of the result.
+ */
+
+typedef int os_t;
+
+/**
+ * A host window handle.
+ */
+
+typedef struct wimp_w_ *wimp_w;
+
+/**
+ * A host flex anchor.
+ */
+
+typedef void **flex_ptr;
+
+
+/**
+ * Claim the emulated flex block.  Only one block is supported, and it never
+ * moves.
+ *
+ * \param anchor		The anchor to take the block's address.
+ * \param size			The size of the block.
+ * \return			1 if successful; else 0.
+ */
+
+int flex_alloc(flex_ptr anchor, int size);
+
+
+/**
+ * Change the size of the emulated flex block.
+ *
+ * \param anchor		The anchor of the block.
+ * \param size			The new size of the block.
+ * \return			1 if successful; else 0.
+ */
+
+int flex_extend(flex_ptr anchor, int size);
+
+
+/**
+ * Initialise an emulated OS_Heap heap.
+ *
+ * \param *heap			The base of the heap.
+ * \param size			The size of the heap.
+ * \return			Pointer to an error block, or NULL.
+ */
+
+os_error *xosheap_initialise(byte *heap, int size);
+
+
+/**
+ * Claim a block from an emulated OS_Heap heap.
+ *
+ * \param *heap			The base of the heap.
+ * \param size			The size of block to claim.
+ * \param **block		Pointer to a variable to take the block.
+ * \return			Pointer to an error block, or NULL.
+ */
+
+os_error *xosheap_alloc(byte *heap, int size, void **block);
+
+
+/**
+ * Free a block in an emulated OS_Heap heap.
+ *
+ * \param *heap			The base of the heap.
+ * \param *block		The block to free.
+ */
+
+void osheap_free(byte *heap, void *block);
+
+
+/**
+ * Change the size of a block in an emulated OS_Heap heap.
+ *
+ * \param *heap			The base of the heap.
+ * \param *block		The block to change.
+ * \param change		The change in size.
+ * \param **new_block		Pointer to a variable to take the block.
+ * \return			Pointer to an error block, or NULL.
+ */
+
+os_error *xosheap_realloc(byte *heap, void *block, int change, void **new_block);
+
+
+/**
+ * Change the size of an emulated OS_Heap heap, reporting an error if it
+ * can't be changed by the amount requested.
+ *
+ * \param *heap			The base of the heap.
+ * \param change		The change in size.
+ */
+
+void osheap_resize(byte *heap, int change);
+
+
+/**
+ * Change the size of an emulated OS_Heap heap, shrinking it as far as
+ * possible if it can't be shrunk by the amount requested.
+ *
+ * \param *heap			The base of the heap.
+ * \param change		The requested change in size.
+ * \return			The actual change in size.
+ */
+
+int osheap_resize_no_fail(byte *heap, int change);
+
+
+/**
+ * Describe the free space in an emulated OS_Heap heap.
+ *
+ * \param *heap			The base of the heap.
+ * \param *largest		Pointer to a variable to take the largest free block.
+ * \param *total		Pointer to a variable to take the total free space.
+ * \return			Pointer to an error block, or NULL.
+ */
+
+os_error *xosheap_describe(byte *heap, int *largest, int *total);
+
+
+/**
+ * Report a program error on stderr.
+ *
+ * \param *error		The error to report.
+ */
+
+void error_report_program(os_error *error);
+
+
+/**
+ * Host builds have no event loop, so callbacks can't be scheduled and the
+ * heap falls back to acting immediately.
+ *
+ * \param w			Unused.
+ * \param delay			Unused.
+ * \param *callback		Unused.
+ * \param *data			Unused.
+ * \return			FALSE.
+ */
+
+osbool event_add_single_callback(wimp_w w, os_t delay, osbool (*callback)(os_t time, void *data), void *data);
+
+
+/**
+ * Delete all references to a callback; host builds have none.
+ *
+ * \param *callback		Unused.
+ */
+
+void event_delete_callback(osbool (*callback)(os_t time, void *data));
+
+
+/**
+ * Read the time since the host started, in centiseconds.
+ *
+ * \param *t			Pointer to a variable to take the time.
+ * \return			NULL on success, or a pointer to an error block.
+ */
+
+os_error *xos_read_monotonic_time(os_t *t);
+
+#endif
+
@@ -332,6 +332,7 @@ static osbool ihelp_send_reply_help_request(wimp_message *message)
 static char *ihelp_get_text(char *buffer, size_t length, wimp_w window, wimp_i icon, os_coord pos, wimp_mouse_state buttons)
 {
 	char			help_text[IHELP_LENGTH], token[TOKEN_LENGTH], icon_name[IHELP_INAME_LEN];
+	struct string_builder	name, builder;
 	struct ihelp_window	*window_data;
 	struct ihelp_menu	*menu_data;
 	wimp_menu		*current_menu;
@@ -365,21 +366,35 @@ static char *ihelp_get_text(char *buffer, size_t length, wimp_w window, wimp_i i
 		 * If the icon isn't validated, make a string of the form IconX where X is the number.
 		 */
 
-		if (*icon_name == '\0' && icon >= 0 && !icons_get_validation_command(icon_name, IHELP_INAME_LEN, window, icon, 'N'))
-			string_printf(icon_name, IHELP_INAME_LEN, "Icon%d", icon);
+		if (*icon_name == '\0' && icon >= 0 && !icons_get_validation_command(icon_name, IHELP_INAME_LEN, window, icon, 'N')) {
+			string_builder_init(&name, icon_name, IHELP_INAME_LEN);
+			string_builder_append(&name, "Icon");
+			string_builder_append_int(&name, icon);
+		}
+
+		/* Build the window part of the token, which is shared by both lookups. */
+
+		string_builder_init(&builder, token, TOKEN_LENGTH);
+		string_builder_append_strings(&builder, "Help.", window_data->name, window_data->modifier, NULL);
 
 		/* If an icon name was found from somewhere, look up a token based on that name. */
 
 		if (*icon_name != '\0') {
-			string_printf(token, TOKEN_LENGTH, "Help.%s%s.%s", window_data->name, window_data->modifier, icon_name);
-			found = msgs_lookup_result(token, help_text, IHELP_LENGTH);
+			string_builder_append_char(&builder, '.');
+			string_builder_append(&builder, icon_name);
+
+			if (!builder.truncated)
+				found = msgs_lookup_result(token, help_text, IHELP_LENGTH);
 		}
 
 		/* If the icon did not have a name, or it is the window background, look up a token for the window. */
 
 		if (!found) {
-			string_printf(token, TOKEN_LENGTH, "Help.%s%s", window_data->name, window_data->modifier);
-			found = msgs_lookup_result(token, help_text, IHELP_LENGTH);
+			string_builder_reset(&builder);
+			string_builder_append_strings(&builder, "Help.", window_data->name, window_data->modifier, NULL);
+
+			if (!builder.truncated)
+				found = msgs_lookup_result(token, help_text, IHELP_LENGTH);
 		}
 
 		/* If a message was found, return it. */
@@ -398,14 +413,13 @@ static char *ihelp_get_text(char *buffer, size_t length, wimp_w window, wimp_i i
 			menu_data = ihelp_find_menu(current_menu);
 
 			if (menu_data != NULL || *default_menu_help_token != '\0') {
-				string_printf(token, TOKEN_LENGTH, "Help.%s.", (menu_data == NULL) ? default_menu_help_token : menu_data->name);
+				string_builder_init(&builder, token, TOKEN_LENGTH);
+				string_builder_append_strings(&builder, "Help.", (menu_data == NULL) ? default_menu_help_token : menu_data->name, ".", NULL);
 
-				for (i=0; menu_selection.items[i] != -1; i++) {
-					string_printf(icon_name, IHELP_INAME_LEN, "%02x", menu_selection.items[i]);
-					strncat(token, icon_name, TOKEN_LENGTH - (strlen(icon_name) + 1));
-				}
+				for (i=0; menu_selection.items[i] != -1; i++)
+					string_builder_append_hex(&builder, menu_selection.items[i], 2, FALSE);
 
-				if (msgs_lookup_result(token, help_text, IHELP_LENGTH))
+				if (!builder.truncated && msgs_lookup_result(token, help_text, IHELP_LENGTH))
 					string_copy(buffer, help_text, length);
 			}
 		}
@@ -39,6 +39,7 @@
 #include "menus.h"
 #include "windows.h"
 #include "string.h"
+#include "strdup.h"
 
 /* ANSII C header files. */
 
@@ -56,6 +57,12 @@
 #define MENU_HEADER_END_OFFSET (6)
 #define MENU_LEGACY_HEADER_END_OFFSET (2)
 
+/* Once a block is loaded, the indirected data list offset is no longer
+ * needed, and is re-used to hold the offset to the block's index.
+ */
+
+#define MENU_INDEX_OFFSET (1)
+
 /* Offset from last header word to first menu block. */
 
 #define MENU_FIRST_BLOCK_OFFSET (3)
@@ -92,6 +99,85 @@
 #define MENU_END_OF_LIST (-1)
 #define MENU_WORD_LENGTH (4)
 
+/**
+ * The maximum depth of the page tree in a virtual menu.
+ */
+
+#define MENUS_VIRTUAL_MAX_DEPTH 8
+
+/**
+ * The size of the buffer used to hold the label of a range entry.
+ */
+
+#define MENUS_VIRTUAL_LABEL_LENGTH 64
+
+/**
+ * An index of the named menus and dialogue box tags in a menu template
+ * block, so that they can be found without scanning the lists in the
+ * file.  The index is held in the same block of memory, after the template
+ * data, so that it is released when the block is freed.  It is followed by
+ * the sorted entries for the menu names, and then those for the dialogue
+ * tags.
+ */
+
+struct menus_template_index {
+	size_t				names;				/**< The number of menu name entries.			*/
+	size_t				dialogues;			/**< The number of dialogue tag entries.		*/
+};
+
+/**
+ * An entry in the index of a menu template block.
+ */
+
+struct menus_template_entry {
+	char				*tag;				/**< The menu name or dialogue tag.			*/
+	void				*block;				/**< The menu block, or the dialogue tag block.		*/
+};
+
+/**
+ * A level in the page tree of a virtual menu, holding the page which is
+ * currently open at that depth.
+ */
+
+struct menus_virtual_level {
+	wimp_menu			*menu;				/**< The page open at this level, or NULL.		*/
+	size_t				first;				/**< The first logical entry covered by the page.	*/
+	size_t				span;				/**< The logical entries covered by each page entry.	*/
+	int				parent_entry;			/**< The entry in the parent page leading to the page.	*/
+};
+
+/**
+ * A virtual menu.
+ */
+
+struct menus_virtual {
+	char				*title;				/**< The title of the menu pages.			*/
+	size_t				entries;			/**< The number of entries in the logical list.		*/
+	size_t				page_size;			/**< The maximum number of entries on a page.		*/
+	int				depth;				/**< The number of levels in the page tree.		*/
+
+	char				*(*text)(size_t index, void *data);	/**< Callback to return the text of an entry.	*/
+	void				*data;				/**< Data to pass to the text callback.			*/
+
+	struct menus_virtual_level	level[MENUS_VIRTUAL_MAX_DEPTH];	/**< The pages open at each level of the tree.		*/
+};
+
+
+/* Static Function Prototypes. */
+
+static int *menus_find_names_list(menu_template data);
+static int *menus_find_dialogue_list(menu_template data);
+static size_t menus_count_template_list(int *current);
+static void menus_build_template_index(menu_template data, int offset);
+static size_t menus_fill_template_index(struct menus_template_entry *entries, int *current, menu_template data);
+static int menus_compare_template_entries(const void *a, const void *b);
+static int menus_compare_template_tag(const void *tag, const void *entry);
+static struct menus_template_index *menus_get_template_index(menu_template data);
+static int *menus_find_dialogue_block(menu_template data, char *tag);
+static wimp_menu *menus_virtual_build_page(struct menus_virtual *virtual, size_t first, size_t span);
+static char *menus_virtual_get_label(struct menus_virtual *virtual, size_t first, size_t span, char *buffer, size_t length);
+static void menus_virtual_free_pages(struct menus_virtual *virtual, int level);
+
 
 /* Load a menu template block into memory, optionally linking in dialogue
  * boxes and returning the menu block addresses in the supplied array.
@@ -101,9 +187,10 @@
 
 menu_template menus_load_templates(char *filename, wimp_w dbox_list[], wimp_menu *menus[], size_t len)
 {
-	int			*current, *data, dbox, menu, *menu_block;
+	int			*current, *data, *extended, dbox, menu, *menu_block;
 	int			*submenu, *next_submenu;
-	int			size;
+	int			size, index_offset;
+	size_t			entries;
 	fileswitch_object_type	type;
 	os_error		*error;
 
@@ -127,6 +214,27 @@ menu_template menus_load_templates(char *filename, wimp_w dbox_list[], wimp_menu
 		return NULL;
 	}
 
+	/* Make room after the template data for an index of the menu names and
+	 * dialogue tags.  This must be done before any pointers are inserted,
+	 * as the block may move.  If there's no memory, lookups scan the lists
+	 * in the file instead.
+	 */
+
+	index_offset = MENU_END_OF_LIST;
+
+	entries = menus_count_template_list(menus_find_names_list(data)) +
+			menus_count_template_list(menus_find_dialogue_list(data));
+
+	if (entries > 0) {
+		extended = realloc(data, ((size + 7) & ~7) + sizeof(struct menus_template_index) +
+				entries * sizeof(struct menus_template_entry));
+
+		if (extended != NULL) {
+			data = extended;
+			index_offset = (size + 7) & ~7;
+		}
+	}
+
 	/* Insert the dialogue box pointers.
 	 *
 	 * These are linked through the structure with each pointer containing an offset to the next pointer
@@ -238,6 +346,10 @@ menu_template menus_load_templates(char *filename, wimp_w dbox_list[], wimp_menu
 			menu_block = (int*) ((int) menu_block + (int) data);
 	}
 
+	/* Index the menu names and dialogue tags, for fast lookups later. */
+
+	menus_build_template_index(data, index_offset);
+
 	return data;
 }
 
@@ -254,24 +366,8 @@ osbool menus_link_dbox(menu_template data, char *tag, wimp_w dbox)
 	if (data == NULL || tag == NULL)
 		return FALSE;
 
-	if (*(data + MENU_DIALOGUE_LIST_OFFSET) == MENU_END_OF_LIST)
-		return FALSE;
-
-	current = (int *) ((int) data + (int) *(data + MENU_DIALOGUE_LIST_OFFSET));
-
-	if (*current != MENU_ZERO_WORD)
-		return FALSE;
-
-	current++; /* Find the first tag block */
-
-	/* Find the correct dbox list by string matching the tags. */
-
-	while (*current != -1 && strcmp((char *) (current + MENU_DIALOGUE_TEXT), tag) != 0) {
-		current = (int *) ((int) current +
-				((strlen((char *) (current + MENU_DIALOGUE_TEXT)) + 8) & (~3)));
-	}
-
-	if (*current == MENU_END_OF_LIST)
+	current = menus_find_dialogue_block(data, tag);
+	if (current == NULL)
 		return FALSE;
 
 	current = (int *) ((int) data + (int) *(current + MENU_DIALOGUE_OFFSET));
@@ -296,15 +392,25 @@ osbool menus_link_dbox(menu_template data, char *tag, wimp_w dbox)
 
 wimp_menu *menus_get_menu(menu_template data, char *tag)
 {
-	int *current;
+	int				*current;
+	struct menus_template_index	*index;
+	struct menus_template_entry	*entry;
 
 	if (data == NULL || tag == NULL)
 		return NULL;
 
-	if (*(data + MENU_EXTENDED_HEADER_OFFSET) != MENU_ZERO_WORD || *(data + MENU_NAMES_LIST_OFFSET) == MENU_END_OF_LIST)
+	current = menus_find_names_list(data);
+	if (current == NULL)
 		return NULL;
 
-	current = (int *) ((int) data + (int) *(data + MENU_NAMES_LIST_OFFSET));
+	/* Use the index if there is one; otherwise scan the list in the file. */
+
+	index = menus_get_template_index(data);
+
+	if (index != NULL) {
+		entry = bsearch(tag, index + 1, index->names, sizeof(struct menus_template_entry), menus_compare_template_tag);
+		return (entry != NULL) ? entry->block : NULL;
+	}
 
 	/* Find the correct menu offset by string matching the tags. */
 
@@ -469,6 +575,593 @@ void menus_build_entry(wimp_menu *menu, int entry, char *text, size_t text_lengt
 }
 
 
+/* Fill a run of entries in an existing menu from a block of messages.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+size_t menus_build_block_entries(wimp_menu *menu, int first, struct msgs_block *block)
+{
+	wimp_menu_entry	*definition = NULL;
+	char		*text;
+	size_t		filled = 0, len;
+	int		width;
+
+	if (menu == NULL || block == NULL || first < 0)
+		return 0;
+
+	/* Find the first menu definition that we're to update. */
+
+	definition = menu->entries;
+
+	while (first > 0) {
+		if (definition->menu_flags & wimp_MENU_LAST)
+			return 0;
+
+		first--;
+		definition++;
+	}
+
+	/* Fill the entries, pointing long ones into the message block.  The
+	 * entries may have been used before, so short texts must also clear
+	 * any existing indirection.
+	 */
+
+	while (filled < block->count) {
+		text = block->text + block->offsets[filled];
+		len = block->offsets[filled + 1] - block->offsets[filled] - 1;
+
+		if (len > 12) {
+			definition->data.indirected_text.text = text;
+			definition->data.indirected_text.validation = "";
+			definition->data.indirected_text.size = len + 1;
+			definition->icon_flags |= wimp_ICON_INDIRECTED;
+		} else {
+			strncpy(definition->data.text, text, 12);
+			definition->icon_flags &= ~wimp_ICON_INDIRECTED;
+		}
+
+		width = (16 * len) + 16;
+		if (width > menu->width)
+			menu->width = width;
+
+		filled++;
+
+		if (definition->menu_flags & wimp_MENU_LAST)
+			break;
+
+		definition++;
+	}
+
+	return filled;
+}
+
+
+/* Create a new menu in memory, with one entry for each message in a block.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+wimp_menu *menus_build_block_menu(char *title, osbool external_title, struct msgs_block *block)
+{
+	wimp_menu	*menu;
+
+	if (block == NULL)
+		return NULL;
+
+	menu = menus_build_menu(title, external_title, block->count);
+	if (menu == NULL)
+		return NULL;
+
+	menus_build_block_entries(menu, 0, block);
+
+	return menu;
+}
+
+
+/* Return the text space required by a menu entry in a builder.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+size_t menus_builder_measure(char *text)
+{
+	size_t	len;
+
+	if (text == NULL)
+		return 0;
+
+	len = strlen(text);
+
+	return (len > 12) ? len + 1 : 0;
+}
+
+
+/* Start to assemble a new menu in a single block of memory.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+wimp_menu *menus_builder_begin(struct menus_builder *builder, char *title, size_t entries, size_t text_size)
+{
+	wimp_menu	*menu;
+	size_t		title_size, size;
+
+	if (builder == NULL)
+		return NULL;
+
+	builder->menu = NULL;
+	builder->entries = 0;
+	builder->count = 0;
+	builder->text = NULL;
+	builder->text_end = NULL;
+
+	if (title == NULL || entries < 1)
+		return NULL;
+
+	/* Allocate the menu definition block, with the text following on
+	 * after the last entry.
+	 */
+
+	title_size = menus_builder_measure(title);
+	size = wimp_SIZEOF_MENU(entries) + title_size + text_size;
+
+	menu = malloc(size);
+	if (menu == NULL)
+		return NULL;
+
+	builder->menu = menu;
+	builder->entries = entries;
+	builder->text = (char *) menu + wimp_SIZEOF_MENU(entries);
+	builder->text_end = (char *) menu + size;
+
+	/* Set up the menu title. */
+
+	if (title_size > 0) {
+		memcpy(builder->text, title, title_size);
+		menu->title_data.indirected_text.text = builder->text;
+		builder->text += title_size;
+		menu->entries[0].menu_flags = wimp_MENU_TITLE_INDIRECTED;
+	} else {
+		strncpy(menu->title_data.text, title, 12);
+		menu->entries[0].menu_flags = 0;
+	}
+
+	/* Set up the remainder of the menu header. */
+
+	menu->title_fg = wimp_COLOUR_BLACK;
+	menu->title_bg = wimp_COLOUR_LIGHT_GREY;
+	menu->work_fg = wimp_COLOUR_BLACK;
+	menu->work_bg = wimp_COLOUR_WHITE;
+	menu->width = (16 * strlen(title)) + 16;
+	menu->height = wimp_MENU_ITEM_HEIGHT;
+	menu->gap = wimp_MENU_ITEM_GAP;
+
+	return menu;
+}
+
+
+/* Append an entry to the end of a menu being assembled by a builder.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+int menus_builder_append(struct menus_builder *builder, char *text, enum menus_separator separator, wimp_menu *sub_menu)
+{
+	wimp_menu_entry	*entry;
+	size_t		len;
+	int		width;
+
+	if (builder == NULL || builder->menu == NULL || text == NULL || builder->count >= builder->entries)
+		return -1;
+
+	len = strlen(text);
+	if (len > 12 && (size_t) (builder->text_end - builder->text) < len + 1)
+		return -1;
+
+	entry = builder->menu->entries + builder->count;
+
+	/* The first entry carries the title indirection flag. */
+
+	if (builder->count > 0)
+		entry->menu_flags = 0;
+	else
+		entry->menu_flags &= wimp_MENU_TITLE_INDIRECTED;
+
+	entry->sub_menu = sub_menu;
+	entry->icon_flags = wimp_ICON_TEXT | wimp_ICON_FILLED |
+			(wimp_COLOUR_BLACK << wimp_ICON_FG_COLOUR_SHIFT) |
+			(wimp_COLOUR_WHITE << wimp_ICON_BG_COLOUR_SHIFT);
+
+	/* Set up the menu text, copying long entries into the text area. */
+
+	if (len > 12) {
+		memcpy(builder->text, text, len + 1);
+		entry->data.indirected_text.text = builder->text;
+		entry->data.indirected_text.validation = "";
+		entry->data.indirected_text.size = len + 1;
+		entry->icon_flags |= wimp_ICON_INDIRECTED;
+		builder->text += len + 1;
+	} else {
+		strncpy(entry->data.text, text, 12);
+	}
+
+	if (separator == MENUS_SEPARATOR_THIS)
+		entry->menu_flags |= wimp_MENU_SEPARATE;
+	else if (separator == MENUS_SEPARATOR_PREVIOUS && builder->count > 0)
+		(entry - 1)->menu_flags |= wimp_MENU_SEPARATE;
+
+	/* Recalculate the menu width. */
+
+	width = (16 * len) + 16;
+	if (width > builder->menu->width)
+		builder->menu->width = width;
+
+	return builder->count++;
+}
+
+
+/* Complete a menu assembled by a builder.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+wimp_menu *menus_builder_finish(struct menus_builder *builder)
+{
+	wimp_menu	*menu;
+
+	if (builder == NULL || builder->menu == NULL)
+		return NULL;
+
+	menu = builder->menu;
+	builder->menu = NULL;
+
+	if (builder->count == 0) {
+		free(menu);
+		return NULL;
+	}
+
+	menu->entries[builder->count - 1].menu_flags |= wimp_MENU_LAST;
+
+	return menu;
+}
+
+
+/* Create a new virtual menu.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+struct menus_virtual *menus_virtual_create(char *title, size_t entries, size_t page_size, char *(*text)(size_t index, void *data), void *data)
+{
+	struct menus_virtual	*virtual;
+	size_t			remaining, span;
+	int			level;
+
+	if (title == NULL || text == NULL || entries < 1 || page_size < 2)
+		return NULL;
+
+	virtual = malloc(sizeof(struct menus_virtual));
+	if (virtual == NULL)
+		return NULL;
+
+	virtual->title = strdup(title);
+	virtual->entries = entries;
+	virtual->page_size = page_size;
+	virtual->text = text;
+	virtual->data = data;
+
+	/* Find the depth of tree required to give every entry a place. */
+
+	virtual->depth = 1;
+
+	for (remaining = entries - 1; remaining >= page_size; remaining /= page_size)
+		virtual->depth++;
+
+	if (virtual->title == NULL || virtual->depth > MENUS_VIRTUAL_MAX_DEPTH) {
+		free(virtual->title);
+		free(virtual);
+		return NULL;
+	}
+
+	/* Set up the levels, with the leaf pages holding single entries. */
+
+	span = 1;
+
+	for (level = virtual->depth - 1; level >= 0; level--) {
+		virtual->level[level].menu = NULL;
+		virtual->level[level].first = 0;
+		virtual->level[level].span = span;
+		virtual->level[level].parent_entry = -1;
+
+		span *= page_size;
+	}
+
+	/* Build the root page. */
+
+	virtual->level[0].menu = menus_virtual_build_page(virtual, 0, virtual->level[0].span);
+
+	if (virtual->level[0].menu == NULL) {
+		free(virtual->title);
+		free(virtual);
+		return NULL;
+	}
+
+	return virtual;
+}
+
+
+/* Destroy a virtual menu.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+void menus_virtual_destroy(struct menus_virtual *virtual)
+{
+	if (virtual == NULL)
+		return;
+
+	menus_virtual_free_pages(virtual, 0);
+
+	free(virtual->title);
+	free(virtual);
+}
+
+
+/* Return the root page of a virtual menu.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+wimp_menu *menus_virtual_get_menu(struct menus_virtual *virtual)
+{
+	if (virtual == NULL)
+		return NULL;
+
+	return virtual->level[0].menu;
+}
+
+
+/* Process a Message_MenuWarning for a virtual menu.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+osbool menus_virtual_warning(struct menus_virtual *virtual, wimp_message_menu_warning *warning, int level)
+{
+	struct menus_virtual_level	*parent, *child;
+	wimp_selection			*selection;
+	size_t				limit, first;
+	int				depth, item;
+
+	if (virtual == NULL || warning == NULL || level < 0)
+		return FALSE;
+
+	selection = &(warning->selection);
+	limit = sizeof(selection->items) / sizeof(selection->items[0]);
+
+	/* Follow the selection down through the open pages, until we reach
+	 * the entry whose submenu has been requested.
+	 */
+
+	for (depth = 0; depth < virtual->depth - 1 && (size_t) (level + depth + 1) < limit; depth++) {
+		item = selection->items[level + depth];
+		if (item < 0 || (size_t) item >= virtual->page_size)
+			return FALSE;
+
+		parent = virtual->level + depth;
+		child = virtual->level + depth + 1;
+
+		if (parent->menu == NULL)
+			return FALSE;
+
+		if (selection->items[level + depth + 1] >= 0) {
+			if (child->menu == NULL || child->parent_entry != item)
+				return FALSE;
+
+			continue;
+		}
+
+		/* This is the entry: check that it's one of ours. */
+
+		first = parent->first + (item * parent->span);
+		if (first >= virtual->entries)
+			return FALSE;
+
+		if (warning->sub_menu != (wimp_menu *) virtual && (child->menu == NULL || warning->sub_menu != child->menu))
+			return FALSE;
+
+		/* Build the page, unless it's the one which is already open. */
+
+		if (child->menu == NULL || child->first != first) {
+			menus_virtual_free_pages(virtual, depth + 1);
+
+			child->menu = menus_virtual_build_page(virtual, first, child->span);
+			if (child->menu == NULL)
+				return TRUE;
+
+			child->first = first;
+			child->parent_entry = item;
+			parent->menu->entries[item].sub_menu = child->menu;
+		}
+
+		xwimp_create_sub_menu(child->menu, warning->pos.x, warning->pos.y);
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+/* Convert a menu selection into an index in a virtual menu's logical list.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+int menus_virtual_decode(struct menus_virtual *virtual, wimp_selection *selection, int level)
+{
+	size_t	limit, first, span;
+	int	depth, item;
+
+	if (virtual == NULL || selection == NULL || level < 0)
+		return -1;
+
+	limit = sizeof(selection->items) / sizeof(selection->items[0]);
+	first = 0;
+
+	/* The index follows from the path alone, as every page at a given
+	 * depth covers a fixed span of the list.
+	 */
+
+	for (depth = 0; depth < virtual->depth && (size_t) (level + depth) < limit; depth++) {
+		item = selection->items[level + depth];
+		if (item < 0 || (size_t) item >= virtual->page_size)
+			return -1;
+
+		span = virtual->level[depth].span;
+		first += item * span;
+
+		if (first >= virtual->entries)
+			return -1;
+
+		if (span == 1)
+			return first;
+	}
+
+	return -1;
+}
+
+
+/* Free any pages of a virtual menu below the root.
+ *
+ * This is an external interface, documented in menus.h
+ */
+
+void menus_virtual_release(struct menus_virtual *virtual)
+{
+	if (virtual == NULL)
+		return;
+
+	menus_virtual_free_pages(virtual, 1);
+}
+
+
+/**
+ * Build a page for a virtual menu.
+ *
+ * \param *virtual		The virtual menu to build the page for.
+ * \param first			The first logical entry covered by the page.
+ * \param span			The number of logical entries covered by each
+ *				entry on the page.
+ * \return			The new page, or NULL on failure.
+ */
+
+static wimp_menu *menus_virtual_build_page(struct menus_virtual *virtual, size_t first, size_t span)
+{
+	struct menus_builder	builder;
+	char			label[MENUS_VIRTUAL_LABEL_LENGTH];
+	size_t			entries, text_size, entry;
+	int			index;
+
+	/* Count the entries, and the text space that they will need. */
+
+	entries = (virtual->entries - first + span - 1) / span;
+	if (entries > virtual->page_size)
+		entries = virtual->page_size;
+
+	text_size = 0;
+
+	for (entry = 0; entry < entries; entry++)
+		text_size += menus_builder_measure(menus_virtual_get_label(virtual, first + (entry * span), span, label, MENUS_VIRTUAL_LABEL_LENGTH));
+
+	if (menus_builder_begin(&builder, virtual->title, entries, text_size) == NULL)
+		return NULL;
+
+	/* Add the entries, with range entries giving warning of their submenus. */
+
+	for (entry = 0; entry < entries; entry++) {
+		index = menus_builder_append(&builder, menus_virtual_get_label(virtual, first + (entry * span), span, label, MENUS_VIRTUAL_LABEL_LENGTH),
+				MENUS_SEPARATOR_NONE, (span > 1) ? (wimp_menu *) virtual : NULL);
+
+		if (index == -1) {
+			free(menus_builder_finish(&builder));
+			return NULL;
+		}
+
+		if (span > 1)
+			builder.menu->entries[index].menu_flags |= wimp_MENU_GIVE_WARNING;
+	}
+
+	return menus_builder_finish(&builder);
+}
+
+
+/**
+ * Return the label for an entry on a virtual menu page: either the text of
+ * a single entry, or the first and last entries of a range.
+ *
+ * \param *virtual		The virtual menu to label the entry for.
+ * \param first			The first logical entry covered by the entry.
+ * \param span			The number of logical entries covered.
+ * \param *buffer		Pointer to a buffer to hold a range label.
+ * \param length		The length of the buffer.
+ * \return			Pointer to the label.
+ */
+
+static char *menus_virtual_get_label(struct menus_virtual *virtual, size_t first, size_t span, char *buffer, size_t length)
+{
+	struct string_builder	label;
+	size_t			last;
+
+	if (span == 1)
+		return (virtual->text)(first, virtual->data);
+
+	last = first + span - 1;
+	if (last >= virtual->entries)
+		last = virtual->entries - 1;
+
+	string_builder_init(&label, buffer, length);
+	string_builder_append(&label, (virtual->text)(first, virtual->data));
+
+	if (last != first) {
+		string_builder_append(&label, " - ");
+		string_builder_append(&label, (virtual->text)(last, virtual->data));
+	}
+
+	return buffer;
+}
+
+
+/**
+ * Free the pages of a virtual menu from a given level in the tree
+ * downwards, unlinking them from their parent pages.
+ *
+ * \param *virtual		The virtual menu to free the pages of.
+ * \param level			The first level to free.
+ */
+
+static void menus_virtual_free_pages(struct menus_virtual *virtual, int level)
+{
+	struct menus_virtual_level	*page;
+	int				depth;
+
+	for (depth = virtual->depth - 1; depth >= level; depth--) {
+		page = virtual->level + depth;
+
+		if (page->menu == NULL)
+			continue;
+
+		if (depth > 0 && virtual->level[depth - 1].menu != NULL && page->parent_entry >= 0)
+			virtual->level[depth - 1].menu->entries[page->parent_entry].sub_menu = (wimp_menu *) virtual;
+
+		free(page->menu);
+		page->menu = NULL;
+		page->parent_entry = -1;
+	}
+}
+
+
 /* Open a menu at the specified pointer position, located according to
  * Style Guide requirements.
  *
@@ -635,3 +1328,233 @@ unsigned menus_get_entries(wimp_menu *menu)
 
 	return entries;
 }
+
+
+/**
+ * Find the list of menu names in a menu template block.
+ *
+ * \param data		The menu template block to search.
+ * \return		Pointer to the first name block, or NULL if the file
+ *			has no menu names.
+ */
+
+static int *menus_find_names_list(menu_template data)
+{
+	if (*(data + MENU_EXTENDED_HEADER_OFFSET) != MENU_ZERO_WORD || *(data + MENU_NAMES_LIST_OFFSET) == MENU_END_OF_LIST)
+		return NULL;
+
+	return (int *) ((int) data + (int) *(data + MENU_NAMES_LIST_OFFSET));
+}
+
+
+/**
+ * Find the list of dialogue box tags in a menu template block.
+ *
+ * \param data		The menu template block to search.
+ * \return		Pointer to the first tag block, or NULL if the file
+ *			has no dialogue box tags.
+ */
+
+static int *menus_find_dialogue_list(menu_template data)
+{
+	int	*current;
+
+	if (*(data + MENU_DIALOGUE_LIST_OFFSET) == MENU_END_OF_LIST)
+		return NULL;
+
+	current = (int *) ((int) data + (int) *(data + MENU_DIALOGUE_LIST_OFFSET));
+
+	if (*current != MENU_ZERO_WORD)
+		return NULL;
+
+	return current + 1;
+}
+
+
+/**
+ * Count the entries in a list of menu names or dialogue box tags.
+ *
+ * \param *current	Pointer to the first block in the list, or NULL.
+ * \return		The number of entries in the list.
+ */
+
+static size_t menus_count_template_list(int *current)
+{
+	size_t	entries = 0;
+
+	if (current == NULL)
+		return 0;
+
+	while (*current != MENU_END_OF_LIST) {
+		entries++;
+		current = (int *) ((int) current + ((strlen((char *) (current + MENU_NAME_TEXT)) + 8) & (~3)));
+	}
+
+	return entries;
+}
+
+
+/**
+ * Build the index of the named menus and dialogue box tags in a menu
+ * template block, in the space left for it by menus_load_templates(), and
+ * record its offset in the block's header.
+ *
+ * \param data		The menu template block to index.
+ * \param offset	The offset to the space for the index, or
+ *			MENU_END_OF_LIST if there isn't one.
+ */
+
+static void menus_build_template_index(menu_template data, int offset)
+{
+	struct menus_template_index	*index;
+	struct menus_template_entry	*entries;
+
+	*(data + MENU_INDEX_OFFSET) = offset;
+
+	if (offset == MENU_END_OF_LIST)
+		return;
+
+	index = (struct menus_template_index *) ((char *) data + offset);
+	entries = (struct menus_template_entry *) (index + 1);
+
+	index->names = menus_fill_template_index(entries, menus_find_names_list(data), data);
+	index->dialogues = menus_fill_template_index(entries + index->names, menus_find_dialogue_list(data), NULL);
+}
+
+
+/**
+ * Fill in the index entries for a list of menu names or dialogue box tags,
+ * sorting them by tag.  Where tags are repeated, the first one in the list
+ * wins, as in a scan of the list.
+ *
+ * \param *entries	Pointer to the space for the entries.
+ * \param *current	Pointer to the first block in the list, or NULL.
+ * \param data		The menu template block for a list of menu names,
+ *			or NULL for a list of dialogue box tags.
+ * \return		The number of entries in the index.
+ */
+
+static size_t menus_fill_template_index(struct menus_template_entry *entries, int *current, menu_template data)
+{
+	size_t	count = 0, i, unique;
+
+	if (current == NULL)
+		return 0;
+
+	while (*current != MENU_END_OF_LIST) {
+		entries[count].tag = (char *) (current + MENU_NAME_TEXT);
+		entries[count].block = (data != NULL) ? (void *) ((int) data + (int) *(current + MENU_NAME_OFFSET)) : current;
+		count++;
+
+		current = (int *) ((int) current + ((strlen((char *) (current + MENU_NAME_TEXT)) + 8) & (~3)));
+	}
+
+	if (count == 0)
+		return 0;
+
+	qsort(entries, count, sizeof(struct menus_template_entry), menus_compare_template_entries);
+
+	/* The sort leaves repeated tags in file order, so keep the first. */
+
+	for (i = 1, unique = 1; i < count; i++) {
+		if (strcmp(entries[i].tag, entries[unique - 1].tag) != 0)
+			entries[unique++] = entries[i];
+	}
+
+	return unique;
+}
+
+
+/**
+ * Compare two menu template index entries for qsort(), ordering them by
+ * tag and then by their position in the file.
+ *
+ * \param *a		The first entry to compare.
+ * \param *b		The second entry to compare.
+ * \return		The result of the comparison.
+ */
+
+static int menus_compare_template_entries(const void *a, const void *b)
+{
+	const struct menus_template_entry	*first = a, *second = b;
+	int					result;
+
+	result = strcmp(first->tag, second->tag);
+
+	if (result == 0)
+		result = (first->tag < second->tag) ? -1 : (first->tag > second->tag);
+
+	return result;
+}
+
+
+/**
+ * Compare a tag with a menu template index entry for bsearch().
+ *
+ * \param *tag		The tag to compare.
+ * \param *entry	The entry to compare.
+ * \return		The result of the comparison.
+ */
+
+static int menus_compare_template_tag(const void *tag, const void *entry)
+{
+	return strcmp(tag, ((const struct menus_template_entry *) entry)->tag);
+}
+
+
+/**
+ * Find the index of a menu template block.
+ *
+ * \param data		The menu template block of interest.
+ * \return		Pointer to the index, or NULL if the block has none.
+ */
+
+static struct menus_template_index *menus_get_template_index(menu_template data)
+{
+	if (*(data + MENU_INDEX_OFFSET) == MENU_END_OF_LIST)
+		return NULL;
+
+	return (struct menus_template_index *) ((char *) data + *(data + MENU_INDEX_OFFSET));
+}
+
+
+/**
+ * Find the tag block for a dialogue box in a menu template block.
+ *
+ * \param data		The menu template block to search.
+ * \param *tag		The dialogue box tag to find.
+ * \return		Pointer to the tag block, or NULL if not found.
+ */
+
+static int *menus_find_dialogue_block(menu_template data, char *tag)
+{
+	struct menus_template_index	*index;
+	struct menus_template_entry	*entry;
+	int				*current;
+
+	current = menus_find_dialogue_list(data);
+	if (current == NULL)
+		return NULL;
+
+	/* Use the index if there is one; otherwise scan the list in the file. */
+
+	index = menus_get_template_index(data);
+
+	if (index != NULL) {
+		entry = bsearch(tag, (struct menus_template_entry *) (index + 1) + index->names, index->dialogues,
+				sizeof(struct menus_template_entry), menus_compare_template_tag);
+		return (entry != NULL) ? entry->block : NULL;
+	}
+
+	/* Find the correct dbox list by string matching the tags. */
+
+	while (*current != -1 && strcmp((char *) (current + MENU_DIALOGUE_TEXT), tag) != 0) {
+		current = (int *) ((int) current +
+				((strlen((char *) (current + MENU_DIALOGUE_TEXT)) + 8) & (~3)));
+	}
+
+	if (*current == MENU_END_OF_LIST)
+		return NULL;
+
+	return current;
+}
@@ -33,6 +33,7 @@
 
 #include <stdlib.h>
 #include "oslib/wimp.h"
+#include "msgs.h"
 
 /**
  * Options for adding a separator to a menu.
@@ -65,6 +66,10 @@ typedef int * menu_template;
  *			can be accessed via menus_get_menu().
  * \param len		The number of entries in the menu block array.
  * \return		The menu template handle for the file, NULL for failure.
+ *
+ * The menu names and dialogue tags in the block are indexed for fast lookup.
+ * The index is held in the same block of memory as the templates, so the
+ * block can still be released with free() if it is no longer required.
  */
 
 menu_template menus_load_templates(char *filename, wimp_w dbox_list[], wimp_menu *menus[], size_t len);
@@ -130,6 +135,198 @@ wimp_menu *menus_build_menu(char *title, osbool external_title, size_t entries);
 void menus_build_entry(wimp_menu *menu, int entry, char *text, size_t text_length, enum menus_separator separator, wimp_menu *sub_menu);
 
 
+/**
+ * Fill a run of entries in an existing menu created by menus_build_menu()
+ * from a block of messages returned by a bulk lookup, starting with the
+ * first message in the block.  Texts longer than 12 characters are
+ * indirected directly into the block, which must therefore outlive the
+ * menu: it must not be freed until the menu has been closed and either
+ * freed or refilled.  Shorter texts are copied into the entries.
+ *
+ * \param *menu			Pointer to the menu to use.
+ * \param first			The index of the first entry to fill.
+ * \param *block		The block of messages to use.
+ * \return			The number of entries filled.
+ */
+
+size_t menus_build_block_entries(wimp_menu *menu, int first, struct msgs_block *block);
+
+
+/**
+ * Create a new menu in memory, with one entry for each message in a
+ * block returned by a bulk lookup.  The memory for the menu is allocated
+ * using malloc(), and must be freed after use.  Long texts are indirected
+ * into the block, so it must outlive the menu, as for
+ * menus_build_block_entries().
+ *
+ * \param *title		Pointer to the title text.
+ * \param external_title	TRUE if the title should be used in-situ;
+ *				FALSE if it should be copied into the menu.
+ * \param *block		The block of messages to use.
+ * \return			A pointer to the menu, or NULL on failure.
+ */
+
+wimp_menu *menus_build_block_menu(char *title, osbool external_title, struct msgs_block *block);
+
+
+/**
+ * A menu being assembled by menus_builder_begin() and menus_builder_append().
+ * The menu definition, its entries and all of their indirected text share a
+ * single block of memory, which is sized when the build begins.
+ */
+
+struct menus_builder {
+	wimp_menu	*menu;					/**< The menu under construction, or NULL.		*/
+	size_t		entries;				/**< The number of entries allocated in the block.	*/
+	size_t		count;					/**< The number of entries appended so far.		*/
+	char		*text;					/**< The next free byte of the text area.		*/
+	char		*text_end;				/**< The byte after the end of the text area.		*/
+};
+
+
+/**
+ * Return the number of bytes of text space which an entry will require
+ * in a menu assembled by a menu builder, so that the total can be passed
+ * to menus_builder_begin().
+ *
+ * \param *text			Pointer to the text for the menu entry.
+ * \return			The number of bytes of text space required.
+ */
+
+size_t menus_builder_measure(char *text);
+
+
+/**
+ * Start to assemble a new menu in a single block of memory, setting the
+ * title and reserving space for the entries and their text.
+ *
+ * \param *builder		Pointer to the builder to initialise.
+ * \param *title		Pointer to the title text, which is copied into
+ *				the block.
+ * \param entries		The maximum number of entries in the menu.
+ * \param text_size		The total text space required by the entries,
+ *				as the sum of menus_builder_measure() for each.
+ * \return			A pointer to the menu, or NULL on failure.
+ */
+
+wimp_menu *menus_builder_begin(struct menus_builder *builder, char *title, size_t entries, size_t text_size);
+
+
+/**
+ * Append an entry to the end of a menu being assembled by a builder.
+ *
+ * \param *builder		Pointer to the builder to use.
+ * \param *text			Pointer to the text for the menu entry, which is
+ *				copied into the block.
+ * \param separator		Should the entry be followed by a separator?
+ * \param *sub_menu		Pointer to a submenu, or NULL for none.
+ * \return			The index of the new entry, or -1 if there was
+ *				no space left in the block.
+ */
+
+int menus_builder_append(struct menus_builder *builder, char *text, enum menus_separator separator, wimp_menu *sub_menu);
+
+
+/**
+ * Complete a menu assembled by a builder, marking the last entry which was
+ * appended.  The menu and all of its text are held in a single block
+ * allocated using malloc(), which must be freed with free() after use; if
+ * no entries were appended, the block is freed and NULL returned.
+ *
+ * \param *builder		Pointer to the builder to complete.
+ * \return			A pointer to the menu, or NULL on failure.
+ */
+
+wimp_menu *menus_builder_finish(struct menus_builder *builder);
+
+
+/**
+ * A virtual menu, presenting a large logical list of entries as a tree of
+ * pages which each hold a limited number of entries.  If the list won't
+ * fit on one page, the entries on the upper pages lead to submenus covering
+ * ranges of the list; only the root page is held permanently, and the others
+ * are built when the Wimp warns that they are about to be opened and
+ * released when the menu closes.
+ */
+
+struct menus_virtual;
+
+
+/**
+ * Create a new virtual menu.
+ *
+ * \param *title		Pointer to the title text, which is copied.
+ * \param entries		The number of entries in the logical list, which
+ *				must be at least one.
+ * \param page_size		The maximum number of entries on each page, which
+ *				must be at least two.
+ * \param *text			Callback to return the text of an entry from the
+ *				logical list; the text is copied before the next
+ *				call is made.
+ * \param *data			Data to pass to the text callback.
+ * \return			The new virtual menu, or NULL on failure.
+ */
+
+struct menus_virtual *menus_virtual_create(char *title, size_t entries, size_t page_size, char *(*text)(size_t index, void *data), void *data);
+
+
+/**
+ * Destroy a virtual menu, freeing all of its pages.
+ *
+ * \param *virtual		The virtual menu to destroy.
+ */
+
+void menus_virtual_destroy(struct menus_virtual *virtual);
+
+
+/**
+ * Return the root page of a virtual menu, to be opened as the menu.
+ *
+ * \param *virtual		The virtual menu to return the root of.
+ * \return			The root menu, or NULL on failure.
+ */
+
+wimp_menu *menus_virtual_get_menu(struct menus_virtual *virtual);
+
+
+/**
+ * Process a Message_MenuWarning, building and opening the requested page
+ * if the warning was sent for one of the virtual menu's range entries.
+ *
+ * \param *virtual		The virtual menu to process the warning for.
+ * \param *warning		The menu warning message.
+ * \param level			The level in the menu tree at which the virtual
+ *				menu's root appears; 0 if it is the root menu.
+ * \return			TRUE if the warning was handled; else FALSE.
+ */
+
+osbool menus_virtual_warning(struct menus_virtual *virtual, wimp_message_menu_warning *warning, int level);
+
+
+/**
+ * Convert a menu selection into an index in a virtual menu's logical list.
+ *
+ * \param *virtual		The virtual menu to decode the selection for.
+ * \param *selection		The menu selection to decode.
+ * \param level			The level in the selection at which the virtual
+ *				menu's root appears; 0 if it is the root menu.
+ * \return			The index of the selected entry, or -1 if no
+ *				entry in the list was selected.
+ */
+
+int menus_virtual_decode(struct menus_virtual *virtual, wimp_selection *selection, int level);
+
+
+/**
+ * Free any pages of a virtual menu below the root, once the menu has
+ * been closed.
+ *
+ * \param *virtual		The virtual menu to release the pages of.
+ */
+
+void menus_virtual_release(struct menus_virtual *virtual);
+
+
 /**
  * Open a menu at the specified pointer position, located according to
  * Style Guide requirements.
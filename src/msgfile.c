@@ -0,0 +1,1161 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: msgfile.c
+ *
+ * Native Message File engine.  Parse MessageTrans-format Messages files
+ * into a hashed token table, and look up tokens from it, without
+ * any use of the MessageTrans module.
+ *
+ * The files follow the MessageTrans rules: lines starting with # are
+ * comments, and each message is preceded by one or more tokens which
+ * are separated by / or by newlines, with the last being followed by a
+ * colon.  A ? in a token in the file matches any character in the token
+ * being looked up, and where tokens appear more than once, the first
+ * match in the file is used.
+ *
+ * Files can also be compiled into a binary form by msgfile_compile(), in
+ * which the tokens are indexed by a minimal perfect hash and the messages
+ * are split into literal text and parameter segments in advance.  These
+ * can be loaded directly, without any parsing, and are used in place of
+ * the text by msgfile_load() if supplied.  All of the values in compiled
+ * files are 32-bit little-endian words, which suits both RISC OS and the
+ * Linux hosts on which the files are generally compiled.
+ */
+
+/* SF-Lib header files. */
+
+#include "msgfile.h"
+
+/* ANSII C header files. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * The initial number of entries allocated for the token list.
+ */
+
+#define MSGFILE_INITIAL_ENTRIES 64
+
+/**
+ * The magic word identifying a compiled Messages file ("MSGB").
+ */
+
+#define MSGFILE_COMPILED_MAGIC 0x4247534du
+
+/**
+ * The version of the compiled Messages file format.
+ */
+
+#define MSGFILE_COMPILED_VERSION 1
+
+/**
+ * The number of seeds to try for each perfect hash bucket before giving up.
+ */
+
+#define MSGFILE_COMPILED_MAX_SEED 0x1000000u
+
+/**
+ * The parameter index used for segments with no parameter.
+ */
+
+#define MSGFILE_NO_PARAM (-1)
+
+/**
+ * The header of a compiled Messages file.  All of the offsets are from
+ * the start of the file.
+ */
+
+struct msgfile_compiled_header {
+	unsigned int		magic;			/**< The file's magic word.					*/
+	unsigned int		version;		/**< The file format version.					*/
+	unsigned int		size;			/**< The total size of the file.				*/
+
+	unsigned int		entry_count;		/**< The number of exact tokens in the hash table.		*/
+	unsigned int		bucket_count;		/**< The number of buckets in the hash table.			*/
+	unsigned int		wildcard_count;		/**< The number of tokens containing wildcards.			*/
+	unsigned int		segment_count;		/**< The total number of message segments.			*/
+
+	unsigned int		seeds;			/**< The offset of the bucket seed array.			*/
+	unsigned int		entries;		/**< The offset of the exact tokens, in hash slot order.	*/
+	unsigned int		wildcards;		/**< The offset of the wildcard tokens, in file order.		*/
+	unsigned int		segments;		/**< The offset of the message segments.			*/
+};
+
+/**
+ * A token in a compiled Messages file.
+ */
+
+struct msgfile_compiled_entry {
+	unsigned int		hash;			/**< The hash of the token.					*/
+	unsigned int		order;			/**< The position of the token in the original file.		*/
+	unsigned int		token;			/**< The offset of the terminated token.			*/
+	unsigned int		token_length;		/**< The length of the token.					*/
+	unsigned int		text;			/**< The offset of the terminated message text.			*/
+	unsigned int		text_length;		/**< The length of the message text.				*/
+	unsigned int		segment;		/**< The index of the message's first segment.			*/
+	unsigned int		segment_count;		/**< The number of segments in the message.			*/
+};
+
+/**
+ * A segment of a message in a compiled Messages file: a piece of literal
+ * text, optionally followed by a parameter.
+ */
+
+struct msgfile_compiled_segment {
+	unsigned int		text;			/**< The offset of the literal text.				*/
+	unsigned int		length;			/**< The length of the literal text.				*/
+	int			param;			/**< The parameter to follow, or MSGFILE_NO_PARAM.		*/
+};
+
+/**
+ * A token in a Messages file.
+ */
+
+struct msgfile_entry {
+	unsigned		hash;			/**< The hash of the token.					*/
+	char			*token;			/**< The token, terminated in the file data.			*/
+	size_t			length;			/**< The length of the token.					*/
+	char			*text;			/**< The text of the message, terminated in the file data.	*/
+};
+
+/**
+ * A loaded Messages file.
+ */
+
+struct msgfile_block {
+	char			*data;			/**< The text of the file, tokenised in place.			*/
+
+	struct msgfile_entry	*entries;		/**< The tokens, in the order that they appear in the file.	*/
+	size_t			entry_count;		/**< The number of tokens in the file.				*/
+	size_t			entry_size;		/**< The number of entries allocated.				*/
+
+	size_t			*table;			/**< The hash table, holding entry indexes plus one.		*/
+	size_t			table_size;		/**< The number of slots in the hash table.			*/
+
+	size_t			*wildcards;		/**< The indexes of the tokens containing wildcards.		*/
+	size_t			wildcard_count;		/**< The number of tokens containing wildcards.			*/
+
+	char			*compiled;		/**< The compiled file, or NULL if the file was text.		*/
+	struct msgfile_compiled_header *header;		/**< The header of the compiled file, or NULL.			*/
+};
+
+
+/* Static Function Prototypes. */
+
+static struct msgfile_block *msgfile_create_block(char *data, size_t length);
+static osbool msgfile_validate_compiled(char *data, size_t length);
+static osbool msgfile_compiled_range(struct msgfile_compiled_header *header, unsigned int offset, unsigned int count, size_t size);
+static struct msgfile_compiled_entry *msgfile_find_compiled(struct msgfile_block *block, char *token, size_t length);
+static size_t msgfile_split_segments(char *text, unsigned int base, struct msgfile_compiled_segment *segments);
+static void msgfile_expand_text(char *text, char *buffer, size_t buffer_size, char *params[]);
+static void msgfile_expand_segments(struct msgfile_block *block, struct msgfile_compiled_entry *entry, char *buffer, size_t buffer_size, char *params[]);
+static size_t msgfile_append(char *buffer, size_t buffer_size, size_t used, char *text, size_t length);
+static unsigned msgfile_seeded_hash(char *token, size_t length, unsigned seed);
+static osbool msgfile_parse(struct msgfile_block *block, size_t length);
+static osbool msgfile_add_token(struct msgfile_block *block, char *token, size_t length);
+static osbool msgfile_build_index(struct msgfile_block *block);
+static struct msgfile_entry *msgfile_find_entry(struct msgfile_block *block, char *token, size_t length);
+static osbool msgfile_wildcard_match(struct msgfile_entry *entry, char *token, size_t length);
+static osbool msgfile_wildcard_compare(char *pattern, char *token, size_t length);
+static unsigned msgfile_hash(char *token, size_t length);
+
+
+/* Load a Messages file from disc, and index its tokens.
+ *
+ * This is an external interface, documented in msgfile.h
+ */
+
+struct msgfile_block *msgfile_load(char *filename)
+{
+	FILE			*in;
+	long			length;
+	char			*data;
+
+	if (filename == NULL)
+		return NULL;
+
+	in = fopen(filename, "rb");
+	if (in == NULL)
+		return NULL;
+
+	if (fseek(in, 0, SEEK_END) != 0 || (length = ftell(in)) < 0 || fseek(in, 0, SEEK_SET) != 0) {
+		fclose(in);
+		return NULL;
+	}
+
+	data = malloc(length + 1);
+	if (data == NULL) {
+		fclose(in);
+		return NULL;
+	}
+
+	if (fread(data, 1, length, in) != (size_t) length) {
+		fclose(in);
+		free(data);
+		return NULL;
+	}
+
+	fclose(in);
+
+	return msgfile_create_block(data, length);
+}
+
+
+/* Index the tokens in a Messages file which is already in memory.
+ *
+ * This is an external interface, documented in msgfile.h
+ */
+
+struct msgfile_block *msgfile_create(char *text, size_t length)
+{
+	char	*data;
+
+	if (text == NULL)
+		return NULL;
+
+	data = malloc(length + 1);
+	if (data == NULL)
+		return NULL;
+
+	memcpy(data, text, length);
+
+	return msgfile_create_block(data, length);
+}
+
+
+/* Free a Messages file block and all of its associated data.
+ *
+ * This is an external interface, documented in msgfile.h
+ */
+
+void msgfile_destroy(struct msgfile_block *block)
+{
+	if (block == NULL)
+		return;
+
+	free(block->data);
+	free(block->compiled);
+	free(block->entries);
+	free(block->table);
+	free(block->wildcards);
+	free(block);
+}
+
+
+/* Find the unexpanded text of a message.
+ *
+ * This is an external interface, documented in msgfile.h
+ */
+
+char *msgfile_find(struct msgfile_block *block, char *token)
+{
+	struct msgfile_entry		*entry;
+	struct msgfile_compiled_entry	*compiled;
+	char				*colon;
+	size_t				length;
+
+	if (block == NULL || token == NULL)
+		return NULL;
+
+	colon = strchr(token, ':');
+	length = (colon != NULL) ? (size_t) (colon - token) : strlen(token);
+
+	if (block->compiled != NULL) {
+		compiled = msgfile_find_compiled(block, token, length);
+		if (compiled != NULL)
+			return block->compiled + compiled->text;
+	} else {
+		entry = msgfile_find_entry(block, token, length);
+		if (entry != NULL)
+			return entry->text;
+	}
+
+	return (colon != NULL) ? colon + 1 : NULL;
+}
+
+
+/* Look up a message token, substituting the supplied parameters.
+ *
+ * This is an external interface, documented in msgfile.h
+ */
+
+osbool msgfile_lookup(struct msgfile_block *block, char *token, char *buffer, size_t buffer_size, char *a, char *b, char *c, char *d)
+{
+	struct msgfile_compiled_entry	*compiled = NULL;
+	char				*text, *colon, *params[4];
+
+	if (buffer == NULL || buffer_size == 0)
+		return FALSE;
+
+	params[0] = a;
+	params[1] = b;
+	params[2] = c;
+	params[3] = d;
+
+	/* Compiled messages have been split into segments in advance. */
+
+	if (block != NULL && block->compiled != NULL && token != NULL) {
+		colon = strchr(token, ':');
+		compiled = msgfile_find_compiled(block, token, (colon != NULL) ? (size_t) (colon - token) : strlen(token));
+
+		if (compiled != NULL) {
+			msgfile_expand_segments(block, compiled, buffer, buffer_size, params);
+			return TRUE;
+		}
+	}
+
+	text = msgfile_find(block, token);
+	if (text == NULL) {
+		*buffer = '\0';
+		return FALSE;
+	}
+
+	msgfile_expand_text(text, buffer, buffer_size, params);
+
+	return TRUE;
+}
+
+
+/* Save a compiled version of a Messages file.
+ *
+ * This is an external interface, documented in msgfile.h
+ */
+
+osbool msgfile_compile(struct msgfile_block *block, char *filename)
+{
+	struct msgfile_compiled_header	*header;
+	struct msgfile_compiled_entry	*out;
+	struct msgfile_compiled_segment	*segments;
+	struct msgfile_entry		*entry;
+	size_t				*keys = NULL, *members = NULL, *starts = NULL, *order = NULL, *slots = NULL;
+	size_t				n = 0, m, i, j, k, b, size, strings, segment_count, offset, bucket, slot;
+	unsigned int			*seeds = NULL, seed;
+	char				*blob = NULL;
+	osbool				success = FALSE;
+	FILE				*file;
+
+	if (block == NULL || block->data == NULL || filename == NULL)
+		return FALSE;
+
+	/* Collect the distinct exact tokens from the hash table. */
+
+	keys = malloc((block->table_size + 1) * sizeof(size_t));
+	if (keys == NULL)
+		return FALSE;
+
+	for (i = 0; i < block->table_size; i++) {
+		if (block->table[i] != 0)
+			keys[n++] = block->table[i] - 1;
+	}
+
+	/* Sort the tokens into buckets, and order the buckets by decreasing size. */
+
+	m = (n / 2) + 1;
+
+	members = malloc((n + 1) * sizeof(size_t));
+	starts = calloc(m + 1, sizeof(size_t));
+	order = malloc(m * sizeof(size_t));
+	slots = malloc((n + 1) * sizeof(size_t));
+	seeds = calloc(m, sizeof(unsigned int));
+
+	if (members == NULL || starts == NULL || order == NULL || slots == NULL || seeds == NULL)
+		goto cleanup;
+
+	for (i = 0; i < n; i++)
+		starts[(block->entries[keys[i]].hash % m) + 1]++;
+
+	for (b = 0; b < m; b++)
+		starts[b + 1] += starts[b];
+
+	/* Fill the member lists, using the order array to track the next free position in each. */
+
+	for (b = 0; b < m; b++)
+		order[b] = starts[b];
+
+	for (i = 0; i < n; i++) {
+		bucket = block->entries[keys[i]].hash % m;
+		members[order[bucket]++] = keys[i];
+	}
+
+	/* Buckets hold very few tokens, so can be ordered by size with a pass for each size. */
+
+	for (size = 0, b = 0; b < m; b++) {
+		if (starts[b + 1] - starts[b] > size)
+			size = starts[b + 1] - starts[b];
+	}
+
+	for (k = 0; size > 0; size--) {
+		for (b = 0; b < m; b++) {
+			if (starts[b + 1] - starts[b] == size)
+				order[k++] = b;
+		}
+	}
+
+	/* Find a seed for each bucket which places all of its tokens in empty slots. */
+
+	for (i = 0; i < n; i++)
+		slots[i] = (size_t) -1;
+
+	for (b = 0; b < m; b++) {
+		bucket = order[b];
+
+		if (b >= k)
+			break;
+
+		for (seed = 1; seed < MSGFILE_COMPILED_MAX_SEED; seed++) {
+			for (j = starts[bucket]; j < starts[bucket + 1]; j++) {
+				entry = block->entries + members[j];
+				slot = msgfile_seeded_hash(entry->token, entry->length, seed) % n;
+
+				if (slots[slot] != (size_t) -1)
+					break;
+
+				slots[slot] = members[j];
+			}
+
+			if (j == starts[bucket + 1])
+				break;
+
+			/* Release the slots claimed by this attempt. */
+
+			while (j-- > starts[bucket]) {
+				entry = block->entries + members[j];
+				slots[msgfile_seeded_hash(entry->token, entry->length, seed) % n] = (size_t) -1;
+			}
+		}
+
+		if (seed >= MSGFILE_COMPILED_MAX_SEED)
+			goto cleanup;
+
+		seeds[bucket] = seed;
+	}
+
+	/* Size up the segments and strings. */
+
+	segment_count = 0;
+	strings = 0;
+
+	for (i = 0; i < n; i++) {
+		entry = block->entries + slots[i];
+		segment_count += msgfile_split_segments(entry->text, 0, NULL);
+		strings += entry->length + strlen(entry->text) + 2;
+	}
+
+	for (i = 0; i < block->wildcard_count; i++) {
+		entry = block->entries + block->wildcards[i];
+		segment_count += msgfile_split_segments(entry->text, 0, NULL);
+		strings += entry->length + strlen(entry->text) + 2;
+	}
+
+	size = sizeof(struct msgfile_compiled_header) + (m * sizeof(unsigned int)) +
+			((n + block->wildcard_count) * sizeof(struct msgfile_compiled_entry)) +
+			(segment_count * sizeof(struct msgfile_compiled_segment)) + strings;
+
+	size = (size + 3) & ~((size_t) 3);
+
+	blob = calloc(size, 1);
+	if (blob == NULL)
+		goto cleanup;
+
+	/* Fill in the header and tables. */
+
+	header = (struct msgfile_compiled_header *) blob;
+	header->magic = MSGFILE_COMPILED_MAGIC;
+	header->version = MSGFILE_COMPILED_VERSION;
+	header->size = size;
+	header->entry_count = n;
+	header->bucket_count = m;
+	header->wildcard_count = block->wildcard_count;
+	header->segment_count = segment_count;
+	header->seeds = sizeof(struct msgfile_compiled_header);
+	header->entries = header->seeds + (m * sizeof(unsigned int));
+	header->wildcards = header->entries + (n * sizeof(struct msgfile_compiled_entry));
+	header->segments = header->wildcards + (block->wildcard_count * sizeof(struct msgfile_compiled_entry));
+
+	memcpy(blob + header->seeds, seeds, m * sizeof(unsigned int));
+
+	segments = (struct msgfile_compiled_segment *) (blob + header->segments);
+	offset = header->segments + (segment_count * sizeof(struct msgfile_compiled_segment));
+	segment_count = 0;
+
+	for (i = 0; i < n + block->wildcard_count; i++) {
+		entry = block->entries + ((i < n) ? slots[i] : block->wildcards[i - n]);
+		out = (struct msgfile_compiled_entry *) (blob + header->entries) + i;
+
+		out->hash = entry->hash;
+		out->order = entry - block->entries;
+		out->token = offset;
+		out->token_length = entry->length;
+		memcpy(blob + offset, entry->token, entry->length + 1);
+		offset += entry->length + 1;
+
+		out->text = offset;
+		out->text_length = strlen(entry->text);
+		memcpy(blob + offset, entry->text, out->text_length + 1);
+		offset += out->text_length + 1;
+
+		out->segment = segment_count;
+		out->segment_count = msgfile_split_segments(entry->text, out->text, segments + segment_count);
+		segment_count += out->segment_count;
+	}
+
+	/* Write the file out. */
+
+	file = fopen(filename, "wb");
+	if (file != NULL) {
+		success = (fwrite(blob, 1, size, file) == size) ? TRUE : FALSE;
+
+		if (fclose(file) != 0)
+			success = FALSE;
+	}
+
+cleanup:
+	free(blob);
+	free(seeds);
+	free(slots);
+	free(order);
+	free(starts);
+	free(members);
+	free(keys);
+
+	return success;
+}
+
+
+/**
+ * Create a file block from a Messages file in memory, which can be either
+ * compiled or text.  The data becomes owned by the block, and is freed if
+ * the block can't be created.
+ *
+ * \param *data			The file data, claimed with malloc() and with
+ *				space for a terminator after it.
+ * \param length		The length of the file data.
+ * \return			Pointer to the new file block, or NULL on failure.
+ */
+
+static struct msgfile_block *msgfile_create_block(char *data, size_t length)
+{
+	struct msgfile_block	*block;
+
+	data[length] = '\0';
+
+	block = malloc(sizeof(struct msgfile_block));
+	if (block == NULL) {
+		free(data);
+		return NULL;
+	}
+
+	block->data = NULL;
+	block->entries = NULL;
+	block->entry_count = 0;
+	block->entry_size = 0;
+	block->table = NULL;
+	block->table_size = 0;
+	block->wildcards = NULL;
+	block->wildcard_count = 0;
+	block->compiled = NULL;
+	block->header = NULL;
+
+	/* Compiled files need no parsing, so are ready to use straight away. */
+
+	if (length >= sizeof(struct msgfile_compiled_header) &&
+			((struct msgfile_compiled_header *) data)->magic == MSGFILE_COMPILED_MAGIC) {
+		block->compiled = data;
+
+		if (!msgfile_validate_compiled(data, length)) {
+			msgfile_destroy(block);
+			return NULL;
+		}
+
+		block->header = (struct msgfile_compiled_header *) data;
+
+		return block;
+	}
+
+	block->data = data;
+
+	if (!msgfile_parse(block, length) || !msgfile_build_index(block)) {
+		msgfile_destroy(block);
+		return NULL;
+	}
+
+	return block;
+}
+
+
+/**
+ * Check that the tables in a compiled Messages file are consistent, so
+ * that lookups can trust the offsets which they contain.
+ *
+ * \param *data			The compiled file data.
+ * \param length		The length of the data.
+ * \return			TRUE if the file is valid; else FALSE.
+ */
+
+static osbool msgfile_validate_compiled(char *data, size_t length)
+{
+	struct msgfile_compiled_header	*header = (struct msgfile_compiled_header *) data;
+	struct msgfile_compiled_entry	*entry;
+	struct msgfile_compiled_segment	*segment;
+	unsigned int			i;
+
+	if (header->version != MSGFILE_COMPILED_VERSION || header->size != length || header->bucket_count == 0 ||
+			!msgfile_compiled_range(header, header->seeds, header->bucket_count, sizeof(unsigned int)) ||
+			!msgfile_compiled_range(header, header->entries, header->entry_count, sizeof(struct msgfile_compiled_entry)) ||
+			!msgfile_compiled_range(header, header->wildcards, header->wildcard_count, sizeof(struct msgfile_compiled_entry)) ||
+			!msgfile_compiled_range(header, header->segments, header->segment_count, sizeof(struct msgfile_compiled_segment)))
+		return FALSE;
+
+	/* The exact and wildcard entries are adjacent, so can be checked together. */
+
+	if (header->wildcards != header->entries + (header->entry_count * sizeof(struct msgfile_compiled_entry)))
+		return FALSE;
+
+	for (i = 0; i < header->entry_count + header->wildcard_count; i++) {
+		entry = (struct msgfile_compiled_entry *) (data + header->entries) + i;
+
+		if (!msgfile_compiled_range(header, entry->token, entry->token_length + 1, 1) || data[entry->token + entry->token_length] != '\0' ||
+				!msgfile_compiled_range(header, entry->text, entry->text_length + 1, 1) || data[entry->text + entry->text_length] != '\0' ||
+				entry->segment > header->segment_count || entry->segment_count > header->segment_count - entry->segment)
+			return FALSE;
+	}
+
+	for (i = 0; i < header->segment_count; i++) {
+		segment = (struct msgfile_compiled_segment *) (data + header->segments) + i;
+
+		if (!msgfile_compiled_range(header, segment->text, segment->length, 1) || segment->param < MSGFILE_NO_PARAM || segment->param > 3)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Test whether an array falls within a compiled Messages file.
+ *
+ * \param *header		The header of the compiled file.
+ * \param offset		The offset of the array.
+ * \param count			The number of items in the array.
+ * \param size			The size of each item.
+ * \return			TRUE if the array is within the file; else FALSE.
+ */
+
+static osbool msgfile_compiled_range(struct msgfile_compiled_header *header, unsigned int offset, unsigned int count, size_t size)
+{
+	if (offset > header->size || (offset % (size < 4 ? size : 4)) != 0)
+		return FALSE;
+
+	return (count <= (header->size - offset) / size) ? TRUE : FALSE;
+}
+
+
+/**
+ * Find the first entry in a compiled file which matches a token.
+ *
+ * \param *block		The file block to search.
+ * \param *token		The token to find, which need not be terminated.
+ * \param length		The length of the token.
+ * \return			Pointer to the matching entry, or NULL.
+ */
+
+static struct msgfile_compiled_entry *msgfile_find_compiled(struct msgfile_block *block, char *token, size_t length)
+{
+	struct msgfile_compiled_header	*header = block->header;
+	struct msgfile_compiled_entry	*entry, *found = NULL;
+	unsigned int			*seeds, i;
+	unsigned			hash;
+
+	/* Exact tokens can only be in one slot of the perfect hash table. */
+
+	if (header->entry_count > 0) {
+		hash = msgfile_hash(token, length);
+		seeds = (unsigned int *) (block->compiled + header->seeds);
+
+		entry = (struct msgfile_compiled_entry *) (block->compiled + header->entries) +
+				(msgfile_seeded_hash(token, length, seeds[hash % header->bucket_count]) % header->entry_count);
+
+		if (entry->hash == hash && entry->token_length == length && memcmp(block->compiled + entry->token, token, length) == 0)
+			found = entry;
+	}
+
+	/* A wildcard earlier in the file takes precedence over an exact match. */
+
+	for (i = 0; i < header->wildcard_count; i++) {
+		entry = (struct msgfile_compiled_entry *) (block->compiled + header->wildcards) + i;
+
+		if (found != NULL && entry->order > found->order)
+			break;
+
+		if (entry->token_length == length && msgfile_wildcard_compare(block->compiled + entry->token, token, length))
+			return entry;
+	}
+
+	return found;
+}
+
+
+/**
+ * Split the text of a message into literal and parameter segments, ready
+ * for a compiled file.
+ *
+ * \param *text			The text to split.
+ * \param base			The offset of the text in the compiled file.
+ * \param *segments		Pointer to an array to hold the segments, or
+ *				NULL to just count them.
+ * \return			The number of segments in the message.
+ */
+
+static size_t msgfile_split_segments(char *text, unsigned int base, struct msgfile_compiled_segment *segments)
+{
+	char	*start, *p;
+	size_t	count = 0;
+	int	param;
+
+	for (start = p = text; *p != '\0'; ) {
+		if (*p == '%' && *(p + 1) >= '0' && *(p + 1) <= '3')
+			param = *(p + 1) - '0';
+		else if (*p == '%' && *(p + 1) == '%')
+			param = MSGFILE_NO_PARAM;
+		else {
+			p++;
+			continue;
+		}
+
+		/* A %% keeps its first % in the literal text, and drops the second. */
+
+		if (segments != NULL) {
+			segments[count].text = base + (start - text);
+			segments[count].length = (p - start) + ((param == MSGFILE_NO_PARAM) ? 1 : 0);
+			segments[count].param = param;
+		}
+
+		count++;
+		start = p = p + 2;
+	}
+
+	if (p > start) {
+		if (segments != NULL) {
+			segments[count].text = base + (start - text);
+			segments[count].length = p - start;
+			segments[count].param = MSGFILE_NO_PARAM;
+		}
+
+		count++;
+	}
+
+	return count;
+}
+
+
+/**
+ * Expand the text of a message into a buffer, substituting %0 to %3 and
+ * %% as we go.  Any other sequences, or parameters which weren't supplied,
+ * are left intact.
+ *
+ * \param *text			The text to expand.
+ * \param *buffer		The buffer to hold the result.
+ * \param buffer_size		The size of the result buffer.
+ * \param *params[]		The four parameters, any of which may be NULL.
+ */
+
+static void msgfile_expand_text(char *text, char *buffer, size_t buffer_size, char *params[])
+{
+	char	*param;
+	size_t	used = 0;
+
+	while (*text != '\0' && used < buffer_size - 1) {
+		if (*text == '%' && *(text + 1) >= '0' && *(text + 1) <= '3' && params[*(text + 1) - '0'] != NULL) {
+			for (param = params[*(text + 1) - '0']; *param != '\0' && used < buffer_size - 1; param++)
+				buffer[used++] = *param;
+
+			text += 2;
+		} else if (*text == '%' && *(text + 1) == '%') {
+			buffer[used++] = '%';
+			text += 2;
+		} else {
+			buffer[used++] = *text++;
+		}
+	}
+
+	buffer[used] = '\0';
+}
+
+
+/**
+ * Expand a message from a compiled file into a buffer, using its
+ * pre-split segments.
+ *
+ * \param *block		The file block holding the message.
+ * \param *entry		The entry for the message.
+ * \param *buffer		The buffer to hold the result.
+ * \param buffer_size		The size of the result buffer.
+ * \param *params[]		The four parameters, any of which may be NULL.
+ */
+
+static void msgfile_expand_segments(struct msgfile_block *block, struct msgfile_compiled_entry *entry, char *buffer, size_t buffer_size, char *params[])
+{
+	struct msgfile_compiled_segment	*segment;
+	char				placeholder[2];
+	size_t				used = 0;
+	unsigned int			i;
+
+	segment = (struct msgfile_compiled_segment *) (block->compiled + block->header->segments) + entry->segment;
+
+	for (i = 0; i < entry->segment_count; i++, segment++) {
+		used = msgfile_append(buffer, buffer_size, used, block->compiled + segment->text, segment->length);
+
+		if (segment->param == MSGFILE_NO_PARAM)
+			continue;
+
+		if (params[segment->param] != NULL) {
+			used = msgfile_append(buffer, buffer_size, used, params[segment->param], strlen(params[segment->param]));
+		} else {
+			placeholder[0] = '%';
+			placeholder[1] = '0' + segment->param;
+			used = msgfile_append(buffer, buffer_size, used, placeholder, 2);
+		}
+	}
+
+	buffer[used] = '\0';
+}
+
+
+/**
+ * Append text to an expansion buffer, truncating it if required.
+ *
+ * \param *buffer		The buffer to append to.
+ * \param buffer_size		The size of the buffer.
+ * \param used			The number of characters already in the buffer.
+ * \param *text			The text to append, which need not be terminated.
+ * \param length		The length of the text.
+ * \return			The number of characters in the buffer.
+ */
+
+static size_t msgfile_append(char *buffer, size_t buffer_size, size_t used, char *text, size_t length)
+{
+	if (length > buffer_size - 1 - used)
+		length = buffer_size - 1 - used;
+
+	memcpy(buffer + used, text, length);
+
+	return used + length;
+}
+
+
+/**
+ * Parse the text of a Messages file into a list of tokens, terminating
+ * the tokens and message texts in place.
+ *
+ * \param *block		The file block to parse.
+ * \param length		The length of the file data.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+static osbool msgfile_parse(struct msgfile_block *block, size_t length)
+{
+	char	*line, *end, *eol, *next, *token, *p;
+	size_t	pending, entry;
+
+	end = block->data + length;
+	pending = 0;
+
+	for (line = block->data; line < end; line = next) {
+		eol = memchr(line, '\n', end - line);
+		if (eol != NULL)
+			next = eol + 1;
+		else
+			next = eol = end;
+
+		if (eol > line && *(eol - 1) == '\r')
+			eol--;
+
+		*eol = '\0';
+
+		if (*line == '#' || line == eol)
+			continue;
+
+		/* Collect the tokens, which are separated by slashes. */
+
+		for (token = p = line; p < eol && *p != ':'; p++) {
+			if (*p != '/')
+				continue;
+
+			*p = '\0';
+			if (!msgfile_add_token(block, token, p - token))
+				return FALSE;
+
+			pending++;
+			token = p + 1;
+		}
+
+		if (!msgfile_add_token(block, token, p - token))
+			return FALSE;
+
+		pending++;
+
+		/* A line without a colon is followed by more tokens for the same message. */
+
+		if (p == eol)
+			continue;
+
+		*p++ = '\0';
+
+		for (entry = block->entry_count - pending; entry < block->entry_count; entry++)
+			block->entries[entry].text = p;
+
+		pending = 0;
+	}
+
+	/* Tokens left over at the end of the file have no message. */
+
+	block->entry_count -= pending;
+
+	return TRUE;
+}
+
+
+/**
+ * Add a token to the end of a file's token list.
+ *
+ * \param *block		The file block to add the token to.
+ * \param *token		The token to add, terminated in the file data.
+ * \param length		The length of the token.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+static osbool msgfile_add_token(struct msgfile_block *block, char *token, size_t length)
+{
+	struct msgfile_entry	*entries;
+	size_t			size;
+
+	if (block->entry_count >= block->entry_size) {
+		size = (block->entry_size == 0) ? MSGFILE_INITIAL_ENTRIES : 2 * block->entry_size;
+
+		entries = realloc(block->entries, size * sizeof(struct msgfile_entry));
+		if (entries == NULL)
+			return FALSE;
+
+		block->entries = entries;
+		block->entry_size = size;
+	}
+
+	token[length] = '\0';
+
+	block->entries[block->entry_count].hash = msgfile_hash(token, length);
+	block->entries[block->entry_count].token = token;
+	block->entries[block->entry_count].length = length;
+	block->entries[block->entry_count].text = NULL;
+
+	block->entry_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Build the hash table and wildcard list for a file's tokens.
+ *
+ * \param *block		The file block to index.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+static osbool msgfile_build_index(struct msgfile_block *block)
+{
+	struct msgfile_entry	*entry;
+	size_t			index, slot, size;
+
+	/* Keep the table no more than half full. */
+
+	for (size = 16; size < 2 * block->entry_count; size *= 2);
+
+	block->table = calloc(size, sizeof(size_t));
+	block->wildcards = malloc((block->entry_count + 1) * sizeof(size_t));
+
+	if (block->table == NULL || block->wildcards == NULL)
+		return FALSE;
+
+	block->table_size = size;
+
+	for (index = 0; index < block->entry_count; index++) {
+		entry = block->entries + index;
+
+		/* Wildcard tokens can't be hashed, so are kept in a list of their own. */
+
+		if (memchr(entry->token, '?', entry->length) != NULL) {
+			block->wildcards[block->wildcard_count++] = index;
+			continue;
+		}
+
+		/* Later duplicates of a token are never used, so needn't be indexed. */
+
+		slot = entry->hash & (size - 1);
+
+		while (block->table[slot] != 0) {
+			if (block->entries[block->table[slot] - 1].hash == entry->hash &&
+					strcmp(block->entries[block->table[slot] - 1].token, entry->token) == 0)
+				break;
+
+			slot = (slot + 1) & (size - 1);
+		}
+
+		if (block->table[slot] == 0)
+			block->table[slot] = index + 1;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Find the first entry in a file which matches a token.
+ *
+ * \param *block		The file block to search.
+ * \param *token		The token to find, which need not be terminated.
+ * \param length		The length of the token.
+ * \return			Pointer to the matching entry, or NULL.
+ */
+
+static struct msgfile_entry *msgfile_find_entry(struct msgfile_block *block, char *token, size_t length)
+{
+	struct msgfile_entry	*entry, *found = NULL;
+	unsigned		hash;
+	size_t			slot, wildcard;
+
+	hash = msgfile_hash(token, length);
+	slot = hash & (block->table_size - 1);
+
+	while (block->table[slot] != 0) {
+		entry = block->entries + block->table[slot] - 1;
+
+		if (entry->hash == hash && entry->length == length && strncmp(entry->token, token, length) == 0) {
+			found = entry;
+			break;
+		}
+
+		slot = (slot + 1) & (block->table_size - 1);
+	}
+
+	/* A wildcard earlier in the file takes precedence over an exact match. */
+
+	for (wildcard = 0; wildcard < block->wildcard_count; wildcard++) {
+		entry = block->entries + block->wildcards[wildcard];
+
+		if (found != NULL && entry > found)
+			break;
+
+		if (msgfile_wildcard_match(entry, token, length))
+			return entry;
+	}
+
+	return found;
+}
+
+
+/**
+ * Test a token against a file entry containing wildcards.
+ *
+ * \param *entry		The entry to test against.
+ * \param *token		The token to test, which need not be terminated.
+ * \param length		The length of the token.
+ * \return			TRUE if the token matches; else FALSE.
+ */
+
+static osbool msgfile_wildcard_match(struct msgfile_entry *entry, char *token, size_t length)
+{
+	if (entry->length != length)
+		return FALSE;
+
+	return msgfile_wildcard_compare(entry->token, token, length);
+}
+
+
+/**
+ * Compare a token against a pattern containing wildcards, both of which
+ * are of the same length.
+ *
+ * \param *pattern		The pattern to compare against.
+ * \param *token		The token to compare, which need not be terminated.
+ * \param length		The length of the token and pattern.
+ * \return			TRUE if the token matches; else FALSE.
+ */
+
+static osbool msgfile_wildcard_compare(char *pattern, char *token, size_t length)
+{
+	size_t	i;
+
+	for (i = 0; i < length; i++) {
+		if (pattern[i] != '?' && pattern[i] != token[i])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Calculate the hash of a message token.
+ *
+ * \param *token		The token to hash, which need not be terminated.
+ * \param length		The length of the token.
+ * \return			The hash of the token.
+ */
+
+static unsigned msgfile_hash(char *token, size_t length)
+{
+	unsigned	hash = 5381;
+
+	while (length-- > 0)
+		hash = (hash * 33) ^ (unsigned char) *token++;
+
+	return hash;
+}
+
+
+/**
+ * Calculate a seeded hash of a message token, for placing it in the
+ * perfect hash table of a compiled file.  The result must be the same on
+ * all platforms, so only the low 32 bits are used.
+ *
+ * \param *token		The token to hash, which need not be terminated.
+ * \param length		The length of the token.
+ * \param seed			The seed for the hash.
+ * \return			The hash of the token.
+ */
+
+static unsigned msgfile_seeded_hash(char *token, size_t length, unsigned seed)
+{
+	unsigned	hash = (2166136261u ^ (seed * 0x9e3779b9u)) & 0xffffffffu;
+
+	while (length-- > 0)
+		hash = ((hash ^ (unsigned char) *token++) * 16777619u) & 0xffffffffu;
+
+	hash ^= hash >> 15;
+
+	return hash & 0xffffffffu;
+}
+
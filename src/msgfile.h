@@ -0,0 +1,138 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: msgfile.h
+ *
+ * Native Message File engine.  Parse MessageTrans-format Messages files
+ * into a hashed token table, and look up tokens from it, without
+ * any use of the MessageTrans module.  Files can also be compiled in
+ * advance, so that they can be loaded without any parsing at all.
+ */
+
+#ifndef SFLIB_MSGFILE
+#define SFLIB_MSGFILE
+
+#include <stddef.h>
+
+/* The engine is also built into host tools, which don't have OSLib. */
+
+#ifdef SFLIB_HOST
+#ifndef SFLIB_HOST_TYPES
+#define SFLIB_HOST_TYPES
+typedef int osbool;
+typedef unsigned char byte;
+#define TRUE 1
+#define FALSE 0
+#endif
+#else
+#include "oslib/types.h"
+#endif
+
+/**
+ * A loaded Messages file.
+ */
+
+struct msgfile_block;
+
+
+/**
+ * Load a Messages file from disc, and index its tokens.  The file can
+ * either be text, or have been compiled by msgfile_compile().
+ *
+ * \param *filename		The name of the file to load.
+ * \return			Pointer to the new file block, or NULL on failure.
+ */
+
+struct msgfile_block *msgfile_load(char *filename);
+
+
+/**
+ * Index the tokens in a Messages file which is already in memory.  The
+ * text is copied, so the original need not be retained by the caller.
+ *
+ * \param *text			Pointer to the text of the file.
+ * \param length		The length of the text.
+ * \return			Pointer to the new file block, or NULL on failure.
+ */
+
+struct msgfile_block *msgfile_create(char *text, size_t length);
+
+
+/**
+ * Free a Messages file block and all of its associated data.
+ *
+ * \param *block		The block to free.
+ */
+
+void msgfile_destroy(struct msgfile_block *block);
+
+
+/**
+ * Find the unexpanded text of a message.  The token can contain a default
+ * value, in the form token:default, to be returned if the token isn't
+ * found.
+ *
+ * \param *block		The file block to search.
+ * \param *token		The token to look up.
+ * \return			Pointer to the text, which remains valid until
+ *				the block is destroyed, or NULL if not found.
+ */
+
+char *msgfile_find(struct msgfile_block *block, char *token);
+
+
+/**
+ * Look up a message token, substituting the supplied parameters for %0
+ * to %3 and storing the result in the supplied buffer.  If the result is
+ * too long for the buffer, it is truncated.
+ *
+ * \param *block		The file block to search.
+ * \param *token		The token to look up.
+ * \param *buffer		The buffer to hold the result.
+ * \param buffer_size		The size of the result buffer.
+ * \param *a			Parameter for %0, or NULL.
+ * \param *b			Parameter for %1, or NULL.
+ * \param *c			Parameter for %2, or NULL.
+ * \param *d			Parameter for %3, or NULL.
+ * \return			TRUE if the token was found; else FALSE.
+ */
+
+osbool msgfile_lookup(struct msgfile_block *block, char *token, char *buffer, size_t buffer_size, char *a, char *b, char *c, char *d);
+
+
+/**
+ * Save a compiled version of a Messages file loaded from text, in which
+ * the tokens are indexed by a minimal perfect hash and the messages have
+ * been split into literal and parameter segments.
+ *
+ * \param *block		The file block to compile.
+ * \param *filename		The name of the file to save to.
+ * \return			TRUE if successful; FALSE on failure, or if the
+ *				block was itself loaded from a compiled file.
+ */
+
+osbool msgfile_compile(struct msgfile_block *block, char *filename);
+
+#endif
+
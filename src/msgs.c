@@ -36,12 +36,80 @@
 /* SF-Lib header files. */
 
 #include "msgs.h"
+#include "msgfile.h"
 #include "string.h"
 
 /* ANSII C header files. */
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
+
+/**
+ * The maximum number of unpinned entries held in the lookup cache.
+ */
+
+#define MSGS_CACHE_SIZE 64
+
+/**
+ * The number of hash chains in the lookup cache; must be a power of 2.
+ */
+
+#define MSGS_CACHE_BUCKETS 128
+
+/**
+ * A segment of a compiled message template.  Each segment is a piece of
+ * literal text, optionally followed by a parameter placeholder.
+ */
+
+struct msgs_template_segment {
+	char			*text;			/**< The literal text, in the template block.			*/
+	size_t			length;			/**< The length of the literal text.				*/
+	int			param;			/**< The index of the parameter to follow, or -1 for none.	*/
+	char			*placeholder;		/**< The text of the placeholder, used if no parameter is given.	*/
+	size_t			placeholder_length;	/**< The length of the placeholder text.			*/
+};
+
+/**
+ * A compiled message template.  The segments and the copy of the text
+ * that they refer to are held in the same block, following the structure.
+ */
+
+struct msgs_template {
+	size_t				count;		/**< The number of segments in the template.			*/
+	struct msgs_template_segment	*segments;	/**< The segments which make up the template.			*/
+};
+
+/**
+ * The maximum length of a token generated by msgs_lookup_range().
+ */
+
+#define MSGS_MAX_RANGE_TOKEN 64
+
+/**
+ * The number of parameters to msgs_template_expandf() which are held on
+ * the stack; longer lists are claimed with malloc().
+ */
+
+#define MSGS_TEMPLATE_STACK_PARAMS 16
+
+/**
+ * An entry in the lookup cache, holding the expanded text of a token
+ * which has been looked up without parameters.  The token and text are
+ * held in the same block, immediately following the structure.
+ */
+
+struct msgs_cache_entry {
+	unsigned		hash;			/**< The hash of the token.					*/
+	char			*token;			/**< The token.							*/
+	char			*text;			/**< The expanded text of the token.				*/
+	size_t			length;			/**< The length of the text, excluding the terminator.		*/
+	osbool			pinned;			/**< TRUE if a pointer to the text has been handed out.		*/
+
+	struct msgs_cache_entry	*chain;			/**< The next entry in the same hash chain.			*/
+	struct msgs_cache_entry	*prev;			/**< The previous entry in the LRU list, or NULL.		*/
+	struct msgs_cache_entry	*next;			/**< The next entry in the LRU list, or NULL.			*/
+};
 
 /**
  * Pointer to the MessageTrans control block for the file.
@@ -62,6 +130,52 @@ static char *message_buffer = NULL;
 
 static osbool external_file = FALSE;
 
+/**
+ * Pointer to the file block for the native engine, or NULL if we're
+ * using MessageTrans.
+ */
+
+static struct msgfile_block *native_block = NULL;
+
+/**
+ * The hash chains of the lookup cache.
+ */
+
+static struct msgs_cache_entry *cache_buckets[MSGS_CACHE_BUCKETS];
+
+/**
+ * The most recently used unpinned entry in the lookup cache, or NULL.
+ */
+
+static struct msgs_cache_entry *cache_newest = NULL;
+
+/**
+ * The least recently used unpinned entry in the lookup cache, or NULL.
+ */
+
+static struct msgs_cache_entry *cache_oldest = NULL;
+
+/**
+ * The number of unpinned entries in the lookup cache.
+ */
+
+static size_t cache_count = 0;
+
+
+/* Static Function Prototypes. */
+
+static struct msgs_cache_entry *msgs_cache_find(char *token, unsigned hash);
+static struct msgs_cache_entry *msgs_cache_add(char *token, unsigned hash, char *text, size_t length);
+static void msgs_cache_unlink(struct msgs_cache_entry *entry);
+static void msgs_cache_remove(struct msgs_cache_entry *entry);
+static void msgs_cache_flush(void);
+static unsigned msgs_cache_hash(char *token);
+static char *msgs_find_raw(char *token, size_t *length);
+static size_t msgs_find_expanded(char *token, char *buffer, size_t buffer_size);
+static size_t msgs_template_parse(char *text, struct msgs_template_segment *segments);
+static size_t msgs_template_append(char *buffer, size_t buffer_size, size_t used, char *text, size_t length);
+static size_t msgs_template_append_number(char *buffer, size_t buffer_size, size_t used, unsigned long value, osbool negative);
+
 
 /* Iniitialise the Msgs module, loading the specified file and preparing the
  * system to handle message lookups.
@@ -70,14 +184,35 @@ static osbool external_file = FALSE;
  */
 
 osbool msgs_initialise(char *messages_file)
+{
+	return msgs_initialise_engine(messages_file, MSGS_ENGINE_MESSAGETRANS);
+}
+
+
+/* Initialise the Msgs module, loading the specified file into the chosen
+ * engine and preparing the system to handle message lookups.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+osbool msgs_initialise_engine(char *messages_file, enum msgs_engine engine)
 {
 	int message_size = 0;
 
 	/* Validate the inputs. */
 
-	if (message_block != NULL || message_buffer != NULL || messages_file == NULL)
+	if (message_block != NULL || message_buffer != NULL || native_block != NULL || messages_file == NULL)
 		return FALSE;
 
+	/* The native engine handles the file itself. */
+
+	if (engine == MSGS_ENGINE_NATIVE) {
+		native_block = msgfile_load(messages_file);
+		external_file = FALSE;
+
+		return (native_block != NULL) ? TRUE : FALSE;
+	}
+
 	/* Read the file details and allocate the necessary memory. */
 
 	if (xmessagetrans_file_info(messages_file, NULL, &message_size) != NULL)
@@ -130,7 +265,7 @@ osbool msgs_initialise(char *messages_file)
 
 osbool msgs_initialise_external(messagetrans_control_block *block)
 {
-	if (message_block != NULL || message_buffer != NULL || block == NULL)
+	if (message_block != NULL || message_buffer != NULL || native_block != NULL || block == NULL)
 		return FALSE;
 
 	message_block = block;
@@ -148,20 +283,30 @@ osbool msgs_initialise_external(messagetrans_control_block *block)
 
 osbool msgs_terminate(void)
 {
-	if (message_block == NULL)
-		return FALSE;
+	if (native_block != NULL) {
+		msgfile_destroy(native_block);
+		native_block = NULL;
+	} else if (message_block != NULL) {
+		if (external_file == FALSE) {
+			messagetrans_close_file(message_block);
+			free(message_block);
 
-	if (external_file == FALSE) {
-		messagetrans_close_file(message_block);
-		free(message_block);
+			if (message_buffer != NULL)
+				free(message_buffer);
+		}
 
-		if (message_buffer != NULL)
-			free(message_buffer);
+		message_block = NULL;
+		message_buffer = NULL;
+		external_file = FALSE;
+	} else {
+		return FALSE;
 	}
 
-	message_block = NULL;
-	message_buffer = NULL;
-	external_file = FALSE;
+	/* The cached texts came from the file just closed, whichever engine
+	 * it was loaded into.
+	 */
+
+	msgs_cache_flush();
 
 	return TRUE;
 }
@@ -215,7 +360,11 @@ osbool msgs_lookup_result(char *token, char *buffer, size_t buffer_size)
 
 osbool msgs_param_lookup_result(char *token, char *buffer, size_t buffer_size, char *a, char *b, char *c, char *d)
 {
-	os_error	*error;
+	os_error		*error;
+	struct msgs_cache_entry	*entry = NULL;
+	unsigned		hash = 0;
+	size_t			length;
+	osbool			cacheable;
 
 	if (buffer == NULL || buffer_size <= 0)
 		return FALSE;
@@ -227,6 +376,11 @@ osbool msgs_param_lookup_result(char *token, char *buffer, size_t buffer_size, c
 		return FALSE;
 	}
 
+	/* The native engine needs no cache. */
+
+	if (native_block != NULL)
+		return msgfile_lookup(native_block, token, buffer, buffer_size, a, b, c, d);
+
 	/* If there's no message block, instead of using the Global block, return the supplied token. */
 
 	if (message_block == NULL) {
@@ -234,6 +388,22 @@ osbool msgs_param_lookup_result(char *token, char *buffer, size_t buffer_size, c
 		return FALSE;
 	}
 
+	/* Lookups without parameters can be satisfied from the cache, as long
+	 * as the whole text will fit into the buffer.
+	 */
+
+	cacheable = (a == NULL && b == NULL && c == NULL && d == NULL) ? TRUE : FALSE;
+
+	if (cacheable) {
+		hash = msgs_cache_hash(token);
+		entry = msgs_cache_find(token, hash);
+
+		if (entry != NULL && entry->length < buffer_size) {
+			memcpy(buffer, entry->text, entry->length + 1);
+			return TRUE;
+		}
+	}
+
 	/* Look up the token. */
 
 	error = xmessagetrans_lookup(message_block, token, buffer, buffer_size, a, b, c, d, NULL, NULL);
@@ -245,5 +415,771 @@ osbool msgs_param_lookup_result(char *token, char *buffer, size_t buffer_size, c
 		return FALSE;
 	}
 
+	/* Only cache results which can't have been truncated. */
+
+	if (cacheable && entry == NULL) {
+		length = strlen(buffer);
+
+		if (length + 1 < buffer_size)
+			msgs_cache_add(token, hash, buffer, length);
+	}
+
 	return TRUE;
 }
+
+
+/* Look up a message token without parameters, returning a pointer to the
+ * expanded text.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+const char *msgs_get(char *token)
+{
+	struct msgs_cache_entry	*entry;
+	unsigned		hash;
+	char			*text;
+	size_t			length;
+
+	if (token == NULL)
+		return "";
+
+	if (native_block == NULL && message_block == NULL)
+		return token;
+
+	/* The native engine holds all of the texts in memory already, so
+	 * they can be returned directly unless they need expanding.
+	 */
+
+	if (native_block != NULL) {
+		text = msgfile_find(native_block, token);
+		if (text == NULL)
+			return "";
+
+		if (strchr(text, '%') == NULL)
+			return text;
+	}
+
+	hash = msgs_cache_hash(token);
+	entry = msgs_cache_find(token, hash);
+
+	/* If the token isn't cached, size an entry from the raw text, which
+	 * is never shorter than the expansion, and then expand into it.
+	 */
+
+	if (entry == NULL) {
+		text = msgs_find_raw(token, &length);
+
+		entry = msgs_cache_add(token, hash, text, length);
+		if (entry == NULL)
+			return "";
+
+		entry->length = msgs_find_expanded(token, entry->text, length + 1);
+	}
+
+	/* Pointers to the text must remain valid, so take the entry off the LRU list. */
+
+	if (!entry->pinned) {
+		msgs_cache_unlink(entry);
+		entry->pinned = TRUE;
+	}
+
+	return entry->text;
+}
+
+
+/* Look up a range of tokens made from a prefix and an index, packing the
+ * results into a single block.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+struct msgs_block *msgs_lookup_range(char *prefix, int first, int last)
+{
+	struct msgs_block	*block;
+	char			**tokens, *names;
+	size_t			count, i;
+
+	if (prefix == NULL || last < first)
+		return NULL;
+
+	count = last - first + 1;
+
+	/* Generate the tokens in one block, then look them up as a list. */
+
+	tokens = malloc(count * (sizeof(char *) + MSGS_MAX_RANGE_TOKEN));
+	if (tokens == NULL)
+		return NULL;
+
+	names = (char *) (tokens + count);
+
+	for (i = 0; i < count; i++) {
+		tokens[i] = names + (i * MSGS_MAX_RANGE_TOKEN);
+		string_printf(tokens[i], MSGS_MAX_RANGE_TOKEN, "%s%d", prefix, first + (int) i);
+	}
+
+	block = msgs_lookup_tokens(tokens, count);
+
+	free(tokens);
+
+	return block;
+}
+
+
+/* Look up an array of tokens, packing the results into a single block.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+struct msgs_block *msgs_lookup_tokens(char *tokens[], size_t count)
+{
+	struct msgs_block	*block;
+	char			**texts;
+	size_t			*lengths, size = 0, i;
+
+	if (tokens == NULL || count == 0)
+		return NULL;
+
+	/* Find all of the raw texts first, so that the block can be sized.
+	 * The text pointers and lengths share one allocation.
+	 */
+
+	texts = malloc(count * (sizeof(char *) + sizeof(size_t)));
+	if (texts == NULL)
+		return NULL;
+
+	lengths = (size_t *) (texts + count);
+
+	for (i = 0; i < count; i++) {
+		texts[i] = msgs_find_raw(tokens[i], &(lengths[i]));
+		size += lengths[i] + 1;
+	}
+
+	/* The structure, offset table and texts all share the one block. */
+
+	block = malloc(sizeof(struct msgs_block) + ((count + 1) * sizeof(size_t)) + size);
+	if (block == NULL) {
+		free(texts);
+		return NULL;
+	}
+
+	block->count = count;
+	block->offsets = (size_t *) (block + 1);
+	block->text = (char *) (block->offsets + count + 1);
+
+	/* Texts without parameters can be copied straight from the raw text;
+	 * the rest are expanded in place, which never lengthens a text.
+	 */
+
+	size = 0;
+
+	for (i = 0; i < count; i++) {
+		block->offsets[i] = size;
+
+		if (memchr(texts[i], '%', lengths[i]) == NULL) {
+			memcpy(block->text + size, texts[i], lengths[i]);
+			block->text[size + lengths[i]] = '\0';
+			size += lengths[i] + 1;
+		} else {
+			size += msgs_find_expanded(tokens[i], block->text + size, lengths[i] + 1) + 1;
+		}
+	}
+
+	block->offsets[count] = size;
+
+	free(texts);
+
+	return block;
+}
+
+
+/* Free a block of messages returned by a bulk lookup.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+void msgs_block_destroy(struct msgs_block *block)
+{
+	free(block);
+}
+
+
+/**
+ * Find the raw text of a token, without any parameter substitution or
+ * use of the lookup cache.
+ *
+ * \param *token		The token to find.
+ * \param *length		Pointer to a variable to take the length of the
+ *				text, which may not be terminated.
+ * \return			Pointer to the text, or to "" if not found.
+ */
+
+static char *msgs_find_raw(char *token, size_t *length)
+{
+	char	*text = NULL;
+	int	size = 0;
+
+	if (token == NULL) {
+		text = "";
+	} else if (native_block != NULL) {
+		text = msgfile_find(native_block, token);
+		if (text == NULL)
+			text = "";
+	} else if (message_block == NULL) {
+		text = token;
+	} else if (xmessagetrans_lookup(message_block, token, NULL, 0, NULL, NULL, NULL, NULL, &text, &size) != NULL) {
+		text = "";
+	} else {
+		*length = size;
+		return text;
+	}
+
+	*length = strlen(text);
+
+	return text;
+}
+
+
+/**
+ * Find the text of a token, expanded as for a lookup without parameters,
+ * and without any use of the lookup cache.
+ *
+ * \param *token		The token to find.
+ * \param *buffer		The buffer to take the text, which must be at
+ *				least one byte longer than the raw text.
+ * \param buffer_size		The size of the buffer.
+ * \return			The length of the expanded text.
+ */
+
+static size_t msgs_find_expanded(char *token, char *buffer, size_t buffer_size)
+{
+	if (token == NULL) {
+		*buffer = '\0';
+	} else if (native_block != NULL) {
+		if (!msgfile_lookup(native_block, token, buffer, buffer_size, NULL, NULL, NULL, NULL))
+			*buffer = '\0';
+	} else if (message_block == NULL) {
+		string_copy(buffer, token, buffer_size);
+	} else if (xmessagetrans_lookup(message_block, token, buffer, buffer_size, NULL, NULL, NULL, NULL, NULL, NULL) != NULL) {
+		*buffer = '\0';
+	}
+
+	return strlen(buffer);
+}
+
+
+/* Compile the text of a message token into a template.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+struct msgs_template *msgs_template_compile(char *token)
+{
+	struct msgs_template	*template;
+	char			*text, *copy;
+	size_t			length;
+
+	if (token == NULL)
+		return NULL;
+
+	/* Templates are compiled from the raw text, which may not be terminated. */
+
+	text = msgs_find_raw(token, &length);
+
+	copy = malloc(length + 1);
+	if (copy == NULL)
+		return NULL;
+
+	memcpy(copy, text, length);
+	copy[length] = '\0';
+
+	template = msgs_template_create(copy);
+
+	free(copy);
+
+	return template;
+}
+
+
+/* Compile a piece of text into a message template.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+struct msgs_template *msgs_template_create(char *text)
+{
+	struct msgs_template	*template;
+	size_t			count, length;
+	char			*copy;
+
+	if (text == NULL)
+		return NULL;
+
+	/* Count the segments, then parse them for real into a single block. */
+
+	count = msgs_template_parse(text, NULL);
+	length = strlen(text);
+
+	template = malloc(sizeof(struct msgs_template) + (count * sizeof(struct msgs_template_segment)) + length + 1);
+	if (template == NULL)
+		return NULL;
+
+	template->count = count;
+	template->segments = (struct msgs_template_segment *) (template + 1);
+
+	copy = (char *) (template->segments + count);
+	memcpy(copy, text, length + 1);
+
+	msgs_template_parse(copy, template->segments);
+
+	return template;
+}
+
+
+/* Free a compiled message template.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+void msgs_template_destroy(struct msgs_template *template)
+{
+	free(template);
+}
+
+
+/* Expand a compiled message template into a buffer, using an array of
+ * typed parameters.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+size_t msgs_template_expand(struct msgs_template *template, char *buffer, size_t buffer_size, struct msgs_param *params, size_t count)
+{
+	struct msgs_template_segment	*segment;
+	struct msgs_param		*param;
+	size_t				used = 0, i;
+
+	if (buffer == NULL || buffer_size == 0)
+		return 0;
+
+	if (template == NULL) {
+		*buffer = '\0';
+		return 0;
+	}
+
+	for (i = 0; i < template->count; i++) {
+		segment = template->segments + i;
+
+		used = msgs_template_append(buffer, buffer_size, used, segment->text, segment->length);
+
+		if (segment->param < 0)
+			continue;
+
+		/* Parameters which weren't supplied are left as placeholders. */
+
+		if ((size_t) segment->param >= count) {
+			used = msgs_template_append(buffer, buffer_size, used, segment->placeholder, segment->placeholder_length);
+			continue;
+		}
+
+		param = params + segment->param;
+
+		switch (param->type) {
+		case MSGS_PARAM_STRING:
+			if (param->value.string != NULL)
+				used = msgs_template_append(buffer, buffer_size, used, param->value.string, strlen(param->value.string));
+			break;
+		case MSGS_PARAM_INT:
+			if (param->value.integer < 0)
+				used = msgs_template_append_number(buffer, buffer_size, used, 0ul - (unsigned long) param->value.integer, TRUE);
+			else
+				used = msgs_template_append_number(buffer, buffer_size, used, param->value.integer, FALSE);
+			break;
+		case MSGS_PARAM_UNSIGNED:
+			used = msgs_template_append_number(buffer, buffer_size, used, param->value.unsigned_integer, FALSE);
+			break;
+		case MSGS_PARAM_SIZE:
+			used = msgs_template_append_number(buffer, buffer_size, used, param->value.size, FALSE);
+			break;
+		}
+	}
+
+	buffer[used] = '\0';
+
+	return used;
+}
+
+
+/* Expand a compiled message template into a buffer, using a list of
+ * parameters described by a type string.
+ *
+ * This is an external interface, documented in msgs.h
+ */
+
+size_t msgs_template_expandf(struct msgs_template *template, char *buffer, size_t buffer_size, char *types, ...)
+{
+	struct msgs_param	stack_params[MSGS_TEMPLATE_STACK_PARAMS], *params;
+	size_t			count, length, i;
+	va_list			ap;
+
+	if (buffer == NULL || buffer_size == 0)
+		return 0;
+
+	*buffer = '\0';
+
+	/* Short parameter lists live on the stack; longer ones are claimed. */
+
+	count = (types != NULL) ? strlen(types) : 0;
+
+	if (count <= MSGS_TEMPLATE_STACK_PARAMS) {
+		params = stack_params;
+	} else {
+		params = malloc(count * sizeof(struct msgs_param));
+		if (params == NULL)
+			return 0;
+	}
+
+	va_start(ap, types);
+
+	for (i = 0; i < count; i++) {
+		switch (types[i]) {
+		case 's':
+			params[i].type = MSGS_PARAM_STRING;
+			params[i].value.string = va_arg(ap, char *);
+			break;
+		case 'd':
+			params[i].type = MSGS_PARAM_INT;
+			params[i].value.integer = va_arg(ap, int);
+			break;
+		case 'u':
+			params[i].type = MSGS_PARAM_UNSIGNED;
+			params[i].value.unsigned_integer = va_arg(ap, unsigned);
+			break;
+		case 'z':
+			params[i].type = MSGS_PARAM_SIZE;
+			params[i].value.size = va_arg(ap, size_t);
+			break;
+		default:
+			/* The rest of the arguments can't be read safely. */
+			va_end(ap);
+			if (params != stack_params)
+				free(params);
+			return 0;
+		}
+	}
+
+	va_end(ap);
+
+	length = msgs_template_expand(template, buffer, buffer_size, params, count);
+
+	if (params != stack_params)
+		free(params);
+
+	return length;
+}
+
+
+/**
+ * Parse the text of a message into template segments.  Placeholders take
+ * the form %0 to %9, or %{n} for any parameter index; %% is a literal %.
+ *
+ * \param *text			The text to parse; if segments are being
+ *				returned, the segments will point into it.
+ * \param *segments		Pointer to an array to hold the segments, or
+ *				NULL to just count them.
+ * \return			The number of segments in the text.
+ */
+
+static size_t msgs_template_parse(char *text, struct msgs_template_segment *segments)
+{
+	size_t	count = 0;
+	char	*start, *p, *end;
+	long	param;
+
+	start = p = text;
+
+	while (*p != '\0') {
+		param = -1;
+		end = p;
+
+		if (*p == '%' && *(p + 1) >= '0' && *(p + 1) <= '9') {
+			param = *(p + 1) - '0';
+			end = p + 2;
+		} else if (*p == '%' && *(p + 1) == '{' && *(p + 2) >= '0' && *(p + 2) <= '9') {
+			param = strtol(p + 2, &end, 10);
+			if (*end == '}' && param <= 0x7fff)
+				end++;
+			else
+				param = -1;
+		} else if (*p == '%' && *(p + 1) == '%') {
+			/* A %% ends a segment after its first %, then skips the second. */
+
+			if (segments != NULL) {
+				segments[count].text = start;
+				segments[count].length = p + 1 - start;
+				segments[count].param = -1;
+			}
+
+			count++;
+			start = p = p + 2;
+			continue;
+		}
+
+		if (param < 0) {
+			p++;
+			continue;
+		}
+
+		if (segments != NULL) {
+			segments[count].text = start;
+			segments[count].length = p - start;
+			segments[count].param = (int) param;
+			segments[count].placeholder = p;
+			segments[count].placeholder_length = end - p;
+		}
+
+		count++;
+		start = p = end;
+	}
+
+	/* Any remaining text makes up a final segment. */
+
+	if (p > start) {
+		if (segments != NULL) {
+			segments[count].text = start;
+			segments[count].length = p - start;
+			segments[count].param = -1;
+		}
+
+		count++;
+	}
+
+	return count;
+}
+
+
+/**
+ * Append text to a template expansion buffer, truncating it if required.
+ *
+ * \param *buffer		The buffer to append to.
+ * \param buffer_size		The size of the buffer.
+ * \param used			The number of characters already in the buffer.
+ * \param *text			The text to append, which need not be terminated.
+ * \param length		The length of the text.
+ * \return			The number of characters in the buffer.
+ */
+
+static size_t msgs_template_append(char *buffer, size_t buffer_size, size_t used, char *text, size_t length)
+{
+	if (length > buffer_size - 1 - used)
+		length = buffer_size - 1 - used;
+
+	memcpy(buffer + used, text, length);
+
+	return used + length;
+}
+
+
+/**
+ * Append a decimal number to a template expansion buffer, truncating it
+ * if required.
+ *
+ * \param *buffer		The buffer to append to.
+ * \param buffer_size		The size of the buffer.
+ * \param used			The number of characters already in the buffer.
+ * \param value			The magnitude of the number to append.
+ * \param negative		TRUE if the number is negative; else FALSE.
+ * \return			The number of characters in the buffer.
+ */
+
+static size_t msgs_template_append_number(char *buffer, size_t buffer_size, size_t used, unsigned long value, osbool negative)
+{
+	char	digits[sizeof(unsigned long) * 3 + 1];
+	size_t	length = sizeof(digits);
+
+	/* Digits are generated backwards from the end of the array. */
+
+	do {
+		digits[--length] = '0' + (value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	if (negative)
+		digits[--length] = '-';
+
+	return msgs_template_append(buffer, buffer_size, used, digits + length, sizeof(digits) - length);
+}
+
+
+/**
+ * Find a token in the lookup cache, moving it to the head of the LRU
+ * list if it is found.
+ *
+ * \param *token		The token to find.
+ * \param hash			The hash of the token.
+ * \return			Pointer to the cache entry, or NULL.
+ */
+
+static struct msgs_cache_entry *msgs_cache_find(char *token, unsigned hash)
+{
+	struct msgs_cache_entry	*entry;
+
+	entry = cache_buckets[hash & (MSGS_CACHE_BUCKETS - 1)];
+
+	while (entry != NULL && (entry->hash != hash || strcmp(entry->token, token) != 0))
+		entry = entry->chain;
+
+	if (entry == NULL || entry->pinned || entry == cache_newest)
+		return entry;
+
+	msgs_cache_unlink(entry);
+
+	entry->prev = NULL;
+	entry->next = cache_newest;
+	cache_newest->prev = entry;
+	cache_newest = entry;
+	cache_count++;
+
+	return entry;
+}
+
+
+/**
+ * Add a token to the lookup cache, evicting the least recently used entry
+ * if the cache is full.  The token must not already be in the cache.
+ *
+ * \param *token		The token to add.
+ * \param hash			The hash of the token.
+ * \param *text			The expanded text of the token, which need
+ *				not be terminated.
+ * \param length		The length of the text.
+ * \return			Pointer to the new entry, or NULL on failure.
+ */
+
+static struct msgs_cache_entry *msgs_cache_add(char *token, unsigned hash, char *text, size_t length)
+{
+	struct msgs_cache_entry	*entry;
+	size_t			token_length;
+
+	if (cache_count >= MSGS_CACHE_SIZE && cache_oldest != NULL)
+		msgs_cache_remove(cache_oldest);
+
+	token_length = strlen(token);
+
+	entry = malloc(sizeof(struct msgs_cache_entry) + token_length + length + 2);
+	if (entry == NULL)
+		return NULL;
+
+	entry->token = (char *) (entry + 1);
+	memcpy(entry->token, token, token_length + 1);
+
+	entry->text = entry->token + token_length + 1;
+	memcpy(entry->text, text, length);
+	entry->text[length] = '\0';
+
+	entry->hash = hash;
+	entry->length = length;
+	entry->pinned = FALSE;
+
+	entry->chain = cache_buckets[hash & (MSGS_CACHE_BUCKETS - 1)];
+	cache_buckets[hash & (MSGS_CACHE_BUCKETS - 1)] = entry;
+
+	entry->prev = NULL;
+	entry->next = cache_newest;
+
+	if (cache_newest != NULL)
+		cache_newest->prev = entry;
+	else
+		cache_oldest = entry;
+
+	cache_newest = entry;
+	cache_count++;
+
+	return entry;
+}
+
+
+/**
+ * Unlink an unpinned entry from the LRU list, leaving it in its hash chain.
+ *
+ * \param *entry		The entry to unlink.
+ */
+
+static void msgs_cache_unlink(struct msgs_cache_entry *entry)
+{
+	if (entry->prev != NULL)
+		entry->prev->next = entry->next;
+	else
+		cache_newest = entry->next;
+
+	if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+	else
+		cache_oldest = entry->prev;
+
+	cache_count--;
+}
+
+
+/**
+ * Remove an unpinned entry from the lookup cache and free it.
+ *
+ * \param *entry		The entry to remove.
+ */
+
+static void msgs_cache_remove(struct msgs_cache_entry *entry)
+{
+	struct msgs_cache_entry	**link;
+
+	link = &(cache_buckets[entry->hash & (MSGS_CACHE_BUCKETS - 1)]);
+
+	while (*link != entry)
+		link = &((*link)->chain);
+
+	*link = entry->chain;
+
+	msgs_cache_unlink(entry);
+	free(entry);
+}
+
+
+/**
+ * Remove all of the entries, pinned or not, from the lookup cache.
+ */
+
+static void msgs_cache_flush(void)
+{
+	struct msgs_cache_entry	*entry, *next;
+	int			bucket;
+
+	for (bucket = 0; bucket < MSGS_CACHE_BUCKETS; bucket++) {
+		for (entry = cache_buckets[bucket]; entry != NULL; entry = next) {
+			next = entry->chain;
+			free(entry);
+		}
+
+		cache_buckets[bucket] = NULL;
+	}
+
+	cache_newest = NULL;
+	cache_oldest = NULL;
+	cache_count = 0;
+}
+
+
+/**
+ * Calculate the hash of a message token.
+ *
+ * \param *token		The token to hash.
+ * \return			The hash of the token.
+ */
+
+static unsigned msgs_cache_hash(char *token)
+{
+	unsigned	hash = 5381;
+
+	while (*token != '\0')
+		hash = (hash * 33) ^ (unsigned char) *token++;
+
+	return hash;
+}
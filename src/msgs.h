@@ -25,7 +25,9 @@
  * \file: msgs.h
  *
  * RISC OS Message File support.  Open and close Message files, and look
- * up tokens.
+ * up tokens.  The results of lookups without parameters are cached, so
+ * that frequently-used tokens don't need to be found by MessageTrans
+ * each time.
  */
 
 #ifndef SFLIB_MSGS
@@ -34,6 +36,61 @@
 #include <stdlib.h>
 #include "oslib/messagetrans.h"
 
+/**
+ * The engines which can be used to look up message tokens.
+ */
+
+enum msgs_engine {
+	MSGS_ENGINE_MESSAGETRANS,						/**< Use the MessageTrans module.			*/
+	MSGS_ENGINE_NATIVE							/**< Use SFLib's own Messages file engine.		*/
+};
+
+
+/**
+ * The types of parameter which can be used to expand a message template.
+ */
+
+enum msgs_param_type {
+	MSGS_PARAM_STRING,							/**< A pointer to a string.				*/
+	MSGS_PARAM_INT,								/**< A signed integer, in decimal.			*/
+	MSGS_PARAM_UNSIGNED,							/**< An unsigned integer, in decimal.			*/
+	MSGS_PARAM_SIZE								/**< A size_t value, in decimal.			*/
+};
+
+/**
+ * A typed parameter for expanding a message template.
+ */
+
+struct msgs_param {
+	enum msgs_param_type	type;						/**< The type of the parameter.				*/
+	union {
+		char		*string;					/**< The value of a string parameter.			*/
+		int		integer;					/**< The value of a signed integer parameter.		*/
+		unsigned	unsigned_integer;				/**< The value of an unsigned integer parameter.	*/
+		size_t		size;						/**< The value of a size_t parameter.			*/
+	} value;								/**< The value of the parameter.			*/
+};
+
+/**
+ * A compiled message template.
+ */
+
+struct msgs_template;
+
+/**
+ * A block of messages returned by a bulk lookup.  The messages are packed
+ * into a single block of text, each with its own terminator, with the
+ * offset of each from the start of the text given in a table.  The table
+ * has an extra entry at the end holding the total size of the text, so
+ * that the length of message n is offsets[n + 1] - offsets[n] - 1.
+ */
+
+struct msgs_block {
+	size_t			count;						/**< The number of messages in the block.		*/
+	size_t			*offsets;					/**< The offsets of the messages into the text.		*/
+	char			*text;						/**< The packed message texts.				*/
+};
+
 
 /**
  * Iniitialise the Msgs module, loading the specified file and preparing the
@@ -46,6 +103,21 @@
 osbool msgs_initialise(char *messages_file);
 
 
+/**
+ * Initialise the Msgs module, loading the specified file into the chosen
+ * engine and preparing the system to handle message lookups.  The native
+ * engine indexes the file itself, avoiding the SWI overhead of each
+ * MessageTrans lookup, and can also load files compiled by msgcomp;
+ * msgs_initialise() uses MessageTrans.
+ *
+ * \param *messages_file	The file to open.
+ * \param engine		The engine to use for lookups.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+osbool msgs_initialise_engine(char *messages_file, enum msgs_engine engine);
+
+
 /**
  * Initialise the Msgs module using an already prepared MessageTrans
  * Control Block.
@@ -126,5 +198,130 @@ osbool msgs_lookup_result(char *token, char *buffer, size_t buffer_size);
 
 osbool msgs_param_lookup_result(char *token, char *buffer, size_t buffer_size, char *a, char *b, char *c, char *d);
 
+
+/**
+ * Look up a message token without parameters, returning a pointer to the
+ * expanded text, exactly as msgs_lookup() would return it.  The text is
+ * held in the lookup cache, and remains valid until msgs_terminate() is
+ * called; it must not be modified.  One copy is held for each different
+ * token passed in, outside the limit on the number of cached lookups.
+ *
+ * \param *token		The message token to look up.
+ * \return			Pointer to the text, to the token if there is
+ *				no Messages file, or to "" if the token wasn't
+ *				found.
+ */
+
+const char *msgs_get(char *token);
+
+
+/**
+ * Look up a range of tokens made up from a prefix followed by a decimal
+ * index, such as Type0 to Type199, packing the texts into a single
+ * block.  The texts are expanded as msgs_lookup() would expand them.
+ * Tokens which aren't found give empty messages.  The block must be
+ * freed with msgs_block_destroy() after use.
+ *
+ * \param *prefix		The prefix of the tokens to look up.
+ * \param first			The index of the first token.
+ * \param last			The index of the last token, inclusive.
+ * \return			Pointer to the block, or NULL on failure.
+ */
+
+struct msgs_block *msgs_lookup_range(char *prefix, int first, int last);
+
+
+/**
+ * Look up an array of tokens, packing the texts into a single block.
+ * The texts are expanded as msgs_lookup() would expand them.  Tokens
+ * which aren't found give empty messages.  The
+ * block must be freed with msgs_block_destroy() after use.
+ *
+ * \param *tokens[]		The tokens to look up.
+ * \param count			The number of tokens in the array.
+ * \return			Pointer to the block, or NULL on failure.
+ */
+
+struct msgs_block *msgs_lookup_tokens(char *tokens[], size_t count);
+
+
+/**
+ * Free a block of messages returned by a bulk lookup.
+ *
+ * \param *block		The block to free, or NULL.
+ */
+
+void msgs_block_destroy(struct msgs_block *block);
+
+
+/**
+ * Compile the text of a message token into a template, which can then be
+ * expanded repeatedly without being parsed again.  Placeholders %0 to %3
+ * are those supported by MessageTrans and msgfile; %4 to %9, and %{n} for
+ * any parameter index, are extensions which only templates understand.
+ * %% gives a single %.
+ *
+ * \param *token		The message token to compile.
+ * \return			Pointer to the new template, or NULL on failure.
+ */
+
+struct msgs_template *msgs_template_compile(char *token);
+
+
+/**
+ * Compile a piece of text into a message template, as for
+ * msgs_template_compile().  The text is copied into the template.
+ *
+ * \param *text			The text to compile.
+ * \return			Pointer to the new template, or NULL on failure.
+ */
+
+struct msgs_template *msgs_template_create(char *text);
+
+
+/**
+ * Free a compiled message template.
+ *
+ * \param *template		The template to free, or NULL.
+ */
+
+void msgs_template_destroy(struct msgs_template *template);
+
+
+/**
+ * Expand a compiled message template into a buffer, formatting each of
+ * the typed parameters directly into place.  Placeholders for parameters
+ * beyond those supplied are left in the text.  If the result is too long
+ * for the buffer, it is truncated.
+ *
+ * \param *template		The template to expand.
+ * \param *buffer		The buffer to hold the result.
+ * \param buffer_size		The size of the result buffer.
+ * \param *params		An array of parameters, for %0 upwards.
+ * \param count			The number of parameters in the array.
+ * \return			The length of the result, excluding its terminator.
+ */
+
+size_t msgs_template_expand(struct msgs_template *template, char *buffer, size_t buffer_size, struct msgs_param *params, size_t count);
+
+
+/**
+ * Expand a compiled message template into a buffer, taking the parameters
+ * from a variable argument list.  Each character in the type string gives
+ * the type of the corresponding parameter: s for char *, d for int, u for
+ * unsigned and z for size_t.  If the type string contains any other
+ * character, nothing is expanded and the buffer is left empty.
+ *
+ * \param *template		The template to expand.
+ * \param *buffer		The buffer to hold the result.
+ * \param buffer_size		The size of the result buffer.
+ * \param *types		The types of the parameters which follow.
+ * \param ...			The parameters, for %0 upwards.
+ * \return			The length of the result, excluding its terminator,
+ *				or 0 on failure.
+ */
+
+size_t msgs_template_expandf(struct msgs_template *template, char *buffer, size_t buffer_size, char *types, ...);
+
 #endif
 
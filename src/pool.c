@@ -0,0 +1,323 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: pool.c
+ *
+ * Fixed-size object pools.  Pages of objects are claimed with malloc(), so
+ * that objects never move, and objects are carved from the most recent
+ * page in order.  Freed objects are linked through their first word into
+ * a free list, so there is no per-object overhead at all; the live objects
+ * are only worked out when they are iterated over.
+ */
+
+/* ANSII C header files. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* OSLib header files. */
+
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "pool.h"
+
+
+#define POOL_PAGE_SIZE 4096						/**< The target size of a page, used to find a default object count.	*/
+#define POOL_MIN_PER_PAGE 8						/**< The smallest default number of objects in a page.		*/
+
+/**
+ * A page of objects.  The objects follow the header, suitably aligned.
+ */
+
+struct pool_page {
+	struct pool_page	*next;					/**< The next page in the pool, or NULL.			*/
+	char			*objects;				/**< The first object in the page.				*/
+	size_t			used;					/**< The number of objects handed out from the page.		*/
+};
+
+/**
+ * An object pool.
+ */
+
+struct pool_block {
+	size_t			element_size;				/**< The size of each object, rounded up for alignment.	*/
+	size_t			alignment;				/**< The alignment of the objects.				*/
+	size_t			per_page;				/**< The number of objects in each page.			*/
+	enum pool_flags		flags;					/**< The flags set for the pool.				*/
+	size_t			live;					/**< The number of objects currently allocated.		*/
+	size_t			pages;					/**< The number of pages in the pool.				*/
+	struct pool_page	*page;					/**< The most recent page, or NULL if there are none.		*/
+	void			*free;					/**< The first object on the free list, or NULL.		*/
+};
+
+
+/* Static Function Prototypes. */
+
+static int pool_compare_pages(const void *a, const void *b);
+
+
+/* Create a new object pool.
+ *
+ * This is an external interface, documented in pool.h
+ */
+
+struct pool_block *pool_create(size_t element_size, size_t alignment, size_t per_page, enum pool_flags flags)
+{
+	struct pool_block	*pool;
+
+	if (element_size == 0 || (alignment & (alignment - 1)) != 0)
+		return NULL;
+
+	/* Objects must be able to hold the free list link when they're free. */
+
+	if (alignment < POOL_ALIGNMENT(void *))
+		alignment = POOL_ALIGNMENT(void *);
+
+	if (element_size < sizeof(void *))
+		element_size = sizeof(void *);
+
+	element_size = (element_size + alignment - 1) & ~(alignment - 1);
+
+	if (per_page == 0) {
+		per_page = POOL_PAGE_SIZE / element_size;
+
+		if (per_page < POOL_MIN_PER_PAGE)
+			per_page = POOL_MIN_PER_PAGE;
+	}
+
+	pool = malloc(sizeof(struct pool_block));
+	if (pool == NULL)
+		return NULL;
+
+	pool->element_size = element_size;
+	pool->alignment = alignment;
+	pool->per_page = per_page;
+	pool->flags = flags;
+	pool->live = 0;
+	pool->pages = 0;
+	pool->page = NULL;
+	pool->free = NULL;
+
+	return pool;
+}
+
+
+/* Destroy an object pool.
+ *
+ * This is an external interface, documented in pool.h
+ */
+
+void pool_destroy(struct pool_block *pool)
+{
+	struct pool_page	*page, *next;
+
+	if (pool == NULL)
+		return;
+
+	page = pool->page;
+
+	while (page != NULL) {
+		next = page->next;
+		free(page);
+		page = next;
+	}
+
+	free(pool);
+}
+
+
+/* Allocate an object from a pool.
+ *
+ * This is an external interface, documented in pool.h
+ */
+
+void *pool_alloc(struct pool_block *pool)
+{
+	struct pool_page	*page;
+	void			*object;
+
+	if (pool == NULL)
+		return NULL;
+
+	if (pool->free != NULL) {
+		/* Re-use the most recently freed object. */
+
+		object = pool->free;
+		pool->free = *(void **) object;
+	} else {
+		/* Otherwise carve a new object from the current page, starting
+		 * a new page if it's full.
+		 */
+
+		page = pool->page;
+
+		if (page == NULL || page->used == pool->per_page) {
+			page = malloc(sizeof(struct pool_page) + pool->alignment - 1 + pool->per_page * pool->element_size);
+			if (page == NULL)
+				return NULL;
+
+			page->objects = (char *) (((size_t) (page + 1) + pool->alignment - 1) & ~(pool->alignment - 1));
+			page->used = 0;
+			page->next = pool->page;
+
+			pool->page = page;
+			pool->pages++;
+		}
+
+		object = page->objects + page->used++ * pool->element_size;
+	}
+
+	if (pool->flags & POOL_FLAGS_ZERO)
+		memset(object, 0, pool->element_size);
+
+	pool->live++;
+
+	return object;
+}
+
+
+/* Return an object to the pool which it was allocated from.
+ *
+ * This is an external interface, documented in pool.h
+ */
+
+void pool_free(struct pool_block *pool, void *object)
+{
+	if (pool == NULL || object == NULL)
+		return;
+
+	*(void **) object = pool->free;
+	pool->free = object;
+
+	pool->live--;
+}
+
+
+/* Return the number of objects currently allocated from a pool.
+ *
+ * This is an external interface, documented in pool.h
+ */
+
+size_t pool_count(struct pool_block *pool)
+{
+	return (pool != NULL) ? pool->live : 0;
+}
+
+
+/* Call a function for each of the objects currently allocated from a pool.
+ *
+ * This is an external interface, documented in pool.h
+ */
+
+osbool pool_iterate(struct pool_block *pool, osbool (*callback)(void *object, void *data), void *data)
+{
+	struct pool_page	**pages, *page;
+	unsigned char		*free_map;
+	size_t			i, slot, low, high, mid;
+	void			*object;
+	osbool			complete = TRUE;
+
+	if (pool == NULL || callback == NULL)
+		return FALSE;
+
+	if (pool->live == 0)
+		return TRUE;
+
+	/* Sort the pages by address, and build a map of the free slots in each
+	 * page by finding the page holding each object on the free list.
+	 */
+
+	pages = malloc(pool->pages * sizeof(struct pool_page *));
+	free_map = calloc(pool->pages * pool->per_page, 1);
+
+	if (pages == NULL || free_map == NULL) {
+		free(pages);
+		free(free_map);
+		return FALSE;
+	}
+
+	for (i = 0, page = pool->page; page != NULL; page = page->next)
+		pages[i++] = page;
+
+	qsort(pages, pool->pages, sizeof(struct pool_page *), pool_compare_pages);
+
+	for (object = pool->free; object != NULL; object = *(void **) object) {
+		low = 0;
+		high = pool->pages;
+
+		while (high - low > 1) {
+			mid = (low + high) / 2;
+
+			if ((char *) object < pages[mid]->objects)
+				high = mid;
+			else
+				low = mid;
+		}
+
+		slot = ((char *) object - pages[low]->objects) / pool->element_size;
+		free_map[low * pool->per_page + slot] = 1;
+	}
+
+	/* Visit every slot which has been handed out and isn't free. */
+
+	for (i = 0; i < pool->pages && complete; i++) {
+		for (slot = 0; slot < pages[i]->used; slot++) {
+			if (free_map[i * pool->per_page + slot])
+				continue;
+
+			if (!callback(pages[i]->objects + slot * pool->element_size, data)) {
+				complete = FALSE;
+				break;
+			}
+		}
+	}
+
+	free(pages);
+	free(free_map);
+
+	return complete;
+}
+
+
+/**
+ * Compare two pages by address, for qsort().
+ *
+ * \param *a		Pointer to the first page pointer.
+ * \param *b		Pointer to the second page pointer.
+ * \return		The result of the comparison.
+ */
+
+static int pool_compare_pages(const void *a, const void *b)
+{
+	char	*page_a = (*(struct pool_page **) a)->objects;
+	char	*page_b = (*(struct pool_page **) b)->objects;
+
+	if (page_a < page_b)
+		return -1;
+
+	return (page_a > page_b) ? 1 : 0;
+}
+
@@ -0,0 +1,145 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: pool.h
+ *
+ * Fixed-size object pools.  Objects of a single size are allocated from
+ * pages holding many objects at once, with freed objects being kept on an
+ * intrusive free list for re-use, so that small records with a high churn
+ * avoid the per-block overheads and fragmentation of the heap.
+ */
+
+#ifndef SFLIB_POOL
+#define SFLIB_POOL
+
+#include <stddef.h>
+#include "oslib/types.h"
+
+/**
+ * An object pool.
+ */
+
+struct pool_block;
+
+/**
+ * Flags controlling the behaviour of an object pool.
+ */
+
+enum pool_flags {
+	POOL_FLAGS_NONE = 0,					/**< No flags set.					*/
+	POOL_FLAGS_ZERO = 1					/**< Clear objects to zero when they are allocated.	*/
+};
+
+/**
+ * Find the alignment required by a type.
+ *
+ * \param type		The type of interest.
+ * \return		The alignment required, in bytes.
+ */
+
+#define POOL_ALIGNMENT(type) offsetof(struct { char c; type t; }, t)
+
+/**
+ * Create a pool for objects of a given type.
+ *
+ * \param type		The type of the objects in the pool.
+ * \param flags		Flags to set for the pool.
+ * \return		Pointer to the new pool, or NULL on failure.
+ */
+
+#define pool_create_for(type, flags) pool_create(sizeof(type), POOL_ALIGNMENT(type), 0, (flags))
+
+
+/**
+ * Create a new object pool.
+ *
+ * \param element_size	The size of each object, in bytes.
+ * \param alignment	The alignment required by the objects, which must
+ *			be a power of 2, or 0 for the default.
+ * \param per_page	The number of objects to allocate in each page, or
+ *			0 to use a default based on the object size.
+ * \param flags		Flags to set for the pool.
+ * \return		Pointer to the new pool, or NULL on failure.
+ */
+
+struct pool_block *pool_create(size_t element_size, size_t alignment, size_t per_page, enum pool_flags flags);
+
+
+/**
+ * Destroy an object pool, releasing all of its pages and any objects which
+ * are still allocated from it.
+ *
+ * \param *pool		The pool to destroy.
+ */
+
+void pool_destroy(struct pool_block *pool);
+
+
+/**
+ * Allocate an object from a pool.
+ *
+ * \param *pool		The pool to allocate from.
+ * \return		Pointer to the new object, or NULL on failure.
+ */
+
+void *pool_alloc(struct pool_block *pool);
+
+
+/**
+ * Return an object to the pool which it was allocated from.
+ *
+ * \param *pool		The pool which the object came from.
+ * \param *object	The object to free, or NULL.
+ */
+
+void pool_free(struct pool_block *pool, void *object);
+
+
+/**
+ * Return the number of objects currently allocated from a pool.
+ *
+ * \param *pool		The pool of interest.
+ * \return		The number of live objects.
+ */
+
+size_t pool_count(struct pool_block *pool);
+
+
+/**
+ * Call a function for each of the objects currently allocated from a pool.
+ * The function may free the object that it is passed, but must not
+ * allocate new objects from the pool.
+ *
+ * \param *pool		The pool to iterate over.
+ * \param *callback	The function to call for each object, which should
+ *			return FALSE to stop the iteration.
+ * \param *data		Client data to pass to the function.
+ * \return		TRUE if all of the objects were visited; FALSE if the
+ *			iteration was stopped or failed.
+ */
+
+osbool pool_iterate(struct pool_block *pool, osbool (*callback)(void *object, void *data), void *data);
+
+#endif
+
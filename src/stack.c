@@ -24,19 +24,18 @@
 /**
  * \file: stack.c
  *
- * Simplistic integer stack implementation.
+ * Simplistic integer stack implementation, as a wrapper around a single
+ * growable stack from the containers module.
  */
 
 /* SFLib header files. */
 
 #include "stack.h"
+#include "container.h"
 
 
-#define STACK_SIZE 200								/**< The stack size.		*/
-
-
-static int	stack[STACK_SIZE];						/**< The stack data.		*/
-static int	ptr = 0;							/**< The stack pointer.		*/
+static struct container_stack	stack;						/**< The stack data.				*/
+static osbool			stack_initialised = FALSE;			/**< TRUE if the stack has been initialised.	*/
 
 
 /* Push a value on to the stack.
@@ -46,8 +45,12 @@ static int	ptr = 0;							/**< The stack pointer.		*/
 
 void stack_push(int val)
 {
-	if (ptr < STACK_SIZE)
-		stack[ptr++] = val;
+	if (!stack_initialised) {
+		container_stack_init(&stack, sizeof(int), NULL, NULL);
+		stack_initialised = TRUE;
+	}
+
+	container_stack_push(&stack, &val);
 }
 
 
@@ -60,8 +63,8 @@ int stack_pull(void)
 {
 	int	val = 0;
 
-	if (ptr > 0)
-		val = stack[--ptr];
+	if (stack_initialised)
+		container_stack_pull(&stack, &val);
 
 	return val;
 }
@@ -74,11 +77,10 @@ int stack_pull(void)
 
 int stack_pop(void)
 {
-	int	val = 0;
+	int	*top = NULL;
 
-	if (ptr > 0)
-		val = stack[ptr-1];
+	if (stack_initialised)
+		top = container_stack_top(&stack);
 
-	return val;
+	return (top != NULL) ? *top : 0;
 }
-
@@ -24,14 +24,16 @@
 /**
  * \file: stack.h
  *
- * Simplistic integer stack implementation.
+ * Simplistic integer stack implementation.  The stack grows as required;
+ * for multiple stacks, or stacks of other types, see container.h.
  */
 
 #ifndef SFLIB_STACK
 #define SFLIB_STACK
 
 /**
- * Push a value on to the stack.
+ * Push a value on to the stack.  The value is only lost if memory can't be
+ * claimed to hold it.
  *
  * \param val		The value to push on to the stack.
  */
@@ -27,10 +27,20 @@
  * Generic and RISC OS-specific string handling functions.
  */
 
+#ifndef SFLIB_HOST
+
 /* OS-Lib header files. */
 
 #include "oslib/os.h"
 
+#else
+
+/* The lowest printable character, as defined by OSLib. */
+
+#define os_VDU_SPACE 32
+
+#endif
+
 /* SF-Lib header files. */
 
 #include "general.h"
@@ -45,6 +55,167 @@
 #include <ctype.h>
 #include <string.h>
 
+/* Vector extensions, where the compiler supports them. */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define STRING_CTRL_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define STRING_CTRL_NEON
+#endif
+
+/**
+ * A machine word, for scanning strings a word at a time.  GCC needs to be
+ * told that these can alias the bytes of the strings being scanned.
+ */
+
+#ifdef __GNUC__
+typedef unsigned long __attribute__((__may_alias__)) string_word;
+#else
+typedef unsigned long string_word;
+#endif
+
+/**
+ * A word with every byte set to 0x01.
+ */
+
+#define STRING_WORD_ONES (~0UL / 255)
+
+/**
+ * A word with the top bit of every byte set.
+ */
+
+#define STRING_WORD_HIGHS (STRING_WORD_ONES * 0x80)
+
+/**
+ * Test a word for any byte below os_VDU_SPACE.  Borrows between bytes can
+ * flag bytes after the first control character, but never before it, and
+ * the result is never zero if a control character is present.
+ */
+
+#define STRING_WORD_HAS_CTRL(w) (((w) - (STRING_WORD_ONES * os_VDU_SPACE)) & ~(w) & STRING_WORD_HIGHS)
+
+/**
+ * The size of the blocks in which strings are scanned for control characters.
+ */
+
+#if defined(STRING_CTRL_SSE2) || defined(STRING_CTRL_NEON)
+#define STRING_CTRL_BLOCK 16
+#else
+#define STRING_CTRL_BLOCK (sizeof(string_word))
+#endif
+
+/**
+ * The number of bits used for each byte in the masks returned by
+ * string_ctrl_block(): SSE2 gives one bit per byte, and NEON four.
+ */
+
+#if defined(STRING_CTRL_SSE2)
+#define STRING_CTRL_MASK_BITS 1
+#elif defined(STRING_CTRL_NEON)
+#define STRING_CTRL_MASK_BITS 4
+#endif
+
+/**
+ * Reading whole aligned blocks can run past the end of a string's memory
+ * allocation, which is safe but looks like an overflow to AddressSanitizer,
+ * so the scanner is left out of its checks on sanitised host builds.
+ */
+
+#if defined(__SANITIZE_ADDRESS__)
+#define STRING_CTRL_UNSANITISED __attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define STRING_CTRL_UNSANITISED __attribute__((no_sanitize_address))
+#endif
+#endif
+
+#ifndef STRING_CTRL_UNSANITISED
+#define STRING_CTRL_UNSANITISED
+#endif
+
+/**
+ * A compiled wildcard pattern.  The failure table and then the pattern
+ * text follow the structure in the same block.
+ */
+
+struct string_pattern {
+	osbool		any_case;		/**< TRUE if the pattern is case-insensitive.			*/
+	osbool		wildcards;		/**< TRUE if the pattern contains any wildcards.		*/
+	size_t		length;			/**< The length of the pattern text.				*/
+	size_t		min_length;		/**< The shortest string which could match the pattern.	*/
+	size_t		*failure;		/**< The KMP failure table for each segment between stars.	*/
+	char		*text;			/**< The pattern, folded if required, with runs of * merged.	*/
+};
+
+/**
+ * A compiled needle for case-insensitive substring searches, using the
+ * Boyer-Moore-Horspool algorithm.
+ */
+
+struct string_needle {
+	size_t		length;			/**< The length of the needle.					*/
+	unsigned char	*text;			/**< The needle; case is folded during comparisons.		*/
+	unsigned char	skip[256];		/**< The shift for each folded character ending a window.	*/
+};
+
+/**
+ * The largest shift held in a needle's skip table.  Longer needles are
+ * clamped, which costs extra comparisons but keeps the table small
+ * enough to build on the stack for one-off searches.
+ */
+
+#define STRING_NEEDLE_MAX_SKIP 255
+
+/**
+ * The size of the chunks in which string_nocase_strstr() measures and
+ * searches a string, unless the needle is longer.
+ */
+
+#define STRING_NEEDLE_CHUNK 1024
+
+/**
+ * The initial buffer size for growable string builders.
+ */
+
+#define STRING_BUILDER_INITIAL_SIZE 64
+
+/**
+ * Case-folding table for case-insensitive comparisons.
+ */
+
+static unsigned char string_fold_any_case[256];
+
+/**
+ * Identity table for case-sensitive comparisons.
+ */
+
+static unsigned char string_fold_exact[256];
+
+/**
+ * TRUE if the folding tables have been initialised.
+ */
+
+static osbool string_fold_ready = FALSE;
+
+
+/* Static Function Prototypes. */
+
+static size_t string_ctrl_scan(const char *s, size_t limit);
+#if defined(STRING_CTRL_SSE2) || defined(STRING_CTRL_NEON)
+static unsigned long long string_ctrl_block(const unsigned char *block);
+#endif
+static void string_initialise_fold_tables(void);
+static osbool string_builder_reserve(struct string_builder *builder, size_t extra);
+static void *string_builder_heap_allocator(void *context, void *block, size_t old_size, size_t new_size);
+static void string_needle_prepare(struct string_needle *needle, char *text, size_t length);
+static char *string_needle_scan(struct string_needle *needle, char *text, size_t length);
+static osbool string_pattern_run(char *pattern, char *string, unsigned char *fold);
+static void string_pattern_prepare(struct string_pattern *pattern);
+static char *string_pattern_find(struct string_pattern *pattern, size_t segment, size_t length, char *string, char *limit, unsigned char *fold);
+static osbool string_pattern_compare(char *segment, size_t length, char *string, unsigned char *fold);
+
 
 /* Perform a strncpy(), sanity-checking the supplied pointer details and
  * ensuring that the copy is zero-terminated even if the source string
@@ -121,17 +292,12 @@ int string_printf(char *str, size_t len, char *cntrl_string, ...)
 
 char *string_ctrl_zero_terminate(char *s1, size_t len)
 {
-	char *s = s1;
-
 	if (s1 == NULL || len == 0)
 		return NULL;
 
-	while (*s1 >= os_VDU_SPACE && --len > 0)
-		s1++;
-
-	*s1 = '\0';
+	s1[string_ctrl_scan(s1, len - 1)] = '\0';
 
-	return s;
+	return s1;
 }
 
 
@@ -142,19 +308,17 @@ char *string_ctrl_zero_terminate(char *s1, size_t len)
 
 char *string_ctrl_strncpy(char *s1, const char *s2, size_t len)
 {
-	size_t i = 0;
-	char *s = s1;
+	size_t	copy;
 
 	if (s1 == NULL)
 		return NULL;
 
-	while (*s2 >= os_VDU_SPACE && i++ < len)
-		*s1++ = *s2++;
+	copy = string_ctrl_scan(s2, len);
 
-	while (i++ < len)
-		*s1++ = '\0';
+	memcpy(s1, s2, copy);
+	memset(s1 + copy, '\0', len - copy);
 
-	return s;
+	return s1;
 }
 
 
@@ -165,20 +329,19 @@ char *string_ctrl_strncpy(char *s1, const char *s2, size_t len)
 
 char *string_ctrl_strncat(char *s1, const char *s2, size_t len)
 {
-	char	*s = s1;
+	char	*end;
+	size_t	copy;
 
 	if (s1 == NULL)
 		return NULL;
 
-	while (*s1 >= os_VDU_SPACE)
-		s1++;
-
-	while (*s2 >= os_VDU_SPACE && len-- > 0)
-		*s1++ = *s2++;
+	end = s1 + string_ctrl_scan(s1, (size_t) -1);
+	copy = string_ctrl_scan(s2, len);
 
-	*s1 = '\0';
+	memcpy(end, s2, copy);
+	end[copy] = '\0';
 
-	return s;
+	return s1;
 }
 
 
@@ -189,14 +352,118 @@ char *string_ctrl_strncat(char *s1, const char *s2, size_t len)
 
 size_t string_ctrl_strlen(char *s)
 {
-	int	len = 0;
+	return string_ctrl_scan(s, (size_t) -1);
+}
+
+
+/**
+ * Find the first control character in a string, looking at no more than
+ * a given number of bytes.
+ *
+ * The string is scanned an aligned block at a time: using SSE2 or NEON if
+ * the compiler supports them, or a word at a time otherwise.  Aligned
+ * blocks can never cross a page boundary, so reading beyond either end of
+ * the string within the first and last blocks is safe.
+ *
+ * \param *s			The string to scan.
+ * \param limit			The maximum number of bytes to scan.
+ * \return			The offset of the first control character, or
+ *				limit if there is none within the limit.
+ */
 
-	while (*s++ >= os_VDU_SPACE)
-		len++;
+#if defined(STRING_CTRL_SSE2) || defined(STRING_CTRL_NEON)
 
-	return (size_t) len;
+STRING_CTRL_UNSANITISED static size_t string_ctrl_scan(const char *s, size_t limit)
+{
+	const unsigned char	*p = (const unsigned char *) s;
+	size_t			offset, block, next;
+	unsigned long long	mask;
+
+	/* The first block is read from its aligned start, and the flags for
+	 * any bytes before the string shifted away.
+	 */
+
+	offset = ((size_t) p) & (STRING_CTRL_BLOCK - 1);
+	mask = string_ctrl_block(p - offset) >> (offset * STRING_CTRL_MASK_BITS);
+
+	block = 0;
+	next = STRING_CTRL_BLOCK - offset;
+
+	/* Skip whole blocks which contain no control characters. */
+
+	while (mask == 0 && next < limit) {
+		block = next;
+		mask = string_ctrl_block(p + block);
+		next += STRING_CTRL_BLOCK;
+	}
+
+	if (mask == 0)
+		return limit;
+
+	/* The lowest flag marks the first control character in the block. */
+
+	block += __builtin_ctzll(mask) / STRING_CTRL_MASK_BITS;
+
+	return (block < limit) ? block : limit;
+}
+
+
+/**
+ * Test an aligned block of STRING_CTRL_BLOCK bytes for control characters.
+ *
+ * \param *block		The block to test.
+ * \return			A mask holding STRING_CTRL_MASK_BITS set bits for
+ *				each control character, with the first byte
+ *				of the block in the lowest bits; or zero if
+ *				there are none.
+ */
+
+STRING_CTRL_UNSANITISED static unsigned long long string_ctrl_block(const unsigned char *block)
+{
+#if defined(STRING_CTRL_SSE2)
+	__m128i		bytes = _mm_load_si128((const __m128i *) block);
+
+	return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(os_VDU_SPACE - 1)), bytes));
+#else
+	uint8x8_t	flags;
+
+	flags = vshrn_n_u16(vreinterpretq_u16_u8(vcltq_u8(vld1q_u8(block), vdupq_n_u8(os_VDU_SPACE))), 4);
+
+	return vget_lane_u64(vreinterpret_u64_u8(flags), 0);
+#endif
 }
 
+#else
+
+STRING_CTRL_UNSANITISED static size_t string_ctrl_scan(const char *s, size_t limit)
+{
+	const unsigned char	*p = (const unsigned char *) s;
+	size_t			i = 0;
+
+	/* Bytes before the first aligned word are checked one at a time. */
+
+	while (i < limit && (((size_t) (p + i)) & (STRING_CTRL_BLOCK - 1)) != 0) {
+		if (p[i] < os_VDU_SPACE)
+			return i;
+
+		i++;
+	}
+
+	/* Skip whole words which contain no control characters. */
+
+	while (i < limit && STRING_WORD_HAS_CTRL(*((const string_word *) (p + i))) == 0)
+		i += STRING_CTRL_BLOCK;
+
+	/* Find the control character within the final word. */
+
+	while (i < limit && p[i] >= os_VDU_SPACE)
+		i++;
+
+	return (i < limit) ? i : limit;
+}
+
+#endif
+
 
 /* Convert a string to upper case.
  *
@@ -238,50 +505,341 @@ char *string_tolower(char *string)
 }
 
 
-/**
- * Compare two strings to see if they match. One string can contain
+/* Compare two strings to see if they match. One string can contain
  * the wildards # for any single character and * for any zero or
  * more characters.  The comparison can be case-insensitive if required.
  *
- * \param *s1		The string to search for, with wildcards.
- * \param *s2		The string to test.
- * \param any_case	TRUE for a case-insensitive search; else FALSE.
- * \return		TRUE if the strings match; else FALSE.
+ * This is an external interface, documented in string.h
  */
 
 osbool string_wildcard_compare(char *s1, char *s2, osbool any_case)
 {
-	char c1 = *s1, c2 = *s2;
+	if (s1 == NULL || s2 == NULL)
+		return FALSE;
+
+	if (!string_fold_ready)
+		string_initialise_fold_tables();
+
+	return string_pattern_run(s1, s2, (any_case) ? string_fold_any_case : string_fold_exact);
+}
+
+
+/* Compile a wildcard pattern, ready to be matched against strings.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+struct string_pattern *string_pattern_compile(char *pattern, osbool any_case)
+{
+	struct string_pattern	*compiled;
+	unsigned char		*fold;
+	size_t			length;
+	char			*out;
+
+	if (pattern == NULL)
+		return NULL;
+
+	if (!string_fold_ready)
+		string_initialise_fold_tables();
+
+	length = strlen(pattern);
+
+	compiled = malloc(sizeof(struct string_pattern) + (length * sizeof(size_t)) + length + 1);
+	if (compiled == NULL)
+		return NULL;
+
+	compiled->any_case = any_case;
+	compiled->wildcards = FALSE;
+	compiled->min_length = 0;
+	compiled->failure = (size_t *) (compiled + 1);
+	compiled->text = (char *) (compiled->failure + length);
+
+	fold = (any_case) ? string_fold_any_case : string_fold_exact;
+
+	/* Fold the pattern in advance, and merge runs of * as they add nothing. */
+
+	for (out = compiled->text; *pattern != '\0'; pattern++) {
+		if (*pattern == '*' || *pattern == '#')
+			compiled->wildcards = TRUE;
+
+		if (*pattern == '*' && out > compiled->text && *(out - 1) == '*')
+			continue;
+
+		if (*pattern != '*')
+			compiled->min_length++;
+
+		*out++ = fold[(unsigned char) *pattern];
+	}
+
+	*out = '\0';
+	compiled->length = out - compiled->text;
+
+	string_pattern_prepare(compiled);
+
+	return compiled;
+}
+
+
+/* Test a string against a compiled wildcard pattern.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+osbool string_pattern_match(struct string_pattern *pattern, char *string)
+{
+	unsigned char	*fold;
+	size_t		i, first, last, start, end;
+	char		*limit;
+
+	if (pattern == NULL || string == NULL)
+		return FALSE;
+
+	fold = (pattern->any_case) ? string_fold_any_case : string_fold_exact;
+
+	/* Patterns without wildcards only need a straight comparison. */
+
+	if (!pattern->wildcards) {
+		for (i = 0; i < pattern->length; i++) {
+			if ((char) fold[(unsigned char) string[i]] != pattern->text[i])
+				return FALSE;
+		}
+
+		return (string[i] == '\0') ? TRUE : FALSE;
+	}
+
+	/* Reject strings which are too short to match, without trying. */
+
+	for (i = 0; i < pattern->min_length; i++) {
+		if (string[i] == '\0')
+			return FALSE;
+	}
+
+	/* Find the segments before the first * and after the last one. */
+
+	for (first = 0; first < pattern->length && pattern->text[first] != '*'; first++);
+
+	if (first == pattern->length)
+		return (string[first] == '\0' && string_pattern_compare(pattern->text, first, string, fold)) ? TRUE : FALSE;
+
+	for (last = pattern->length; pattern->text[last - 1] != '*'; last--);
+
+	/* The segments either side of the stars are anchored to the ends of the
+	 * string, and the minimum length check ensures that they can't overlap.
+	 */
+
+	limit = string + i + strlen(string + i) - (pattern->length - last);
+
+	if (!string_pattern_compare(pattern->text, first, string, fold) ||
+			!string_pattern_compare(pattern->text + last, pattern->length - last, limit, fold))
+		return FALSE;
+
+	/* Place each of the remaining segments as early as possible in the
+	 * string, after the one before.  The stars can take up anything in
+	 * between, so if a segment can't be placed, the string can't match.
+	 */
+
+	string += first;
+
+	for (start = first + 1; start < last; start = end + 1) {
+		for (end = start; pattern->text[end] != '*'; end++);
+
+		string = string_pattern_find(pattern, start, end - start, string, limit, fold);
+		if (string == NULL)
+			return FALSE;
+
+		string += end - start;
+	}
+
+	return TRUE;
+}
+
+
+/* Free a compiled wildcard pattern.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+void string_pattern_destroy(struct string_pattern *pattern)
+{
+	free(pattern);
+}
+
+
+/**
+ * Initialise the case-folding tables.
+ */
+
+static void string_initialise_fold_tables(void)
+{
+	int	i;
 
-	if (any_case) {
-		c1 = tolower(c1);
-		c2 = tolower(c2);
+	for (i = 0; i < 256; i++) {
+		string_fold_exact[i] = i;
+		string_fold_any_case[i] = tolower(i);
 	}
 
-	if (c2 == 0) {
-		while (*s1 == '*')
-			s1++;
-		return (*s1 == 0);
+	string_fold_ready = TRUE;
+}
+
+
+/**
+ * Build the KMP failure table for each of the segments between the stars
+ * in a compiled pattern.  The entry for each character holds the length of
+ * the longest proper prefix of its segment which is also a suffix of the
+ * segment up to and including that character.  Entries for segments
+ * containing # are built, but never used.
+ *
+ * \param *pattern		The pattern to prepare.
+ */
+
+static void string_pattern_prepare(struct string_pattern *pattern)
+{
+	size_t	start = 0, i, border;
+	char	*text = pattern->text;
+
+	while (start < pattern->length) {
+		if (text[start] == '*') {
+			pattern->failure[start++] = 0;
+			continue;
+		}
+
+		pattern->failure[start] = 0;
+		border = 0;
+
+		for (i = start + 1; i < pattern->length && text[i] != '*'; i++) {
+			while (border > 0 && text[i] != text[start + border])
+				border = pattern->failure[start + border - 1];
+
+			if (text[i] == text[start + border])
+				border++;
+
+			pattern->failure[i] = border;
+		}
+
+		start = i;
 	}
+}
 
-	if (c1 == c2 || c1 == '#')
-		return string_wildcard_compare(&s1[1], &s2[1], any_case);
 
-	if (c1 == '*') {
-		osbool ok = FALSE;
+/**
+ * Find the first place in a string where a segment of a compiled pattern
+ * matches.  Segments without # are found using their KMP failure tables,
+ * in time proportional to the length of the string searched; those with
+ * # are tried at each position in turn.
+ *
+ * \param *pattern		The compiled pattern.
+ * \param segment		The offset of the segment in the pattern.
+ * \param length		The length of the segment.
+ * \param *string		The start of the string to search.
+ * \param *limit		The point in the string which the match must
+ *				not extend beyond.
+ * \param *fold			The case-folding table to apply to the string.
+ * \return			Pointer to the match, or NULL if none was found.
+ */
 
-		if (s1[1] == 0)
-			return TRUE;
+static char *string_pattern_find(struct string_pattern *pattern, size_t segment, size_t length, char *string, char *limit, unsigned char *fold)
+{
+	char	*text = pattern->text + segment;
+	size_t	*failure = pattern->failure + segment, matched = 0;
 
-		while (!ok && *s2 != 0) {
-			ok = ok || string_wildcard_compare(&s1[1], s2, any_case);
-			s2++;
+	if (memchr(text, '#', length) != NULL) {
+		for (; string + length <= limit; string++) {
+			if (string_pattern_compare(text, length, string, fold))
+				return string;
 		}
 
-		return ok;
+		return NULL;
+	}
+
+	for (; string < limit; string++) {
+		while (matched > 0 && (char) fold[(unsigned char) *string] != text[matched])
+			matched = failure[matched - 1];
+
+		if ((char) fold[(unsigned char) *string] == text[matched])
+			matched++;
+
+		if (matched == length)
+			return string + 1 - length;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Compare a segment of a compiled pattern, which may contain # but not *,
+ * with the start of a string.  The string must be at least as long as the
+ * segment.
+ *
+ * \param *segment		The segment of the pattern, already folded.
+ * \param length		The length of the segment.
+ * \param *string		The string to compare.
+ * \param *fold			The case-folding table to apply to the string.
+ * \return			TRUE if the segment matches; else FALSE.
+ */
+
+static osbool string_pattern_compare(char *segment, size_t length, char *string, unsigned char *fold)
+{
+	size_t	i;
+
+	for (i = 0; i < length; i++) {
+		if (segment[i] != '#' && segment[i] != (char) fold[(unsigned char) string[i]])
+			return FALSE;
 	}
 
-	return FALSE;
+	return TRUE;
+}
+
+
+/**
+ * Match a string against a wildcard pattern, without recursion.  Each *
+ * is matched as little as possible at first; if a later part of the
+ * pattern fails, the most recent * is extended by one character and the
+ * rest of the pattern tried again.  Only the most recent * ever needs to
+ * be extended, so the search takes at most O(n.m) steps, however many
+ * stars the pattern contains.  This serves one-off comparisons, which
+ * have nowhere to keep the failure tables used by string_pattern_match().
+ *
+ * \param *pattern		The pattern to match, with wildcards.
+ * \param *string		The string to test.
+ * \param *fold			The case-folding table to apply to both.
+ * \return			TRUE if the string matches; else FALSE.
+ */
+
+static osbool string_pattern_run(char *pattern, char *string, unsigned char *fold)
+{
+	char	*star = NULL, *resume = NULL;
+
+	while (*string != '\0') {
+		if (*pattern == '*') {
+			while (*pattern == '*')
+				pattern++;
+
+			if (*pattern == '\0')
+				return TRUE;
+
+			star = pattern;
+			resume = string;
+			continue;
+		}
+
+		if (*pattern != '\0' && (*pattern == '#' || fold[(unsigned char) *pattern] == fold[(unsigned char) *string])) {
+			pattern++;
+			string++;
+			continue;
+		}
+
+		if (star == NULL)
+			return FALSE;
+
+		pattern = star;
+		string = ++resume;
+	}
+
+	while (*pattern == '*')
+		pattern++;
+
+	return (*pattern == '\0') ? TRUE : FALSE;
 }
 
 
@@ -312,24 +870,483 @@ int string_nocase_strcmp(char *s1, char *s2)
 
 char *string_nocase_strstr(char *s1, char *s2)
 {
-	char	*s1c, *s2c;
+	struct string_needle	needle;
+	size_t			needle_length, chunk, from = 0, measured = 0;
+	char			*end, *match;
 
-	while (*s1 != '\0') {
-		s1c = s1;
-		s2c = s2;
+	needle_length = strlen(s2);
+	if (needle_length == 0)
+		return s1;
 
-		while (*s1c != '\0' && *s2c != '\0' && toupper(*s1c) == toupper(*s2c)) {
-			s1c++;
-			s2c++;
-		}
+	string_needle_prepare(&needle, s2, needle_length);
 
-		if (*s2c == '\0')
-			break;
+	/* Measure and search the string a chunk at a time, so that a match
+	 * near the start is found without reading the rest of a long string.
+	 * Each search overlaps the last by one byte less than the needle, so
+	 * that matches spanning two chunks are still found.
+	 */
 
-		s1++;
+	chunk = (needle_length > STRING_NEEDLE_CHUNK) ? needle_length : STRING_NEEDLE_CHUNK;
+
+	do {
+		end = memchr(s1 + measured, '\0', chunk);
+		measured = (end != NULL) ? (size_t) (end - s1) : measured + chunk;
+
+		match = string_needle_scan(&needle, s1 + from, measured - from);
+		if (match != NULL)
+			return match;
+
+		if (measured >= needle_length)
+			from = measured - needle_length + 1;
+	} while (end == NULL);
+
+	return end;
+}
+
+
+/* Compile a needle for repeated case-insensitive substring searches.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+struct string_needle *string_needle_compile(char *text)
+{
+	struct string_needle	*needle;
+	size_t			length;
+
+	if (text == NULL)
+		return NULL;
+
+	length = strlen(text);
+
+	needle = malloc(sizeof(struct string_needle) + length + 1);
+	if (needle == NULL)
+		return NULL;
+
+	memcpy(needle + 1, text, length + 1);
+	string_needle_prepare(needle, (char *) (needle + 1), length);
+
+	return needle;
+}
+
+
+/* Search some text for a compiled needle, ignoring case.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+char *string_needle_find(struct string_needle *needle, char *text, size_t length)
+{
+	if (needle == NULL || text == NULL)
+		return NULL;
+
+	return string_needle_scan(needle, text, length);
+}
+
+
+/* Free a compiled needle.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+void string_needle_destroy(struct string_needle *needle)
+{
+	free(needle);
+}
+
+
+/* Start a search for all of the occurrences of a needle in some text.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+void string_search_start(struct string_search *search, struct string_needle *needle, char *text, size_t length)
+{
+	if (search == NULL)
+		return;
+
+	search->needle = needle;
+	search->text = text;
+	search->length = (text != NULL) ? length : 0;
+	search->position = 0;
+}
+
+
+/* Find the next occurrence of a needle in a search.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+char *string_search_next(struct string_search *search)
+{
+	char	*match;
+
+	if (search == NULL || search->needle == NULL || search->text == NULL || search->position > search->length)
+		return NULL;
+
+	match = string_needle_scan(search->needle, search->text + search->position, search->length - search->position);
+
+	/* The next search starts one character on, so that overlapping matches are found. */
+
+	if (match != NULL)
+		search->position = (match - search->text) + 1;
+	else
+		search->position = search->length + 1;
+
+	return match;
+}
+
+
+/* Initialise a string builder.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+void string_builder_init(struct string_builder *builder, char *buffer, size_t size)
+{
+	if (builder == NULL)
+		return;
+
+	builder->length = 0;
+	builder->truncated = FALSE;
+
+	if (buffer != NULL && size > 0) {
+		builder->text = buffer;
+		builder->size = size;
+		builder->allocator = NULL;
+		builder->context = NULL;
+		*buffer = '\0';
+	} else {
+		builder->text = NULL;
+		builder->size = 0;
+		builder->allocator = string_builder_heap_allocator;
+		builder->context = NULL;
 	}
+}
 
-	return s1;
+
+/* Initialise a string builder whose storage is claimed from a custom
+ * allocator.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+void string_builder_init_allocator(struct string_builder *builder, string_builder_allocator allocator, void *context)
+{
+	if (builder == NULL)
+		return;
+
+	builder->text = NULL;
+	builder->length = 0;
+	builder->size = 0;
+	builder->truncated = FALSE;
+	builder->allocator = (allocator != NULL) ? allocator : string_builder_heap_allocator;
+	builder->context = context;
+}
+
+
+/* Empty a string builder, keeping its storage for re-use.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+void string_builder_reset(struct string_builder *builder)
+{
+	if (builder == NULL)
+		return;
+
+	builder->length = 0;
+	builder->truncated = FALSE;
+
+	if (builder->text != NULL)
+		*builder->text = '\0';
+}
+
+
+/* Release any storage claimed by a string builder.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+void string_builder_free(struct string_builder *builder)
+{
+	if (builder == NULL)
+		return;
+
+	if (builder->allocator != NULL && builder->text != NULL)
+		builder->allocator(builder->context, builder->text, builder->size, 0);
+
+	if (builder->allocator != NULL) {
+		builder->text = NULL;
+		builder->size = 0;
+	}
+
+	string_builder_reset(builder);
+}
+
+
+/* Append a block of text to a string builder.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+osbool string_builder_append_length(struct string_builder *builder, const char *text, size_t length)
+{
+	osbool	complete = TRUE;
+
+	if (builder == NULL || text == NULL)
+		return FALSE;
+
+	/* Fixed buffers, and those which can't be grown, take as much as
+	 * will fit.  A builder without any storage can take nothing.
+	 */
+
+	if (!string_builder_reserve(builder, length)) {
+		builder->truncated = TRUE;
+
+		if (builder->size == 0)
+			return FALSE;
+
+		length = builder->size - 1 - builder->length;
+		complete = FALSE;
+	}
+
+	memcpy(builder->text + builder->length, text, length);
+	builder->length += length;
+	builder->text[builder->length] = '\0';
+
+	return complete;
+}
+
+
+/* Append a string to a string builder.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+osbool string_builder_append(struct string_builder *builder, const char *text)
+{
+	if (text == NULL)
+		return FALSE;
+
+	return string_builder_append_length(builder, text, strlen(text));
+}
+
+
+/* Append a NULL-terminated list of strings to a string builder.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+osbool string_builder_append_strings(struct string_builder *builder, ...)
+{
+	va_list		ap;
+	const char	*text;
+	osbool		complete = TRUE;
+
+	va_start(ap, builder);
+
+	while ((text = va_arg(ap, const char *)) != NULL) {
+		if (!string_builder_append(builder, text))
+			complete = FALSE;
+	}
+
+	va_end(ap);
+
+	return complete;
+}
+
+
+/* Append a single character to a string builder.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+osbool string_builder_append_char(struct string_builder *builder, char c)
+{
+	return string_builder_append_length(builder, &c, 1);
+}
+
+
+/* Append a signed decimal integer to a string builder.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+osbool string_builder_append_int(struct string_builder *builder, int value)
+{
+	char		digits[sizeof(int) * 3 + 2];
+	size_t		length = sizeof(digits);
+	unsigned	magnitude;
+
+	/* Work on the magnitude as unsigned, so that INT_MIN is safe. */
+
+	magnitude = (value < 0) ? 0u - (unsigned) value : (unsigned) value;
+
+	do {
+		digits[--length] = '0' + (magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+
+	if (value < 0)
+		digits[--length] = '-';
+
+	return string_builder_append_length(builder, digits + length, sizeof(digits) - length);
+}
+
+
+/* Append an unsigned hexadecimal integer to a string builder.
+ *
+ * This is an external interface, documented in string.h
+ */
+
+osbool string_builder_append_hex(struct string_builder *builder, unsigned value, int digits, osbool upper)
+{
+	char	text[sizeof(unsigned) * 2];
+	char	*set = (upper) ? "0123456789ABCDEF" : "0123456789abcdef";
+	size_t	length = sizeof(text);
+
+	if (digits > (int) sizeof(text))
+		digits = sizeof(text);
+
+	do {
+		text[--length] = set[value & 0xf];
+		value >>= 4;
+	} while (value != 0 || (int) (sizeof(text) - length) < digits);
+
+	return string_builder_append_length(builder, text + length, sizeof(text) - length);
+}
+
+
+/**
+ * Make sure that a string builder has space for some more characters plus
+ * a terminator, growing its storage if possible.
+ *
+ * \param *builder		The builder to check.
+ * \param extra			The number of characters to be added.
+ * \return			TRUE if there is space; else FALSE.
+ */
+
+static osbool string_builder_reserve(struct string_builder *builder, size_t extra)
+{
+	size_t	size;
+	char	*text;
+
+	if (builder->size > 0 && extra < builder->size - builder->length)
+		return TRUE;
+
+	if (builder->allocator == NULL)
+		return FALSE;
+
+	/* Grow the storage geometrically, so that appends take amortised constant time. */
+
+	size = (builder->size > 0) ? builder->size : STRING_BUILDER_INITIAL_SIZE;
+
+	while (size - builder->length <= extra) {
+		if (size > ((size_t) -1) / 2)
+			return FALSE;
+
+		size *= 2;
+	}
+
+	text = builder->allocator(builder->context, builder->text, builder->size, size);
+	if (text == NULL)
+		return FALSE;
+
+	if (builder->text == NULL)
+		*text = '\0';
+
+	builder->text = text;
+	builder->size = size;
+
+	return TRUE;
+}
+
+
+/**
+ * The default allocator for growable string builders, using realloc().
+ *
+ * \param *context		Unused.
+ * \param *block		The current block, or NULL.
+ * \param old_size		The current size of the block.
+ * \param new_size		The required size of the block, or 0 to free it.
+ * \return			Pointer to the resized block, or NULL.
+ */
+
+static void *string_builder_heap_allocator(void *context, void *block, size_t old_size, size_t new_size)
+{
+	(void) context;
+	(void) old_size;
+
+	if (new_size == 0) {
+		free(block);
+		return NULL;
+	}
+
+	return realloc(block, new_size);
+}
+
+
+/**
+ * Prepare a needle for searching, filling in its skip table.
+ *
+ * \param *needle		The needle to prepare.
+ * \param *text			The text to search for, which must remain
+ *				in place while the needle is in use.
+ * \param length		The length of the text.
+ */
+
+static void string_needle_prepare(struct string_needle *needle, char *text, size_t length)
+{
+	size_t	i, shift;
+
+	if (!string_fold_ready)
+		string_initialise_fold_tables();
+
+	needle->text = (unsigned char *) text;
+	needle->length = length;
+
+	/* The last character of a window decides how far it can move on. */
+
+	memset(needle->skip, (length < STRING_NEEDLE_MAX_SKIP) ? length : STRING_NEEDLE_MAX_SKIP, sizeof(needle->skip));
+
+	for (i = 0; i + 1 < length; i++) {
+		shift = length - 1 - i;
+		needle->skip[string_fold_any_case[needle->text[i]]] = (shift < STRING_NEEDLE_MAX_SKIP) ? shift : STRING_NEEDLE_MAX_SKIP;
+	}
+}
+
+
+/**
+ * Search some text for a prepared needle, ignoring case.
+ *
+ * \param *needle		The needle to search for.
+ * \param *text			The text to search.
+ * \param length		The length of the text.
+ * \return			Pointer to the first match, or NULL if not found.
+ */
+
+static char *string_needle_scan(struct string_needle *needle, char *text, size_t length)
+{
+	unsigned char	*haystack = (unsigned char *) text, *fold = string_fold_any_case;
+	size_t		position, last, i;
+
+	if (needle->length == 0)
+		return text;
+
+	if (needle->length > length)
+		return NULL;
+
+	last = needle->length - 1;
+
+	for (position = 0; position <= length - needle->length; position += needle->skip[fold[haystack[position + last]]]) {
+		for (i = last; fold[haystack[position + i]] == fold[needle->text[i]]; i--) {
+			if (i == 0)
+				return text + position;
+		}
+	}
+
+	return NULL;
 }
 
 
@@ -31,7 +31,70 @@
 #define SFLIB_STRING
 
 #include <stddef.h>
+
+/* The string functions can also be built for the host, which doesn't have OSLib. */
+
+#ifdef SFLIB_HOST
+#ifndef SFLIB_HOST_TYPES
+#define SFLIB_HOST_TYPES
+typedef int osbool;
+typedef unsigned char byte;
+#define TRUE 1
+#define FALSE 0
+#endif
+#else
 #include "oslib/types.h"
+#endif
+
+/**
+ * A compiled wildcard pattern.
+ */
+
+struct string_pattern;
+
+/**
+ * A compiled needle for case-insensitive substring searches.
+ */
+
+struct string_needle;
+
+/**
+ * An allocator for the storage of a string builder.  It is called to claim,
+ * grow and release the builder's buffer, in the manner of realloc().
+ *
+ * \param *context		The context supplied with the allocator.
+ * \param *block		The current buffer, or NULL if there isn't one.
+ * \param old_size		The current size of the buffer.
+ * \param new_size		The size required, or 0 to release the buffer.
+ * \return			Pointer to the new buffer, which must contain
+ *				the contents of the old, or NULL on failure.
+ */
+
+typedef void *(*string_builder_allocator)(void *context, void *block, size_t old_size, size_t new_size);
+
+/**
+ * A string builder, for assembling strings a piece at a time.
+ */
+
+struct string_builder {
+	char				*text;				/**< The buffer holding the string, or NULL.		*/
+	size_t				length;				/**< The length of the string.				*/
+	size_t				size;				/**< The size of the buffer.				*/
+	osbool				truncated;			/**< TRUE if anything has been lost from the string.	*/
+	string_builder_allocator	allocator;			/**< The allocator for the buffer, or NULL if fixed.	*/
+	void				*context;			/**< The context for the allocator.			*/
+};
+
+/**
+ * The state of a search for all of the occurrences of a needle.
+ */
+
+struct string_search {
+	struct string_needle	*needle;				/**< The needle being searched for.			*/
+	char			*text;					/**< The text being searched.				*/
+	size_t			length;					/**< The length of the text.				*/
+	size_t			position;				/**< The offset at which to resume the search.		*/
+};
 
 
 /**
@@ -149,6 +212,9 @@ char *string_tolower(char *string);
  * Compare two strings to see if they match. One string can contain
  * the wildards # for any single character and * for any zero or
  * more characters.  The comparison can be case-insensitive if required.
+ * One-off comparisons backtrack, and can take time proportional to the
+ * product of the lengths of the two strings; a pattern which is to be
+ * used more than once should be compiled with string_pattern_compile().
  *
  * \param *s1		The string to search for, with wildcards.
  * \param *s2		The string to test.
@@ -159,6 +225,45 @@ char *string_tolower(char *string);
 osbool string_wildcard_compare(char *s1, char *s2, osbool any_case);
 
 
+/**
+ * Compile a wildcard pattern, using # for any single character and * for
+ * any zero or more characters, ready to be matched against strings by
+ * string_pattern_match().  Compiling a pattern which is to be used more
+ * than once saves folding its case and checking it on every comparison.
+ *
+ * \param *pattern	The pattern to compile.
+ * \param any_case	TRUE for case-insensitive matching; else FALSE.
+ * \return		Pointer to the compiled pattern, or NULL on failure.
+ */
+
+struct string_pattern *string_pattern_compile(char *pattern, osbool any_case);
+
+
+/**
+ * Test a string against a compiled wildcard pattern.  The parts of the
+ * pattern between stars are each searched for once, so that the time taken
+ * is proportional to the length of the string, unless a part containing #
+ * must be searched for: this is tried at each position in turn, and can
+ * take time proportional to the product of the lengths of that part and
+ * the string.
+ *
+ * \param *pattern	The compiled pattern to match against.
+ * \param *string	The string to test.
+ * \return		TRUE if the string matches; else FALSE.
+ */
+
+osbool string_pattern_match(struct string_pattern *pattern, char *string);
+
+
+/**
+ * Free a compiled wildcard pattern.
+ *
+ * \param *pattern	The pattern to free, or NULL.
+ */
+
+void string_pattern_destroy(struct string_pattern *pattern);
+
+
 /**
  * Perform a strcmp() case-insensitively on two strings, returning
  * a value less than, equal to or greater than zero depending on
@@ -175,16 +280,205 @@ int string_nocase_strcmp(char *s1, char *s2);
 /**
  * Perform an strstr() case-insensitively on two strings, searching
  * one string for the other substring and returning a pointer to the
- * found location.
+ * found location.  The string being searched is measured as the search
+ * proceeds, so a match near its start is found without reading the rest.
  *
  * \param *s1		The string to search.
  * \param *s2		The substring to search for.
- * \return		Pointer to the first match, or NULL if not found.
+ * \return		Pointer to the first match, or to the terminator
+ *			of s1 if not found.
  */
 
 char *string_nocase_strstr(char *s1, char *s2);
 
 
+/**
+ * Compile a needle for repeated case-insensitive substring searches, which
+ * use the Boyer-Moore-Horspool algorithm and can skip over much of the
+ * text being searched.
+ *
+ * \param *text		The text to search for.
+ * \return		Pointer to the compiled needle, or NULL on failure.
+ */
+
+struct string_needle *string_needle_compile(char *text);
+
+
+/**
+ * Search some text for a compiled needle, ignoring case.  The text need
+ * not be terminated.
+ *
+ * \param *needle	The needle to search for.
+ * \param *text		The text to search.
+ * \param length	The length of the text.
+ * \return		Pointer to the first match, or NULL if not found.
+ */
+
+char *string_needle_find(struct string_needle *needle, char *text, size_t length);
+
+
+/**
+ * Free a compiled needle.
+ *
+ * \param *needle	The needle to free, or NULL.
+ */
+
+void string_needle_destroy(struct string_needle *needle);
+
+
+/**
+ * Start a search for all of the occurrences of a compiled needle in some
+ * text, which need not be terminated.  The matches are then returned in
+ * turn by string_search_next().
+ *
+ * \param *search	The search block to initialise.
+ * \param *needle	The needle to search for.
+ * \param *text		The text to search.
+ * \param length	The length of the text.
+ */
+
+void string_search_start(struct string_search *search, struct string_needle *needle, char *text, size_t length);
+
+
+/**
+ * Find the next occurrence of a needle in a search started by
+ * string_search_start().  Overlapping occurrences are all returned.
+ *
+ * \param *search	The search block to use.
+ * \return		Pointer to the next match, or NULL if there are
+ *			no more.
+ */
+
+char *string_search_next(struct string_search *search);
+
+
+/**
+ * Initialise a string builder.  If a buffer is supplied, the string is
+ * built in it and truncated if it becomes too long; otherwise the storage
+ * is claimed with malloc() and grown as required, and must be released
+ * with string_builder_free() after use.
+ *
+ * \param *builder	The builder to initialise.
+ * \param *buffer	A buffer to build the string in, or NULL.
+ * \param size		The size of the buffer.
+ */
+
+void string_builder_init(struct string_builder *builder, char *buffer, size_t size);
+
+
+/**
+ * Initialise a string builder whose storage is claimed from a custom
+ * allocator, such as an arena, and grown as required.  The storage must
+ * be released with string_builder_free() after use.
+ *
+ * \param *builder	The builder to initialise.
+ * \param allocator	The allocator to use, or NULL for malloc().
+ * \param *context	A context to pass to the allocator.
+ */
+
+void string_builder_init_allocator(struct string_builder *builder, string_builder_allocator allocator, void *context);
+
+
+/**
+ * Empty a string builder, keeping its storage for re-use.
+ *
+ * \param *builder	The builder to reset.
+ */
+
+void string_builder_reset(struct string_builder *builder);
+
+
+/**
+ * Release any storage claimed by a string builder, leaving it empty.
+ *
+ * \param *builder	The builder to free.
+ */
+
+void string_builder_free(struct string_builder *builder);
+
+
+/**
+ * Append a block of text, which need not be terminated, to a string
+ * builder.
+ *
+ * \param *builder	The builder to append to.
+ * \param *text		The text to append.
+ * \param length	The length of the text.
+ * \return		TRUE if all of the text was added; else FALSE.
+ */
+
+osbool string_builder_append_length(struct string_builder *builder, const char *text, size_t length);
+
+
+/**
+ * Append a string to a string builder.
+ *
+ * \param *builder	The builder to append to.
+ * \param *text		The string to append.
+ * \return		TRUE if all of the string was added; else FALSE.
+ */
+
+osbool string_builder_append(struct string_builder *builder, const char *text);
+
+
+/**
+ * Append a list of strings to a string builder, in order.
+ *
+ * \param *builder	The builder to append to.
+ * \param ...		The strings to append, followed by NULL.
+ * \return		TRUE if all of the strings were added; else FALSE.
+ */
+
+osbool string_builder_append_strings(struct string_builder *builder, ...);
+
+
+/**
+ * Append a single character to a string builder.
+ *
+ * \param *builder	The builder to append to.
+ * \param c		The character to append.
+ * \return		TRUE if the character was added; else FALSE.
+ */
+
+osbool string_builder_append_char(struct string_builder *builder, char c);
+
+
+/**
+ * Append a signed decimal integer to a string builder.
+ *
+ * \param *builder	The builder to append to.
+ * \param value		The value to append.
+ * \return		TRUE if all of the value was added; else FALSE.
+ */
+
+osbool string_builder_append_int(struct string_builder *builder, int value);
+
+
+/**
+ * Append an unsigned hexadecimal integer to a string builder, padded with
+ * leading zeros to a minimum number of digits.
+ *
+ * \param *builder	The builder to append to.
+ * \param value		The value to append.
+ * \param digits	The minimum number of digits to use.
+ * \param upper		TRUE to use upper case digits; FALSE for lower.
+ * \return		TRUE if all of the value was added; else FALSE.
+ */
+
+osbool string_builder_append_hex(struct string_builder *builder, unsigned value, int digits, osbool upper);
+
+
+/**
+ * Return a pointer to the string in a string builder, which remains valid
+ * until the builder is next changed.
+ *
+ * \param *builder	The builder to read.
+ * \return		Pointer to the string.
+ */
+
+#define string_builder_get(builder) (((builder)->text != NULL) ? (builder)->text : "")
+
+
 /**
  * Strip whitespace from the supplied string.  Space at the end is
  * removed by overwiting the first character with zero; the returned
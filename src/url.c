@@ -133,10 +133,9 @@ static osbool url_antbroadcast(const char *url)
 
 static osbool url_antload(const char *url)
 {
-	char	buf[URL_BUFFER_LENGTH];
-	char	*protocol_offset;
-	char	*separator = " ";
-	int	prefix_length, suffix_length, separator_length;
+	char			buf[URL_BUFFER_LENGTH];
+	char			*protocol_offset;
+	struct string_builder	command;
 
 	/* Find the offset of the protocol separator in the URL. */
 
@@ -152,23 +151,20 @@ static osbool url_antload(const char *url)
 	 * If the variable we need doesn't exist, give up.
 	 */
 
-	string_copy(buf, "Alias$URLOpen_", URL_BUFFER_LENGTH);
+	string_builder_init(&command, buf, URL_BUFFER_LENGTH);
+	string_builder_append(&command, "Alias$URLOpen_");
 
-	prefix_length = strlen(buf);
-	suffix_length = protocol_offset - url;
-	separator_length = strlen(separator);
-
-	if (prefix_length + suffix_length + separator_length + 1 > URL_BUFFER_LENGTH) /* +1 for terminator. */
+	if (!string_builder_append_length(&command, url, protocol_offset - url) || getenv(buf) == NULL)
 		return FALSE;
 
-	strncat(buf, url, suffix_length);
-	if (getenv(buf) == NULL)
-		return FALSE;
+	/* Append the URL to the end of the Alias name, and then call the command.
+	 * If the URL is too long to fit, it is truncated as before.
+	 */
 
-	/* Append the URL to the end of the Alias name, and then call the command. */
+	if (!string_builder_append_char(&command, ' '))
+		return FALSE;
 
-	strncat(buf, separator, separator_length);
-	strncat(buf, url, URL_BUFFER_LENGTH - (prefix_length + suffix_length + separator_length + 1));
+	string_builder_append(&command, url);
 
 	if (xwimp_start_task(buf + strlen("Alias$"), NULL) != NULL)
 		return FALSE;
@@ -0,0 +1,454 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: configbench.c
+ *
+ * Config module benchmark.  Reports the memory used by each text option,
+ * compared with the fixed arrays which used to hold them, both when the
+ * options are created and after their values have been changed many times.
+ * It then writes a large Choices file and times loading it, from text and
+ * from a binary snapshot, against reading it a line at a time with
+ * config_read_token_pair() as the loader used to.
+ *
+ * The config module is built for the host with SFLIB_HOST defined, over
+ * the OS_File emulation in confighost.c (make tools).  Memory use is read
+ * from the C library's allocator, so is only reported with glibc.
+ *
+ * Usage: configbench [<options> [<lines>]]
+ */
+
+/* ANSII C header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX header files. */
+
+#include <unistd.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define CONFIGBENCH_MALLINFO
+#endif
+
+/* SF-Lib header files. */
+
+#include "config.h"
+
+
+#define CONFIGBENCH_DEFAULT_OPTIONS 100						/**< The default number of text options to create.			*/
+#define CONFIGBENCH_CHURN_PASSES 1000						/**< The number of times that each option's value is changed.	*/
+#define CONFIGBENCH_NAME_LENGTH 32						/**< The size of a buffer to hold an option name.			*/
+#define CONFIGBENCH_DEFAULT_LINES 10000						/**< The default number of lines in the Choices file.			*/
+#define CONFIGBENCH_HEADER_LINES 3						/**< The number of comment lines at the head of the Choices file.	*/
+#define CONFIGBENCH_LOADS 20							/**< The number of times that the Choices file is loaded.		*/
+
+
+/* Static Function Prototypes. */
+
+static osbool configbench_memory(int options);
+static osbool configbench_load(char *dir, int lines);
+static osbool configbench_load_line_by_line(char *file);
+static osbool configbench_check_values(int values);
+static void configbench_report(char *name, int lines, clock_t start);
+static void configbench_make_value(char *buffer, size_t length, int seed);
+static long configbench_memory_in_use(void);
+
+
+int main(int argc, char *argv[])
+{
+	int	options = CONFIGBENCH_DEFAULT_OPTIONS, lines = CONFIGBENCH_DEFAULT_LINES;
+	char	dir[CONFIGBENCH_NAME_LENGTH];
+	osbool	success;
+
+	if (argc > 3) {
+		fprintf(stderr, "Usage: configbench [<options> [<lines>]]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		options = atoi(argv[1]);
+
+	if (argc > 2)
+		lines = atoi(argv[2]);
+
+	if (options <= 0 || lines <= CONFIGBENCH_HEADER_LINES) {
+		fprintf(stderr, "configbench: the option and line counts must be positive\n");
+		return EXIT_FAILURE;
+	}
+
+	/* The config module looks for <dir>.Choices, which on the host is just
+	 * a file with a dot in its name.
+	 */
+
+	snprintf(dir, sizeof(dir), "/tmp/configbench-%d", (int) getpid());
+
+	if (!config_initialise("ConfigBench", "ConfigBench", dir, NULL)) {
+		fprintf(stderr, "configbench: failed to initialise the config module\n");
+		return EXIT_FAILURE;
+	}
+
+	success = configbench_memory(options);
+
+	if (success) {
+		printf("\n");
+		success = configbench_load(dir, lines);
+	}
+
+	return (success) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/**
+ * Create a set of text options and report the memory used by each, then
+ * change their values repeatedly and report it again.
+ *
+ * \param options	The number of options to create.
+ * \return		TRUE if the test passed; FALSE if it failed.
+ */
+
+static osbool configbench_memory(int options)
+{
+	char	name[CONFIGBENCH_NAME_LENGTH], value[sf_MAX_CONFIG_STR];
+	long	start, created, churned = 0, settled;
+	int	i, pass;
+	size_t	fixed;
+
+	start = configbench_memory_in_use();
+
+	for (i = 0; i < options; i++) {
+		snprintf(name, sizeof(name), "TextOption%d", i);
+		configbench_make_value(value, 1 + i % 32, i);
+
+		if (!config_str_init(name, value)) {
+			fprintf(stderr, "configbench: failed to create option %s\n", name);
+			return FALSE;
+		}
+	}
+
+	created = configbench_memory_in_use();
+
+	/* Change every value in turn, with lengths swinging between short and
+	 * very long, so that buffers are outgrown and abandoned.
+	 */
+
+	for (pass = 0; pass < CONFIGBENCH_CHURN_PASSES; pass++) {
+		if (pass == CONFIGBENCH_CHURN_PASSES / 2)
+			churned = configbench_memory_in_use();
+
+		for (i = 0; i < options; i++) {
+			snprintf(name, sizeof(name), "TextOption%d", i);
+			configbench_make_value(value, 1 + ((pass * 37 + i * 11) % (sf_MAX_CONFIG_STR - 1)), pass + i);
+
+			if (!config_str_set(name, value) || strcmp(config_str_read(name), value) != 0) {
+				fprintf(stderr, "configbench: failed to update option %s\n", name);
+				return FALSE;
+			}
+		}
+	}
+
+	settled = configbench_memory_in_use();
+
+	fixed = sf_MAX_CONFIG_NAME + 2 * sf_MAX_CONFIG_STR + sizeof(void *);
+
+	printf("Text options:           %d\n", options);
+	printf("Fixed arrays:           %u bytes per option\n", (unsigned) fixed);
+
+	if (start < 0) {
+		printf("Memory in use:          not available on this host\n");
+		return TRUE;
+	}
+
+	printf("After creation:         %ld bytes per option\n", (created - start) / options);
+	printf("After %4d changes:      %ld bytes per option\n", CONFIGBENCH_CHURN_PASSES / 2, (churned - start) / options);
+	printf("After %4d changes:      %ld bytes per option\n", CONFIGBENCH_CHURN_PASSES, (settled - start) / options);
+
+	/* Abandoned buffers are re-used, so even after every value has held a
+	 * long text, the options should cost less than the fixed arrays did.
+	 */
+
+	if ((settled - start) / options >= (long) fixed) {
+		fprintf(stderr, "configbench: text options use more memory than fixed arrays\n");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Fill a buffer with a text value of a given length.
+ *
+ * \param *buffer	The buffer to fill, which must be at least
+ *			length + 1 bytes long.
+ * \param length	The length of the text to write.
+ * \param seed		A value to vary the text with.
+ */
+
+static void configbench_make_value(char *buffer, size_t length, int seed)
+{
+	size_t	i;
+
+	for (i = 0; i < length; i++)
+		buffer[i] = 'a' + (seed + i) % 26;
+
+	buffer[length] = '\0';
+}
+
+
+/**
+ * Read the number of bytes currently claimed from the C library's
+ * allocator.
+ *
+ * \return		The number of bytes in use, or -1 if not known.
+ */
+
+static long configbench_memory_in_use(void)
+{
+#ifdef CONFIGBENCH_MALLINFO
+	struct mallinfo2	info;
+
+	info = mallinfo2();
+
+	return (long) info.uordblks;
+#else
+	return -1;
+#endif
+}
+
+
+/**
+ * Write a Choices file holding a given number of lines, registering an
+ * option for each value, and time loading it in different ways.
+ *
+ * \param *dir		The application directory given to the config module.
+ * \param lines		The number of lines to write to the file.
+ * \return		TRUE if the test passed; FALSE if it failed.
+ */
+
+static osbool configbench_load(char *dir, int lines)
+{
+	char	file[sf_MAX_CONFIG_FILE_BUFFER], snapshot[sf_MAX_CONFIG_FILE_BUFFER], name[CONFIGBENCH_NAME_LENGTH], value[CONFIGBENCH_NAME_LENGTH];
+	int	i, load, values = lines - CONFIGBENCH_HEADER_LINES;
+	FILE	*out;
+	clock_t	start;
+	osbool	success = TRUE;
+
+	snprintf(file, sizeof(file), "%s.Choices", dir);
+	snprintf(snapshot, sizeof(snapshot), "%s.ChoicesBin", dir);
+
+	/* Register a mix of boolean, integer and text options, and write a value
+	 * for each of them which differs from its default.
+	 */
+
+	out = fopen(file, "w");
+	if (out == NULL) {
+		fprintf(stderr, "configbench: failed to write %s\n", file);
+		return FALSE;
+	}
+
+	fprintf(out, "# >Choices\n#\n# Written by configbench\n");
+
+	for (i = 0; i < values; i++) {
+		switch (i % 3) {
+		case 0:
+			snprintf(name, sizeof(name), "Flag%d", i);
+			config_opt_init(name, FALSE);
+			config_write_token_pair(out, name, config_return_opt_string(TRUE));
+			break;
+
+		case 1:
+			snprintf(name, sizeof(name), "Number%d", i);
+			snprintf(value, sizeof(value), "%d", i);
+			config_int_init(name, 0);
+			config_write_token_pair(out, name, value);
+			break;
+
+		case 2:
+			snprintf(name, sizeof(name), "Text%d", i);
+			snprintf(value, sizeof(value), "Value %d", i);
+			config_str_init(name, "");
+			config_write_token_pair(out, name, value);
+			break;
+		}
+	}
+
+	fclose(out);
+
+	printf("Choices file:           %d lines, %d loads\n", lines, CONFIGBENCH_LOADS);
+	printf("%-24s %12s %10s %14s\n", "Load test", "Lines", "Seconds", "Lines/second");
+
+	/* Load the file as a whole, tokenising it in place. */
+
+	start = clock();
+
+	for (load = 0; success && load < CONFIGBENCH_LOADS; load++)
+		success = config_load();
+
+	configbench_report("Text, in place", lines, start);
+
+	if (success)
+		success = configbench_check_values(values);
+
+	/* Load it a line at a time, as the loader used to. */
+
+	start = clock();
+
+	for (load = 0; success && load < CONFIGBENCH_LOADS; load++)
+		success = configbench_load_line_by_line(file);
+
+	configbench_report("Text, line by line", lines, start);
+
+	/* Save a binary snapshot alongside the file, and load that instead. */
+
+	if (success) {
+		config_set_snapshot(TRUE);
+		success = config_save();
+	}
+
+	start = clock();
+
+	for (load = 0; success && load < CONFIGBENCH_LOADS; load++)
+		success = config_load();
+
+	configbench_report("Binary snapshot", lines, start);
+
+	if (success)
+		success = configbench_check_values(values);
+
+	remove(file);
+	remove(snapshot);
+
+	if (!success)
+		fprintf(stderr, "configbench: failed to load the Choices file correctly\n");
+
+	return success;
+}
+
+
+/**
+ * Load a Choices file a line at a time using config_read_token_pair(),
+ * setting each value by name.
+ *
+ * \param *file		The Choices file to load.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+static osbool configbench_load_line_by_line(char *file)
+{
+	char			token[sf_MAX_CONFIG_FILE_BUFFER], value[sf_MAX_CONFIG_FILE_BUFFER], section[sf_MAX_CONFIG_FILE_BUFFER];
+	enum config_read_status	result;
+	FILE			*in;
+
+	in = fopen(file, "r");
+	if (in == NULL)
+		return FALSE;
+
+	while ((result = config_read_token_pair(in, token, value, section)) != sf_CONFIG_READ_EOF) {
+		if (result != sf_CONFIG_READ_VALUE_RETURNED)
+			continue;
+
+		switch (*token) {
+		case 'F':
+			config_opt_set(token, config_read_opt_string(value));
+			break;
+
+		case 'N':
+			config_int_set(token, atoi(value));
+			break;
+
+		case 'T':
+			config_str_set(token, value);
+			break;
+		}
+	}
+
+	fclose(in);
+
+	return TRUE;
+}
+
+
+/**
+ * Check that the last value of each type written to the Choices file has
+ * been loaded.
+ *
+ * \param values	The number of values in the file.
+ * \return		TRUE if the values are correct; else FALSE.
+ */
+
+static osbool configbench_check_values(int values)
+{
+	char	name[CONFIGBENCH_NAME_LENGTH], value[CONFIGBENCH_NAME_LENGTH];
+	int	i;
+
+	for (i = (values > 3) ? values - 3 : 0; i < values; i++) {
+		switch (i % 3) {
+		case 0:
+			snprintf(name, sizeof(name), "Flag%d", i);
+			if (config_opt_read(name) != TRUE)
+				return FALSE;
+			break;
+
+		case 1:
+			snprintf(name, sizeof(name), "Number%d", i);
+			if (config_int_read(name) != i)
+				return FALSE;
+			break;
+
+		case 2:
+			snprintf(name, sizeof(name), "Text%d", i);
+			snprintf(value, sizeof(value), "Value %d", i);
+			if (strcmp(config_str_read(name), value) != 0)
+				return FALSE;
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Report the result of a load test.
+ *
+ * \param *name		The name of the test.
+ * \param lines		The number of lines in the file.
+ * \param start		The clock() value when the test started.
+ */
+
+static void configbench_report(char *name, int lines, clock_t start)
+{
+	double	seconds;
+	long	total = (long) lines * CONFIGBENCH_LOADS;
+
+	seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	if (seconds > 0.0)
+		printf("%-24s %12ld %10.3f %14.0f\n", name, total, seconds, total / seconds);
+	else
+		printf("%-24s %12ld %10.3f %14s\n", name, total, seconds, "-");
+}
@@ -0,0 +1,543 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: heapbench.c
+ *
+ * Heap stress and throughput benchmark.  The stress test makes a long
+ * randomised run of claims, extends, strdups and frees, checking every
+ * block's size and contents as it goes; the throughput tests then time
+ * common allocation patterns against the C library's malloc(), and time
+ * building and discarding lists of small nodes in an arena against
+ * claiming and freeing each node from the heap.
+ *
+ * The same source builds against either heap backend: on the host with
+ * SFLIB_HOST defined and tools/libsfheap.a (make tools), or on RISC OS
+ * against SFLib and FlexLib, where the real flex and OS_Heap are used.
+ *
+ * Usage: heapbench [<iterations> [<seed>]]
+ */
+
+/* ANSII C header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef SFLIB_HOST
+
+/* Acorn C header files. */
+
+#include "flex.h"
+
+#endif
+
+/* SF-Lib header files. */
+
+#include "heap.h"
+
+
+#define HEAPBENCH_DEFAULT_ITERATIONS 200000					/**< The default number of iterations for each test.			*/
+#define HEAPBENCH_SLOTS 1024							/**< The number of blocks held live by the stress and churn tests.	*/
+#define HEAPBENCH_MAX_SMALL 2048						/**< The largest block used by the small block tests.			*/
+#define HEAPBENCH_MAX_LARGE 65536						/**< The largest block used by the large block tests.			*/
+#define HEAPBENCH_NODES 256							/**< The number of nodes in each list built by the node tests.		*/
+#define HEAPBENCH_MAX_NODE 64							/**< The largest node claimed by the node tests.			*/
+
+
+/**
+ * A block held live by the stress test.
+ */
+
+struct heapbench_slot {
+	unsigned char		*block;					/**< The block, or NULL if the slot is empty.			*/
+	size_t			size;					/**< The size requested for the block.				*/
+	unsigned char		fill;					/**< The byte with which the block is filled.			*/
+};
+
+/**
+ * A node in a list built by the node tests, followed by its fill bytes.
+ */
+
+struct heapbench_node {
+	struct heapbench_node	*next;					/**< The next node in the list, or NULL.			*/
+	size_t			size;					/**< The number of fill bytes following the node.		*/
+	unsigned char		fill;					/**< The byte with which the node is filled.			*/
+};
+
+/**
+ * The state of the pseudo-random number generator, so that runs can be
+ * repeated exactly on both backends.
+ */
+
+static unsigned long		heapbench_random_state = 1;
+
+
+/* Static Function Prototypes. */
+
+static int heapbench_stress(int iterations);
+static osbool heapbench_check_slot(struct heapbench_slot *slot, int iteration);
+static void heapbench_fill_slot(struct heapbench_slot *slot, size_t from);
+static void heapbench_time_churn(int iterations, size_t max_size, osbool use_malloc);
+static void heapbench_time_extend(int iterations, osbool use_malloc);
+static int heapbench_time_nodes(int iterations, osbool use_arena);
+static void heapbench_report(char *name, int operations, clock_t start);
+static size_t heapbench_random_size(size_t max_size);
+static unsigned long heapbench_random(void);
+
+
+int main(int argc, char *argv[])
+{
+	int	iterations = HEAPBENCH_DEFAULT_ITERATIONS, failures;
+
+	if (argc > 3) {
+		fprintf(stderr, "Usage: heapbench [<iterations> [<seed>]]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+
+	if (argc > 2)
+		heapbench_random_state = strtoul(argv[2], NULL, 10);
+
+	if (iterations <= 0) {
+		fprintf(stderr, "heapbench: the iteration count must be positive\n");
+		return EXIT_FAILURE;
+	}
+
+#ifndef SFLIB_HOST
+	flex_init("HeapBench", NULL, 0);
+#endif
+
+	if (!heap_initialise()) {
+		fprintf(stderr, "heapbench: failed to initialise the heap\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Stress test: %d iterations, seed %lu\n", iterations, heapbench_random_state);
+
+	failures = heapbench_stress(iterations);
+
+	printf("%d failures\n\n", failures);
+
+	printf("%-28s %12s %10s %14s\n", "Throughput test", "Operations", "Seconds", "Ops/second");
+
+	heapbench_time_churn(iterations, HEAPBENCH_MAX_SMALL, FALSE);
+	heapbench_time_churn(iterations, HEAPBENCH_MAX_SMALL, TRUE);
+	heapbench_time_churn(iterations / 10, HEAPBENCH_MAX_LARGE, FALSE);
+	heapbench_time_churn(iterations / 10, HEAPBENCH_MAX_LARGE, TRUE);
+	heapbench_time_extend(iterations / 1000, FALSE);
+	heapbench_time_extend(iterations / 1000, TRUE);
+	failures += heapbench_time_nodes(iterations * 10, FALSE);
+	failures += heapbench_time_nodes(iterations * 10, TRUE);
+
+	printf("\nHeap space returned to flex: %u bytes\n", (unsigned) heap_get_reclaimed_bytes());
+
+	return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/**
+ * Run the stress test, making a random sequence of claims, extends, strdups
+ * and frees across a set of slots and checking the size and contents of
+ * each block whenever it is touched.
+ *
+ * \param iterations	The number of operations to perform.
+ * \return		The number of failures detected.
+ */
+
+static int heapbench_stress(int iterations)
+{
+	struct heapbench_slot	*slots, *slot;
+	unsigned char		*block;
+	char			text[64];
+	size_t			size, old_size;
+	int			i, failures = 0;
+
+	slots = calloc(HEAPBENCH_SLOTS, sizeof(struct heapbench_slot));
+	if (slots == NULL) {
+		fprintf(stderr, "heapbench: no memory for the stress test\n");
+		return 1;
+	}
+
+	for (i = 0; i < iterations; i++) {
+		slot = slots + (heapbench_random() % HEAPBENCH_SLOTS);
+
+		if (slot->block != NULL && !heapbench_check_slot(slot, i))
+			failures++;
+
+		switch (heapbench_random() % 4) {
+		case 0:
+			/* Claim a new block, mostly small but sometimes large. */
+
+			heap_free(slot->block);
+
+			size = heapbench_random_size((heapbench_random() % 8 == 0) ? HEAPBENCH_MAX_LARGE : HEAPBENCH_MAX_SMALL);
+			slot->block = heap_alloc(size);
+			slot->size = size;
+			slot->fill = (unsigned char) heapbench_random();
+			heapbench_fill_slot(slot, 0);
+			break;
+
+		case 1:
+			/* Extend an existing block, which may move it. */
+
+			if (slot->block == NULL)
+				break;
+
+			size = heapbench_random_size((heapbench_random() % 8 == 0) ? HEAPBENCH_MAX_LARGE : HEAPBENCH_MAX_SMALL);
+			block = heap_extend(slot->block, size);
+			if (block == NULL)
+				break;
+
+			/* Only the new bytes at the end of the block need filling. */
+
+			old_size = slot->size;
+			slot->block = block;
+			slot->size = size;
+			heapbench_fill_slot(slot, old_size);
+			break;
+
+		case 2:
+			/* Duplicate a string of random length. */
+
+			heap_free(slot->block);
+
+			size = heapbench_random() % sizeof(text);
+			slot->fill = 'a' + heapbench_random() % 26;
+			memset(text, slot->fill, size);
+			text[size] = '\0';
+
+			slot->block = (unsigned char *) heap_strdup(text);
+			slot->size = size;
+			break;
+
+		case 3:
+			/* Free the block. */
+
+			heap_free(slot->block);
+			slot->block = NULL;
+			break;
+		}
+	}
+
+	for (i = 0; i < HEAPBENCH_SLOTS; i++) {
+		if (slots[i].block != NULL && !heapbench_check_slot(slots + i, iterations))
+			failures++;
+
+		heap_free(slots[i].block);
+	}
+
+	free(slots);
+
+	heap_trim();
+
+	return failures;
+}
+
+
+/**
+ * Check that a stress test block still has the expected size and contents.
+ *
+ * \param *slot		The slot holding the block to check.
+ * \param iteration	The current iteration, for reporting.
+ * \return		TRUE if the block is intact; FALSE if not.
+ */
+
+static osbool heapbench_check_slot(struct heapbench_slot *slot, int iteration)
+{
+	size_t	i;
+
+	if (heap_size(slot->block) < slot->size) {
+		fprintf(stderr, "Iteration %d: block %p is %u bytes, expected %u\n",
+				iteration, (void *) slot->block, (unsigned) heap_size(slot->block), (unsigned) slot->size);
+		return FALSE;
+	}
+
+	for (i = 0; i < slot->size; i++) {
+		if (slot->block[i] != slot->fill) {
+			fprintf(stderr, "Iteration %d: block %p corrupt at offset %u\n",
+					iteration, (void *) slot->block, (unsigned) i);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Fill a stress test block with its fill byte.
+ *
+ * \param *slot		The slot holding the block to fill.
+ * \param from		The offset from which to start filling.
+ */
+
+static void heapbench_fill_slot(struct heapbench_slot *slot, size_t from)
+{
+	if (slot->block != NULL && from < slot->size)
+		memset(slot->block + from, slot->fill, slot->size - from);
+}
+
+
+/**
+ * Time a churn of random claims and frees across a set of live blocks.
+ *
+ * \param iterations	The number of claim and free pairs to perform.
+ * \param max_size	The largest block to claim.
+ * \param use_malloc	TRUE to time malloc() and free() for comparison;
+ *			FALSE to time the heap.
+ */
+
+static void heapbench_time_churn(int iterations, size_t max_size, osbool use_malloc)
+{
+	void	*slots[HEAPBENCH_SLOTS];
+	char	name[32];
+	clock_t	start;
+	int	i, slot;
+
+	if (iterations <= 0)
+		return;
+
+	for (i = 0; i < HEAPBENCH_SLOTS; i++)
+		slots[i] = NULL;
+
+	heapbench_random_state = 1;
+	start = clock();
+
+	for (i = 0; i < iterations; i++) {
+		slot = heapbench_random() % HEAPBENCH_SLOTS;
+
+		if (use_malloc) {
+			free(slots[slot]);
+			slots[slot] = malloc(heapbench_random_size(max_size));
+		} else {
+			heap_free(slots[slot]);
+			slots[slot] = heap_alloc(heapbench_random_size(max_size));
+		}
+	}
+
+	for (i = 0; i < HEAPBENCH_SLOTS; i++) {
+		if (use_malloc)
+			free(slots[i]);
+		else
+			heap_free(slots[i]);
+	}
+
+	sprintf(name, "%s churn <= %u", (use_malloc) ? "malloc" : "heap", (unsigned) max_size);
+	heapbench_report(name, iterations, start);
+}
+
+
+/**
+ * Time the growth of blocks a few bytes at a time, as a string builder or
+ * growing array would do it.
+ *
+ * \param iterations	The number of blocks to grow.
+ * \param use_malloc	TRUE to time realloc() for comparison; FALSE to
+ *			time the heap.
+ */
+
+static void heapbench_time_extend(int iterations, osbool use_malloc)
+{
+	void	*block, *extended;
+	char	name[32];
+	clock_t	start;
+	size_t	size;
+	int	i, operations = 0;
+
+	if (iterations <= 0)
+		return;
+
+	start = clock();
+
+	for (i = 0; i < iterations; i++) {
+		block = (use_malloc) ? malloc(16) : heap_alloc(16);
+
+		for (size = 32; block != NULL && size <= HEAPBENCH_MAX_LARGE; size += 32) {
+			extended = (use_malloc) ? realloc(block, size) : heap_extend(block, size);
+			if (extended == NULL)
+				break;
+
+			block = extended;
+			operations++;
+		}
+
+		if (use_malloc)
+			free(block);
+		else
+			heap_free(block);
+	}
+
+	sprintf(name, "%s extend <= %u", (use_malloc) ? "realloc" : "heap", HEAPBENCH_MAX_LARGE);
+	heapbench_report(name, operations, start);
+}
+
+
+/**
+ * Time building lists of small nodes and then discarding them, as a parser
+ * or menu builder would do it.  The nodes are either claimed and freed one
+ * at a time from the heap, or allocated from an arena which is then reset
+ * to discard each list in one go.  Every list is checked before it is
+ * discarded.
+ *
+ * \param iterations	The number of nodes to claim.
+ * \param use_arena	TRUE to allocate from an arena; FALSE to claim each
+ *			node from the heap.
+ * \return		The number of failures detected.
+ */
+
+static int heapbench_time_nodes(int iterations, osbool use_arena)
+{
+	struct heap_arena	*arena = NULL;
+	struct heapbench_node	*list, *node, *next;
+	unsigned char		*data;
+	char			name[32];
+	clock_t			start;
+	size_t			size, i;
+	int			node_count, operations = 0, failures = 0;
+
+	if (iterations <= 0)
+		return 0;
+
+	if (use_arena) {
+		arena = heap_arena_create(0);
+		if (arena == NULL) {
+			fprintf(stderr, "heapbench: failed to create an arena\n");
+			return 1;
+		}
+	}
+
+	heapbench_random_state = 1;
+	start = clock();
+
+	while (operations < iterations) {
+		list = NULL;
+
+		/* Build a list of nodes, each followed by some fill bytes. */
+
+		for (node_count = 0; node_count < HEAPBENCH_NODES; node_count++) {
+			size = heapbench_random() % (HEAPBENCH_MAX_NODE - sizeof(struct heapbench_node));
+
+			if (use_arena)
+				node = heap_arena_alloc(arena, sizeof(struct heapbench_node) + size);
+			else
+				node = heap_alloc(sizeof(struct heapbench_node) + size);
+
+			if (node == NULL)
+				break;
+
+			node->next = list;
+			node->size = size;
+			node->fill = (unsigned char) operations;
+			memset(node + 1, node->fill, size);
+
+			list = node;
+			operations++;
+		}
+
+		/* Check the list, and then discard it. */
+
+		for (node = list; node != NULL; node = next) {
+			next = node->next;
+			data = (unsigned char *) (node + 1);
+
+			for (i = 0; i < node->size && data[i] == node->fill; i++);
+
+			if (i < node->size) {
+				fprintf(stderr, "Node test: node %p corrupt at offset %u\n", (void *) node, (unsigned) i);
+				failures++;
+			}
+
+			if (!use_arena)
+				heap_free(node);
+		}
+
+		if (use_arena)
+			heap_arena_reset(arena);
+
+		if (node_count < HEAPBENCH_NODES) {
+			fprintf(stderr, "heapbench: failed to claim a node\n");
+			failures++;
+			break;
+		}
+	}
+
+	heap_arena_destroy(arena);
+
+	sprintf(name, "%s nodes <= %u", (use_arena) ? "arena" : "heap", HEAPBENCH_MAX_NODE);
+	heapbench_report(name, operations, start);
+
+	return failures;
+}
+
+
+/**
+ * Report the result of a throughput test.
+ *
+ * \param *name		The name of the test.
+ * \param operations	The number of operations performed.
+ * \param start		The clock() value when the test started.
+ */
+
+static void heapbench_report(char *name, int operations, clock_t start)
+{
+	double	seconds;
+
+	seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	if (seconds > 0.0)
+		printf("%-28s %12d %10.2f %14.0f\n", name, operations, seconds, operations / seconds);
+	else
+		printf("%-28s %12d %10.2f %14s\n", name, operations, seconds, "-");
+}
+
+
+/**
+ * Return a random block size, between 1 byte and a given limit.
+ *
+ * \param max_size	The largest size to return.
+ * \return		The block size.
+ */
+
+static size_t heapbench_random_size(size_t max_size)
+{
+	return 1 + ((heapbench_random() << 15) | heapbench_random()) % max_size;
+}
+
+
+/**
+ * Return the next pseudo-random number, from a generator which gives the
+ * same sequence on every platform.
+ *
+ * \return		The random number, in the range 0 to 32767.
+ */
+
+static unsigned long heapbench_random(void)
+{
+	heapbench_random_state = (heapbench_random_state * 1103515245UL + 12345UL) & 0xffffffffUL;
+
+	return (heapbench_random_state >> 16) & 0x7fff;
+}
@@ -0,0 +1,71 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: msgcomp.c
+ *
+ * Messages file compiler.  A host tool to convert a text Messages file
+ * into the compiled form which can be loaded by the native Messages file
+ * engine without any parsing.
+ *
+ * Usage: msgcomp <source> <destination>
+ */
+
+/* SF-Lib header files. */
+
+#include "msgfile.h"
+
+/* ANSII C header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+int main(int argc, char *argv[])
+{
+	struct msgfile_block	*block;
+	osbool			success;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: msgcomp <source> <destination>\n");
+		return EXIT_FAILURE;
+	}
+
+	block = msgfile_load(argv[1]);
+	if (block == NULL) {
+		fprintf(stderr, "msgcomp: failed to load '%s'\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	success = msgfile_compile(block, argv[2]);
+
+	msgfile_destroy(block);
+
+	if (!success) {
+		fprintf(stderr, "msgcomp: failed to compile '%s' to '%s'\n", argv[1], argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
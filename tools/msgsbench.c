@@ -0,0 +1,395 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: msgsbench.c
+ *
+ * Native Messages file engine benchmark.  Writes a Messages file using
+ * plain, wildcarded and multiple tokens with parameters, compiles it, and
+ * then times loading and looking up tokens from the text and compiled
+ * forms.  A sequential scan of the text, in the manner of MessageTrans,
+ * is timed alongside for comparison, and the results are checked.
+ *
+ * Usage: msgsbench [<tokens> [<lookups>]]
+ */
+
+/* ANSII C header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX header files. */
+
+#include <unistd.h>
+
+/* SF-Lib header files. */
+
+#include "msgfile.h"
+
+
+#define MSGSBENCH_DEFAULT_TOKENS 2000						/**< The default number of tokens in the Messages file.		*/
+#define MSGSBENCH_DEFAULT_LOOKUPS 1000000					/**< The default number of lookups to time.				*/
+#define MSGSBENCH_LOADS 50							/**< The number of times that each file is loaded.			*/
+#define MSGSBENCH_SCAN_DIVISOR 100						/**< The fraction of the lookups made by the sequential scan.	*/
+#define MSGSBENCH_WILDCARD_SPACING 64						/**< The spacing of the messages with wildcarded tokens.		*/
+#define MSGSBENCH_NAME_LENGTH 64						/**< The size of a buffer to hold a filename or token.		*/
+#define MSGSBENCH_TEXT_LENGTH 256						/**< The size of a buffer to hold a message.				*/
+
+
+/* Static Function Prototypes. */
+
+static osbool msgsbench_write_file(char *filename, int tokens);
+static void msgsbench_time_loads(char *name, char *filename);
+static osbool msgsbench_time_lookups(char *name, struct msgfile_block *block, int tokens, int lookups);
+static osbool msgsbench_time_scans(char *text, int tokens, int lookups);
+static char *msgsbench_scan(char *text, char *token);
+static void msgsbench_make_token(char *buffer, size_t length, int index);
+static void msgsbench_make_expected(char *buffer, size_t length, int index);
+static void msgsbench_report(char *name, int operations, clock_t start);
+
+
+int main(int argc, char *argv[])
+{
+	char			text_file[MSGSBENCH_NAME_LENGTH], compiled_file[MSGSBENCH_NAME_LENGTH], *text = NULL;
+	int			tokens = MSGSBENCH_DEFAULT_TOKENS, lookups = MSGSBENCH_DEFAULT_LOOKUPS;
+	struct msgfile_block	*from_text = NULL, *from_compiled = NULL;
+	osbool			success = TRUE;
+	FILE			*in;
+	long			size;
+
+	if (argc > 3) {
+		fprintf(stderr, "Usage: msgsbench [<tokens> [<lookups>]]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		tokens = atoi(argv[1]);
+
+	if (argc > 2)
+		lookups = atoi(argv[2]);
+
+	if (tokens <= 0 || lookups <= 0) {
+		fprintf(stderr, "msgsbench: the token and lookup counts must be positive\n");
+		return EXIT_FAILURE;
+	}
+
+	snprintf(text_file, sizeof(text_file), "/tmp/msgsbench-%d", (int) getpid());
+	snprintf(compiled_file, sizeof(compiled_file), "/tmp/msgsbench-%d,ffd", (int) getpid());
+
+	/* Write the text file, and compile it. */
+
+	if (!msgsbench_write_file(text_file, tokens)) {
+		fprintf(stderr, "msgsbench: failed to write %s\n", text_file);
+		return EXIT_FAILURE;
+	}
+
+	from_text = msgfile_load(text_file);
+
+	if (from_text == NULL || !msgfile_compile(from_text, compiled_file)) {
+		fprintf(stderr, "msgsbench: failed to compile %s\n", text_file);
+		success = FALSE;
+	}
+
+	if (success) {
+		from_compiled = msgfile_load(compiled_file);
+
+		if (from_compiled == NULL) {
+			fprintf(stderr, "msgsbench: failed to load %s\n", compiled_file);
+			success = FALSE;
+		}
+	}
+
+	/* Keep a copy of the text for the sequential scan. */
+
+	in = (success) ? fopen(text_file, "rb") : NULL;
+
+	if (in != NULL) {
+		fseek(in, 0, SEEK_END);
+		size = ftell(in);
+		rewind(in);
+
+		text = malloc(size + 1);
+		if (text != NULL && fread(text, 1, size, in) == (size_t) size)
+			text[size] = '\0';
+		else
+			success = FALSE;
+
+		fclose(in);
+	} else {
+		success = FALSE;
+	}
+
+	if (success) {
+		printf("Messages file: %d tokens\n\n", tokens);
+		printf("%-24s %12s %10s %14s\n", "Test", "Operations", "Seconds", "Ops/second");
+
+		msgsbench_time_loads("Load text", text_file);
+		msgsbench_time_loads("Load compiled", compiled_file);
+
+		success = msgsbench_time_lookups("Lookup, text", from_text, tokens, lookups) &&
+				msgsbench_time_lookups("Lookup, compiled", from_compiled, tokens, lookups) &&
+				msgsbench_time_scans(text, tokens, lookups / MSGSBENCH_SCAN_DIVISOR);
+	}
+
+	if (!success)
+		fprintf(stderr, "msgsbench: lookups returned the wrong text\n");
+
+	free(text);
+	msgfile_destroy(from_text);
+	msgfile_destroy(from_compiled);
+
+	remove(text_file);
+	remove(compiled_file);
+
+	return (success) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/**
+ * Write a Messages file for the benchmark.  Every fourth message is given
+ * two tokens, and a few are found through wildcarded tokens; the rest have
+ * a single plain token.  Each message takes two parameters.
+ *
+ * \param *filename	The name of the file to write.
+ * \param tokens	The number of messages to write.
+ * \return		TRUE if successful; else FALSE.
+ */
+
+static osbool msgsbench_write_file(char *filename, int tokens)
+{
+	char	token[MSGSBENCH_NAME_LENGTH];
+	FILE	*out;
+	int	i;
+
+	out = fopen(filename, "w");
+	if (out == NULL)
+		return FALSE;
+
+	fprintf(out, "# Messages file written by msgsbench\n\n");
+
+	for (i = 0; i < tokens; i++) {
+		msgsbench_make_token(token, sizeof(token), i);
+
+		if (i % MSGSBENCH_WILDCARD_SPACING == 2)
+			fprintf(out, "Group%d_?:", i);
+		else if (i % 4 == 1)
+			fprintf(out, "Other%d\n%s:", i, token);
+		else
+			fprintf(out, "%s:", token);
+
+		fprintf(out, "Message %d for %%0 with %%1 items\n", i);
+	}
+
+	return (fclose(out) == 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * Time loading a Messages file.
+ *
+ * \param *name		The name of the test.
+ * \param *filename	The file to load.
+ */
+
+static void msgsbench_time_loads(char *name, char *filename)
+{
+	struct msgfile_block	*block;
+	clock_t			start;
+	int			load;
+
+	start = clock();
+
+	for (load = 0; load < MSGSBENCH_LOADS; load++) {
+		block = msgfile_load(filename);
+		msgfile_destroy(block);
+	}
+
+	msgsbench_report(name, MSGSBENCH_LOADS, start);
+}
+
+
+/**
+ * Time a series of lookups from a loaded Messages file, checking a sample
+ * of the results.
+ *
+ * \param *name		The name of the test.
+ * \param *block	The file to look the tokens up in.
+ * \param tokens	The number of messages in the file.
+ * \param lookups	The number of lookups to make.
+ * \return		TRUE if every lookup was correct; else FALSE.
+ */
+
+static osbool msgsbench_time_lookups(char *name, struct msgfile_block *block, int tokens, int lookups)
+{
+	char	token[MSGSBENCH_NAME_LENGTH], buffer[MSGSBENCH_TEXT_LENGTH], expected[MSGSBENCH_TEXT_LENGTH];
+	clock_t	start;
+	int	i, index;
+
+	start = clock();
+
+	for (i = 0; i < lookups; i++) {
+		index = (int) (((unsigned) i * 2654435761u) % (unsigned) tokens);
+
+		msgsbench_make_token(token, sizeof(token), index);
+
+		if (!msgfile_lookup(block, token, buffer, sizeof(buffer), "Alice", "3", NULL, NULL))
+			return FALSE;
+
+		/* Only check a sample, so that the check doesn't swamp the timing. */
+
+		if (i % 64 == 0) {
+			msgsbench_make_expected(expected, sizeof(expected), index);
+
+			if (strcmp(buffer, expected) != 0)
+				return FALSE;
+		}
+	}
+
+	msgsbench_report(name, lookups, start);
+
+	return TRUE;
+}
+
+
+/**
+ * Time a series of lookups made by scanning the text of the Messages file
+ * from the start each time, as MessageTrans does.  Only plain tokens are
+ * looked up, and the raw text is compared.
+ *
+ * \param *text		The text of the Messages file.
+ * \param tokens	The number of messages in the file.
+ * \param lookups	The number of lookups to make.
+ * \return		TRUE if every lookup was correct; else FALSE.
+ */
+
+static osbool msgsbench_time_scans(char *text, int tokens, int lookups)
+{
+	char	token[MSGSBENCH_NAME_LENGTH], expected[MSGSBENCH_TEXT_LENGTH], *found;
+	clock_t	start;
+	int	i, index;
+
+	if (lookups <= 0)
+		return TRUE;
+
+	start = clock();
+
+	for (i = 0; i < lookups; i++) {
+		index = (int) (((unsigned) i * 2654435761u) % (unsigned) tokens);
+		index -= index % 4;
+
+		msgsbench_make_token(token, sizeof(token), index);
+
+		found = msgsbench_scan(text, token);
+		if (found == NULL)
+			return FALSE;
+
+		snprintf(expected, sizeof(expected), "Message %d for %%0", index);
+
+		if (strncmp(found, expected, strlen(expected)) != 0)
+			return FALSE;
+	}
+
+	msgsbench_report("Lookup, sequential scan", lookups, start);
+
+	return TRUE;
+}
+
+
+/**
+ * Find a plain token in the text of a Messages file by comparing it with
+ * each line in turn.
+ *
+ * \param *text		The text of the Messages file.
+ * \param *token	The token to find.
+ * \return		Pointer to the message text, or NULL if not found.
+ */
+
+static char *msgsbench_scan(char *text, char *token)
+{
+	size_t	length = strlen(token);
+	char	*line;
+
+	for (line = text; *line != '\0'; line = strchr(line, '\n') + 1) {
+		if (strncmp(line, token, length) == 0 && line[length] == ':')
+			return line + length + 1;
+
+		if (strchr(line, '\n') == NULL)
+			break;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Build the token used to look up a message.
+ *
+ * \param *buffer	The buffer to hold the token.
+ * \param length	The size of the buffer.
+ * \param index		The index of the message.
+ */
+
+static void msgsbench_make_token(char *buffer, size_t length, int index)
+{
+	if (index % MSGSBENCH_WILDCARD_SPACING == 2)
+		snprintf(buffer, length, "Group%d_%d", index, index % 10);
+	else
+		snprintf(buffer, length, "Token%d", index);
+}
+
+
+/**
+ * Build the text expected from looking up a message.
+ *
+ * \param *buffer	The buffer to hold the text.
+ * \param length	The size of the buffer.
+ * \param index		The index of the message.
+ */
+
+static void msgsbench_make_expected(char *buffer, size_t length, int index)
+{
+	snprintf(buffer, length, "Message %d for Alice with 3 items", index);
+}
+
+
+/**
+ * Report the result of a test.
+ *
+ * \param *name		The name of the test.
+ * \param operations	The number of operations performed.
+ * \param start		The clock() value when the test started.
+ */
+
+static void msgsbench_report(char *name, int operations, clock_t start)
+{
+	double	seconds;
+
+	seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	if (seconds > 0.0)
+		printf("%-24s %12d %10.3f %14.0f\n", name, operations, seconds, operations / seconds);
+	else
+		printf("%-24s %12d %10.3f %14s\n", name, operations, seconds, "-");
+}
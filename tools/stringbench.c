@@ -0,0 +1,632 @@
+/* Copyright 2026, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of SFLib:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: stringbench.c
+ *
+ * String function benchmark.  Times wildcard matching of adversarial
+ * patterns, which make a backtracking matcher retry most of the string,
+ * comparing one-off matches by string_wildcard_compare() with compiled
+ * patterns matched by string_pattern_match().  Then times the block scan
+ * behind string_ctrl_strlen() against a byte-at-a-time loop, on a set of
+ * typical short strings and on a long one.  Finally times case-insensitive
+ * substring searches by string_nocase_strstr() and compiled needles against
+ * the simple search which string_nocase_strstr() used to make.  All of the
+ * results are checked against each other.
+ *
+ * Before any timing, the string builder is checked: truncation into fixed
+ * buffers, growth, failing allocators, and the edge cases of its integer
+ * formatting.
+ *
+ * Usage: stringbench [<length>]
+ */
+
+/* ANSII C header files. */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* SF-Lib header files. */
+
+#include "string.h"
+
+
+#define STRINGBENCH_DEFAULT_LENGTH 65536					/**< The default length of the strings to test.			*/
+#define STRINGBENCH_PATTERN_REPEATS 20						/**< The number of times that each pattern is matched.		*/
+#define STRINGBENCH_PATTERN_LENGTH 256						/**< The size of a buffer to hold a pattern.				*/
+#define STRINGBENCH_CTRL_STRINGS 4096						/**< The number of typical strings to scan.				*/
+#define STRINGBENCH_CTRL_MAX_LENGTH 64						/**< The longest typical string to scan.				*/
+#define STRINGBENCH_CTRL_BYTES (256 * 1048576)					/**< The number of bytes to scan in each test.				*/
+#define STRINGBENCH_SEARCH_BYTES (64 * 1048576)					/**< The number of bytes to search in each test.			*/
+
+
+/* Static Function Prototypes. */
+
+static osbool stringbench_check_builder(void);
+static osbool stringbench_check(osbool test, char *name, struct string_builder *builder, char *expected);
+static void *stringbench_failing_allocator(void *context, void *block, size_t old_size, size_t new_size);
+static osbool stringbench_time_pattern(char *pattern, char *string);
+static osbool stringbench_time_ctrl(char *name, char *strings[], size_t count, size_t bytes);
+static size_t stringbench_naive_ctrl_strlen(char *s);
+static osbool stringbench_time_search(char *name, char *haystack, char *needle);
+static char *stringbench_naive_strstr(char *s1, char *s2);
+static unsigned stringbench_random(void);
+static void stringbench_report(char *name, int operations, size_t bytes, clock_t start);
+
+
+int main(int argc, char *argv[])
+{
+	char	*string, *typical, *strings[STRINGBENCH_CTRL_STRINGS], pattern[STRINGBENCH_PATTERN_LENGTH];
+	char	terminators[] = {'\0', '\n', '\r', '\t'};
+	size_t	length = STRINGBENCH_DEFAULT_LENGTH, bytes, i, j, size;
+	osbool	success = TRUE;
+
+	if (argc > 2) {
+		fprintf(stderr, "Usage: stringbench [<length>]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		length = strtoul(argv[1], NULL, 10);
+
+	if (length == 0) {
+		fprintf(stderr, "stringbench: the length must be positive\n");
+		return EXIT_FAILURE;
+	}
+
+	string = malloc(length + 1);
+	typical = malloc(STRINGBENCH_CTRL_STRINGS * (STRINGBENCH_CTRL_MAX_LENGTH + 1));
+	if (string == NULL || typical == NULL) {
+		fprintf(stderr, "stringbench: out of memory\n");
+		free(string);
+		free(typical);
+		return EXIT_FAILURE;
+	}
+
+	if (!stringbench_check_builder()) {
+		fprintf(stderr, "stringbench: the string builder checks failed\n");
+		free(string);
+		free(typical);
+		return EXIT_FAILURE;
+	}
+
+	printf("String length: %lu bytes\n\n", (unsigned long) length);
+	printf("%-44s %10s %10s %14s\n", "Test", "Operations", "Seconds", "MBytes/second");
+
+	/* Wildcard patterns against a string of one repeated character,
+	 * which each of the patterns almost matches at every position.
+	 */
+
+	memset(string, 'a', length);
+	string[length] = '\0';
+
+	strcpy(pattern, "*aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab*");
+
+	success = success && stringbench_time_pattern(pattern, string);
+
+	strcpy(pattern, "*aaaaaaaaaaaaaaaaaaaaaaaaaaaaaa*aaaaaaaaaaaaaaaaaaaaaaaaaaaaab*");
+
+	success = success && stringbench_time_pattern(pattern, string);
+
+	strcpy(pattern, "*a*a*a*a*a*a*a*a*aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab*a");
+
+	success = success && stringbench_time_pattern(pattern, string);
+
+	strcpy(pattern, "*aaaaaaaaaaaaaaa#aaaaaaaaaaaaaaab*");
+
+	success = success && stringbench_time_pattern(pattern, string);
+
+	/* The first pattern again, finally matching at the end of the string. */
+
+	string[length - 1] = 'b';
+
+	strcpy(pattern, "*aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab*");
+
+	success = success && stringbench_time_pattern(pattern, string);
+
+	/* Typical short strings, such as menu entries and messages, packed
+	 * end to end so that they start at every alignment and end with a
+	 * variety of control characters.
+	 */
+
+	for (i = 0, bytes = 0; i < STRINGBENCH_CTRL_STRINGS; i++) {
+		size = stringbench_random() % STRINGBENCH_CTRL_MAX_LENGTH;
+
+		strings[i] = typical + bytes;
+
+		for (j = 0; j < size; j++)
+			strings[i][j] = ' ' + (stringbench_random() % 95);
+
+		strings[i][size] = terminators[stringbench_random() % sizeof(terminators)];
+		bytes += size + 1;
+	}
+
+	printf("\nControl-terminated strings\n");
+
+	success = success && stringbench_time_ctrl("  typical strings", strings, STRINGBENCH_CTRL_STRINGS, bytes);
+
+	/* One long string, terminated by a control character. */
+
+	memset(string, 'a', length);
+	string[length - 1] = '\r';
+	strings[0] = string;
+
+	success = success && stringbench_time_ctrl("  long string", strings, 1, length);
+
+	/* Case-insensitive searches of mixed-case words. */
+
+	for (i = 0; i < length; i++)
+		string[i] = (stringbench_random() % 6 == 0) ? ' ' : 'a' + (stringbench_random() % 26) - ((i % 3 == 0) ? 32 : 0);
+
+	string[length] = '\0';
+
+	printf("\nCase-insensitive searches\n");
+
+	success = success && stringbench_time_search("  missing word", string, "ZebraFish");
+
+	if (length > 200)
+		memcpy(string + 100, "zEBRAfISH", 9);
+
+	success = success && stringbench_time_search("  word near the start", string, "ZebraFish");
+
+	/* A search which makes the simple search retry at every position. */
+
+	memset(string, 'a', length);
+
+	success = success && stringbench_time_search("  adversarial needle", string, "aaaaaaaaaaaaaaab");
+
+	if (!success)
+		fprintf(stderr, "stringbench: the results didn't agree\n");
+
+	free(string);
+	free(typical);
+
+	return (success) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/**
+ * Check the string builder's handling of fixed and growable storage, and
+ * of integer formatting.
+ *
+ * \return		TRUE if all of the checks passed; else FALSE.
+ */
+
+static osbool stringbench_check_builder(void)
+{
+	struct string_builder	builder;
+	char			buffer[8], expected[STRINGBENCH_PATTERN_LENGTH];
+	osbool			success = TRUE, result;
+	int			i, allowed;
+
+	/* Fixed buffers keep as much as fits, and flag the loss. */
+
+	string_builder_init(&builder, buffer, sizeof(buffer));
+	result = string_builder_append(&builder, "abc") && string_builder_append(&builder, "defg");
+	success &= stringbench_check(result && !builder.truncated, "fixed buffer filled exactly", &builder, "abcdefg");
+
+	result = string_builder_append_char(&builder, 'h');
+	success &= stringbench_check(!result && builder.truncated, "fixed buffer full", &builder, "abcdefg");
+
+	string_builder_reset(&builder);
+	result = string_builder_append_strings(&builder, "12345", "6789", NULL);
+	success &= stringbench_check(!result && builder.truncated, "fixed buffer overflowed", &builder, "1234567");
+
+	string_builder_reset(&builder);
+	success &= stringbench_check(!builder.truncated, "fixed buffer reset", &builder, "");
+
+	/* Growable builders keep everything, through many reallocations. */
+
+	string_builder_init(&builder, NULL, 0);
+	result = TRUE;
+
+	for (i = 0; i < 10000; i++)
+		result &= string_builder_append_char(&builder, 'a' + (i % 26));
+
+	for (i = 0; i < 10000 && result; i++)
+		result = (builder.text[i] == 'a' + (i % 26)) ? TRUE : FALSE;
+
+	success &= stringbench_check(result && builder.length == 10000 && builder.text[10000] == '\0' && !builder.truncated,
+			"growable builder", NULL, NULL);
+
+	string_builder_free(&builder);
+	success &= stringbench_check(builder.text == NULL && builder.length == 0, "growable builder freed", &builder, "");
+
+	/* Failing allocators truncate, whether or not there is any storage. */
+
+	allowed = 0;
+	string_builder_init_allocator(&builder, stringbench_failing_allocator, &allowed);
+	result = string_builder_append(&builder, "abc");
+	success &= stringbench_check(!result && builder.truncated, "allocator failing when empty", &builder, "");
+
+	allowed = 1;
+	string_builder_init_allocator(&builder, stringbench_failing_allocator, &allowed);
+	memset(expected, 'x', 100);
+	expected[100] = '\0';
+	result = string_builder_append(&builder, "abc") && !string_builder_append(&builder, expected);
+	expected[63] = '\0';
+	memcpy(expected, "abc", 3);
+	success &= stringbench_check(result && builder.truncated, "allocator failing when growing", &builder, expected);
+	string_builder_free(&builder);
+
+	/* Integers. */
+
+	string_builder_init(&builder, NULL, 0);
+
+	string_builder_append_int(&builder, 0);
+	success &= stringbench_check(TRUE, "int zero", &builder, "0");
+
+	string_builder_reset(&builder);
+	string_builder_append_int(&builder, INT_MAX);
+	snprintf(expected, sizeof(expected), "%d", INT_MAX);
+	success &= stringbench_check(TRUE, "INT_MAX", &builder, expected);
+
+	string_builder_reset(&builder);
+	string_builder_append_int(&builder, INT_MIN);
+	snprintf(expected, sizeof(expected), "%d", INT_MIN);
+	success &= stringbench_check(TRUE, "INT_MIN", &builder, expected);
+
+	string_builder_reset(&builder);
+	string_builder_append_int(&builder, -1);
+	success &= stringbench_check(TRUE, "int minus one", &builder, "-1");
+
+	string_builder_reset(&builder);
+	string_builder_append_hex(&builder, 0, 0, FALSE);
+	success &= stringbench_check(TRUE, "hex zero", &builder, "0");
+
+	string_builder_reset(&builder);
+	string_builder_append_hex(&builder, 0xabcu, 6, TRUE);
+	success &= stringbench_check(TRUE, "hex padded", &builder, "000ABC");
+
+	string_builder_reset(&builder);
+	string_builder_append_hex(&builder, UINT_MAX, 2, FALSE);
+	snprintf(expected, sizeof(expected), "%x", UINT_MAX);
+	success &= stringbench_check(TRUE, "hex wider than digits", &builder, expected);
+
+	string_builder_reset(&builder);
+	string_builder_append_hex(&builder, 0x1fu, 40, FALSE);
+	snprintf(expected, sizeof(expected), "%0*x", (int) (sizeof(unsigned) * 2), 0x1fu);
+	success &= stringbench_check(TRUE, "hex digits clamped", &builder, expected);
+
+	string_builder_reset(&builder);
+	string_builder_append_hex(&builder, 0x1fu, -3, FALSE);
+	success &= stringbench_check(TRUE, "hex negative digits", &builder, "1f");
+
+	string_builder_free(&builder);
+
+	/* Integers truncated into a fixed buffer. */
+
+	string_builder_init(&builder, buffer, 6);
+	result = string_builder_append_int(&builder, -123456);
+	success &= stringbench_check(!result && builder.truncated, "int truncated", &builder, "-1234");
+
+	if (success)
+		printf("String builder checks passed\n\n");
+
+	return success;
+}
+
+
+/**
+ * Report on a string builder check.
+ *
+ * \param test		TRUE if the check's own conditions were met.
+ * \param *name		The name of the check.
+ * \param *builder	The builder to compare, or NULL.
+ * \param *expected	The string which the builder should hold.
+ * \return		TRUE if the check passed; else FALSE.
+ */
+
+static osbool stringbench_check(osbool test, char *name, struct string_builder *builder, char *expected)
+{
+	if (test && (builder == NULL || (strcmp(string_builder_get(builder), expected) == 0 && builder->length == strlen(expected))))
+		return TRUE;
+
+	printf("String builder check failed: %s", name);
+
+	if (builder != NULL)
+		printf(" (got \"%s\", expected \"%s\")", string_builder_get(builder), expected);
+
+	printf("\n");
+
+	return FALSE;
+}
+
+
+/**
+ * A string builder allocator which fails once it has made a given number
+ * of claims, for testing.  Blocks are never grown, so a builder keeps the
+ * first block that it was given.
+ *
+ * \param *context	Pointer to an int holding the number of claims
+ *			still allowed.
+ * \param *block		The current block, or NULL.
+ * \param old_size	The current size of the block.
+ * \param new_size	The required size of the block, or 0 to free it.
+ * \return		Pointer to the new block, or NULL.
+ */
+
+static void *stringbench_failing_allocator(void *context, void *block, size_t old_size, size_t new_size)
+{
+	int	*allowed = context;
+
+	(void) old_size;
+
+	if (new_size == 0) {
+		free(block);
+		return NULL;
+	}
+
+	if (block != NULL || *allowed <= 0)
+		return NULL;
+
+	(*allowed)--;
+
+	return malloc(new_size);
+}
+
+
+/**
+ * Time matching a pattern against a string, one-off and compiled, and
+ * check that the two agree.
+ *
+ * \param *pattern	The pattern to match.
+ * \param *string	The string to match against.
+ * \return		TRUE if the results agreed; else FALSE.
+ */
+
+static osbool stringbench_time_pattern(char *pattern, char *string)
+{
+	struct string_pattern	*compiled;
+	char			name[STRINGBENCH_PATTERN_LENGTH];
+	osbool			one_off = FALSE, matched = FALSE;
+	size_t			length;
+	clock_t			start;
+	int			i;
+
+	length = strlen(string);
+
+	compiled = string_pattern_compile(pattern, FALSE);
+	if (compiled == NULL)
+		return FALSE;
+
+	printf("\nPattern %s\n", pattern);
+
+	start = clock();
+
+	for (i = 0; i < STRINGBENCH_PATTERN_REPEATS; i++)
+		one_off = string_wildcard_compare(pattern, string, FALSE);
+
+	snprintf(name, sizeof(name), "  string_wildcard_compare (%s)", (one_off) ? "match" : "no match");
+	stringbench_report(name, STRINGBENCH_PATTERN_REPEATS, length, start);
+
+	start = clock();
+
+	for (i = 0; i < STRINGBENCH_PATTERN_REPEATS; i++)
+		matched = string_pattern_match(compiled, string);
+
+	snprintf(name, sizeof(name), "  string_pattern_match (%s)", (matched) ? "match" : "no match");
+	stringbench_report(name, STRINGBENCH_PATTERN_REPEATS, length, start);
+
+	string_pattern_destroy(compiled);
+
+	return (one_off == matched) ? TRUE : FALSE;
+}
+
+
+/**
+ * Time string_ctrl_strlen() against a byte-at-a-time loop on a set of
+ * strings, and check that the two agree.
+ *
+ * \param *name		The name of the test.
+ * \param *strings[]	The strings to scan.
+ * \param count		The number of strings to scan.
+ * \param bytes		The total size of the strings, with terminators.
+ * \return		TRUE if the results agreed; else FALSE.
+ */
+
+static osbool stringbench_time_ctrl(char *name, char *strings[], size_t count, size_t bytes)
+{
+	char	title[STRINGBENCH_PATTERN_LENGTH];
+	size_t	i, total_block = 0, total_naive = 0;
+	int	repeats, pass;
+	clock_t	start;
+
+	repeats = (bytes < STRINGBENCH_CTRL_BYTES) ? STRINGBENCH_CTRL_BYTES / bytes : 1;
+
+	start = clock();
+
+	for (pass = 0; pass < repeats; pass++) {
+		for (i = 0; i < count; i++)
+			total_naive += stringbench_naive_ctrl_strlen(strings[i]);
+	}
+
+	snprintf(title, sizeof(title), "%s, byte loop", name);
+	stringbench_report(title, repeats, bytes, start);
+
+	start = clock();
+
+	for (pass = 0; pass < repeats; pass++) {
+		for (i = 0; i < count; i++)
+			total_block += string_ctrl_strlen(strings[i]);
+	}
+
+	snprintf(title, sizeof(title), "%s, string_ctrl_strlen", name);
+	stringbench_report(title, repeats, bytes, start);
+
+	return (total_block == total_naive) ? TRUE : FALSE;
+}
+
+
+/**
+ * Find the length of a control-terminated string a byte at a time, as
+ * string_ctrl_strlen() used to.
+ *
+ * \param *s		The string to count.
+ * \return		The length of the string.
+ */
+
+static size_t stringbench_naive_ctrl_strlen(char *s)
+{
+	size_t	length = 0;
+
+	while ((unsigned char) s[length] >= ' ')
+		length++;
+
+	return length;
+}
+
+
+/**
+ * Time string_nocase_strstr() and a compiled needle against the simple
+ * search which string_nocase_strstr() used to make, and check that they
+ * all agree.  The compiled needle is given the length of the text, as it
+ * would be by a client which already knew it.
+ *
+ * \param *name		The name of the test.
+ * \param *haystack	The text to search.
+ * \param *needle	The text to search for.
+ * \return		TRUE if the results agreed; else FALSE.
+ */
+
+static osbool stringbench_time_search(char *name, char *haystack, char *needle)
+{
+	struct string_needle	*compiled;
+	char			title[STRINGBENCH_PATTERN_LENGTH], *naive = NULL, *found = NULL, *find = NULL;
+	size_t			length;
+	int			repeats, pass;
+	clock_t			start;
+
+	length = strlen(haystack);
+	repeats = (length < STRINGBENCH_SEARCH_BYTES) ? STRINGBENCH_SEARCH_BYTES / length : 1;
+
+	compiled = string_needle_compile(needle);
+	if (compiled == NULL)
+		return FALSE;
+
+	start = clock();
+
+	for (pass = 0; pass < repeats; pass++)
+		naive = stringbench_naive_strstr(haystack, needle);
+
+	snprintf(title, sizeof(title), "%s, simple search", name);
+	stringbench_report(title, repeats, length, start);
+
+	start = clock();
+
+	for (pass = 0; pass < repeats; pass++)
+		found = string_nocase_strstr(haystack, needle);
+
+	snprintf(title, sizeof(title), "%s, string_nocase_strstr", name);
+	stringbench_report(title, repeats, length, start);
+
+	start = clock();
+
+	for (pass = 0; pass < repeats; pass++)
+		find = string_needle_find(compiled, haystack, length);
+
+	snprintf(title, sizeof(title), "%s, string_needle_find", name);
+	stringbench_report(title, repeats, length, start);
+
+	string_needle_destroy(compiled);
+
+	if (find == NULL)
+		find = haystack + length;
+
+	return (naive == found && found == find) ? TRUE : FALSE;
+}
+
+
+/**
+ * Perform a case-insensitive strstr() by comparing the substring with the
+ * string at each position in turn, as string_nocase_strstr() used to.
+ *
+ * \param *s1		The string to search.
+ * \param *s2		The substring to search for.
+ * \return		Pointer to the first match, or to the terminator
+ *			of s1 if not found.
+ */
+
+static char *stringbench_naive_strstr(char *s1, char *s2)
+{
+	char	*s1c, *s2c;
+
+	while (*s1 != '\0') {
+		s1c = s1;
+		s2c = s2;
+
+		while (*s1c != '\0' && *s2c != '\0' && toupper(*s1c) == toupper(*s2c)) {
+			s1c++;
+			s2c++;
+		}
+
+		if (*s2c == '\0')
+			break;
+
+		s1++;
+	}
+
+	return s1;
+}
+
+
+/**
+ * Return a pseudo-random number, which is the same on every run.
+ *
+ * \return		The next number in the sequence.
+ */
+
+static unsigned stringbench_random(void)
+{
+	static unsigned long	seed = 1;
+
+	seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+
+	return (unsigned) (seed >> 8);
+}
+
+
+/**
+ * Report the result of a test.
+ *
+ * \param *name		The name of the test.
+ * \param operations	The number of operations performed.
+ * \param bytes		The number of bytes processed by each operation.
+ * \param start		The clock() value when the test started.
+ */
+
+static void stringbench_report(char *name, int operations, size_t bytes, clock_t start)
+{
+	double	seconds;
+
+	seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	if (seconds > 0.0)
+		printf("%-44s %10d %10.3f %14.1f\n", name, operations, seconds, (double) operations * bytes / seconds / 1048576.0);
+	else
+		printf("%-44s %10d %10.3f %14s\n", name, operations, seconds, "-");
+}